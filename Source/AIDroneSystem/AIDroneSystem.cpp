@@ -3,5 +3,7 @@
 #include "AIDroneSystem.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogAIDrone);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, AIDroneSystem, "AIDroneSystem" );
  
\ No newline at end of file
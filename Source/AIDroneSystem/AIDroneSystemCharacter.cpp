@@ -2,6 +2,10 @@
 
 #include "AIDroneSystemCharacter.h"
 #include "AIDrone.h"
+#include "AIDroneFleetProxy.h"
+#include "AIDroneFleetSubsystem.h"
+#include "AIDronePlayerController.h"
+#include "AIDroneSystem.h"
 #include "Engine/LocalPlayer.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
@@ -75,37 +79,34 @@ void AAIDroneSystemCharacter::OnRep_PlayerState()
 	Super::OnRep_PlayerState();
 	
 	// This runs on the client when PlayerState replicates
-	// Add input mapping context here for the client
-	if (APlayerController* PlayerController = Cast<APlayerController>(GetController()))
+	// Raise our mapping context over the drone's; nothing is cleared, so input never drops out during a swap
+	if (AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(GetController()))
 	{
-		if (PlayerController->IsLocalController())
-		{
-			if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer()))
-			{
-				Subsystem->ClearAllMappings();
-				Subsystem->AddMappingContext(DefaultMappingContext, 0);
-			}
-		}
+		DronePC->ActivateInputContext(DefaultMappingContext);
 	}
 }
 
-void AAIDroneSystemCharacter::UnPossessed()
+void AAIDroneSystemCharacter::SetAIDrone(AAIDrone* NewDrone)
 {
-	Super::UnPossessed();
-	
-	// Remove input mapping context when character is unpossessed
-	if (APlayerController* PlayerController = GetController<APlayerController>())
+	if (AIDrone != NewDrone)
 	{
-		if (PlayerController->IsLocalController())
-		{
-			if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer()))
-			{
-				Subsystem->RemoveMappingContext(DefaultMappingContext);
-			}
-		}
+		AIDrone = NewDrone;
+		OnRep_AIDrone();
 	}
 }
 
+void AAIDroneSystemCharacter::OnRep_AIDrone()
+{
+	// Apply the drone's mapping context ahead of time so possessing it later only changes priorities
+	AAIDronePlayerController* DronePC = GetController<AAIDronePlayerController>();
+	if (DronePC && AIDrone && IsLocallyControlled())
+	{
+		DronePC->PreloadInputContext(AIDrone->GetInputMappingContext());
+	}
+
+	OnLinkedDroneChanged.Broadcast(AIDrone);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Input
 
@@ -114,7 +115,11 @@ void AAIDroneSystemCharacter::NotifyControllerChanged()
 	Super::NotifyControllerChanged();
 
 	// Add Input Mapping Context
-	if (APlayerController* PlayerController = Cast<APlayerController>(Controller))
+	if (AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(Controller))
+	{
+		DronePC->ActivateInputContext(DefaultMappingContext);
+	}
+	else if (APlayerController* PlayerController = Cast<APlayerController>(Controller))
 	{
 		if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer()))
 		{
@@ -175,6 +180,14 @@ void AAIDroneSystemCharacter::PossessDroneRequest()
 
 		if (PlayerController && IsLocallyControlled())
 		{
+			// Only predict what the server will allow, so rollbacks stay rare
+			AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(PlayerController);
+			if (DronePC && AIDrone->CurrentState != EDroneState::Possessed
+				&& FVector::Dist(AIDrone->GetActorLocation(), GetActorLocation()) <= AIDrone->CommandRange)
+			{
+				DronePC->PredictPossession(AIDrone);
+			}
+
 			ServerRequestPossessDrone(AIDrone, PlayerController);
 		}
 	}
@@ -205,12 +218,20 @@ void AAIDroneSystemCharacter::InteractDroneRequest()
 
 	AActor* HitActor = HitResult.GetActor();
 	AAIDrone* DroneActor =  Cast<AAIDrone>(HitActor);
+
+	// Dormant drones have no actor yet; ask the server to bring this one back
+	int32 RecordId;
+	AAIDroneFleetProxy* Proxy = Cast<AAIDroneFleetProxy>(HitActor);
+	if (Proxy && Proxy->GetRecordIdForInstance(HitResult.Item, RecordId))
+	{
+		ServerRequestPromoteDrone(Proxy, RecordId);
+		return;
+	}
 	
-    // Set the reference only if a new valid drone is found.
+    // The server owns the link, so dormancy can see it; AIDrone arrives through OnRep_AIDrone
 	if (DroneActor)
 	{
-		AIDrone = DroneActor;
-        UE_LOG(LogTemp, Warning, TEXT("Drone reference acquired: %s"), *AIDrone->GetName());
+		ServerSetLinkedDrone(DroneActor);
 	}
 }
 
@@ -227,7 +248,7 @@ void AAIDroneSystemCharacter::ServerRequestDroneFollow_Implementation(AAIDrone*
 		if (FVector::Dist(DroneToCommand->GetActorLocation(), Player->GetActorLocation()) <= DroneToCommand->CommandRange)
 		{
 			DroneToCommand->FollowTarget = Player;
-			DroneToCommand->CurrentState = EDroneState::Following;
+			DroneToCommand->SetDroneState(EDroneState::Following);
 			
 			// Use public wrapper to update visuals on the server
 			
@@ -245,7 +266,7 @@ void AAIDroneSystemCharacter::ServerRequestDroneUnfollow_Implementation(AAIDrone
 	if (DroneToCommand)
 	{
 		DroneToCommand->FollowTarget = nullptr;
-		DroneToCommand->CurrentState = EDroneState::Idle;
+		DroneToCommand->SetDroneState(EDroneState::Idle);
 		
 		
 	}
@@ -264,12 +285,61 @@ void AAIDroneSystemCharacter::ServerRequestPossessDrone_Implementation(AAIDrone*
 			}
 		}
 	}
+
+	// Let a client that predicted this swap put its camera and input back
+	if (Requester && Requester->GetPawn() != DroneToPossess)
+	{
+		if (AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(Requester))
+		{
+			DronePC->ClientRejectPossession(DroneToPossess);
+		}
+	}
 }
 
 bool AAIDroneSystemCharacter::ServerRequestPossessDrone_Validate(AAIDrone* DroneToPossess, APlayerController* Requester)
 {
 	return (Requester != nullptr && DroneToPossess != nullptr);
 }
+
+bool AAIDroneSystemCharacter::ServerSetLinkedDrone_Validate(AAIDrone* Drone)
+{
+	return (Drone != nullptr);
+}
+
+void AAIDroneSystemCharacter::ServerSetLinkedDrone_Implementation(AAIDrone* Drone)
+{
+	// Same reach as the trace that found it, so a client can't claim drones across the map
+	if (FVector::Dist(Drone->GetActorLocation(), GetActorLocation()) <= FMath::Max(TraceLength, (double)Drone->CommandRange))
+	{
+		SetAIDrone(Drone);
+		UE_LOG(LogAIDrone, Verbose, TEXT("Drone reference acquired: %s"), *Drone->GetName());
+	}
+}
+
+bool AAIDroneSystemCharacter::ServerRequestPromoteDrone_Validate(AAIDroneFleetProxy* Proxy, int32 RecordId)
+{
+	return (Proxy != nullptr);
+}
+
+void AAIDroneSystemCharacter::ServerRequestPromoteDrone_Implementation(AAIDroneFleetProxy* Proxy, int32 RecordId)
+{
+	UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+	const AAIDrone* DefaultDrone = Proxy->GetDroneClass() ? Proxy->GetDroneClass()->GetDefaultObject<AAIDrone>() : nullptr;
+	const FDroneFleetRecord* Record = Proxy->GetRecords().FindByPredicate([RecordId](const FDroneFleetRecord& Item) { return Item.RecordId == RecordId; });
+	if (!FleetSubsystem || !DefaultDrone || !Record)
+	{
+		return;
+	}
+
+	// Same reach as the trace that found it, so a client can't wake drones across the map
+	if (FVector::Dist(FVector(Record->Location), GetActorLocation()) <= FMath::Max(TraceLength, (double)DefaultDrone->CommandRange))
+	{
+		if (AAIDrone* Promoted = FleetSubsystem->PromoteDrone(Proxy, RecordId))
+		{
+			SetAIDrone(Promoted);
+		}
+	}
+}
 // ====================================================
 
 void AAIDroneSystemCharacter::Move(const FInputActionValue& Value)
@@ -13,9 +13,12 @@ class UInputMappingContext;
 class UInputAction;
 struct FInputActionValue;
 class AAIDrone;
+class AAIDroneFleetProxy;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTemplateCharacter, Log, All);
 
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnLinkedDroneChanged, AAIDrone*);
+
 UCLASS(config=Game)
 class AAIDroneSystemCharacter : public ACharacter
 {
@@ -51,10 +54,12 @@ public:
 	
 	// === Add possession handling ===
 	virtual void PossessedBy(AController* NewController) override;
-	virtual void UnPossessed() override;
 	virtual void OnRep_PlayerState() override;
 	// ===============================
 
+	UFUNCTION()
+	void OnRep_AIDrone();
+
 protected:
 
 	/** Called for movement input */
@@ -76,9 +81,17 @@ public:
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
+	/** Returns DefaultMappingContext **/
+	FORCEINLINE UInputMappingContext* GetInputMappingContext() const { return DefaultMappingContext; }
 
-	UPROPERTY(EditAnywhere, Replicated, Transient)
+	UPROPERTY(EditAnywhere, ReplicatedUsing = OnRep_AIDrone, Transient)
 	TObjectPtr<AAIDrone> AIDrone;
+
+	/** Changes the linked drone and notifies listeners. */
+	void SetAIDrone(AAIDrone* NewDrone);
+
+	/** Fires whenever AIDrone changes, locally or through replication. */
+	FOnLinkedDroneChanged OnLinkedDroneChanged;
 	
 	
 	UPROPERTY(EditDefaultsOnly)
@@ -117,4 +130,12 @@ public:
 	
 	UFUNCTION(Server, Reliable, WithValidation)
 	void ServerRequestPossessDrone(AAIDrone* DroneToPossess, APlayerController* Requester);
+
+	/** Server RPC to link the drone the player interacted with, so the server knows it is in use. Called from InteractDroneRequest(). */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetLinkedDrone(AAIDrone* Drone);
+
+	/** Server RPC to wake a dormant drone the player interacted with. Called from InteractDroneRequest(). */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRequestPromoteDrone(AAIDroneFleetProxy* Proxy, int32 RecordId);
 };
\ No newline at end of file
@@ -1,15 +1,53 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "AIDroneSystemGameMode.h"
+#include "AIDroneFleetManifest.h"
+#include "AIDroneFleetSubsystem.h"
 #include "AIDroneSystemCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+#include "Misc/CommandLine.h"
 
 AAIDroneSystemGameMode::AAIDroneSystemGameMode()
 {
 	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter"));
-	if (PlayerPawnBPClass.Class != NULL)
+	PlayerPawnClass = TSoftClassPtr<APawn>(FSoftObjectPath(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter.BP_ThirdPersonCharacter_C")));
+}
+
+void AAIDroneSystemGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	if (!PlayerPawnClass.IsNull())
+	{
+		PlayerPawnClassHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(PlayerPawnClass.ToSoftObjectPath());
+	}
+}
+
+void AAIDroneSystemGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	TSoftObjectPtr<UAIDroneFleetManifest> Manifest = FleetManifest;
+	FString ManifestPath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("DroneFleetManifest="), ManifestPath))
+	{
+		Manifest = TSoftObjectPtr<UAIDroneFleetManifest>(FSoftObjectPath(ManifestPath));
+	}
+
+	UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+	if (FleetSubsystem && !Manifest.IsNull())
+	{
+		FleetSubsystem->SpawnManifest(Manifest);
+	}
+}
+
+UClass* AAIDroneSystemGameMode::GetDefaultPawnClassForController_Implementation(AController* InController)
+{
+	// Normally loaded by now; a player who arrives first, such as a listen server's host, waits for it here
+	if (UClass* PawnClass = PlayerPawnClass.LoadSynchronous())
 	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
+		return PawnClass;
 	}
+	return Super::GetDefaultPawnClassForController_Implementation(InController);
 }
@@ -6,13 +6,32 @@
 #include "GameFramework/GameModeBase.h"
 #include "AIDroneSystemGameMode.generated.h"
 
-UCLASS(minimalapi)
+class UAIDroneFleetManifest;
+struct FStreamableHandle;
+
+UCLASS(minimalapi, config=Game)
 class AAIDroneSystemGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
 	AAIDroneSystemGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+	virtual UClass* GetDefaultPawnClassForController_Implementation(AController* InController) override;
+
+protected:
+	/** Pawn players start as; loaded in the background when the game starts rather than when this class is first used */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Classes")
+	TSoftClassPtr<APawn> PlayerPawnClass;
+
+	/** Drones to spawn when play starts; -DroneFleetManifest=<object path> overrides it */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Drones")
+	TSoftObjectPtr<UAIDroneFleetManifest> FleetManifest;
+
+private:
+	TSharedPtr<FStreamableHandle> PlayerPawnClassHandle;
 };
 
 
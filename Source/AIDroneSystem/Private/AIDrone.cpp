@@ -1,5 +1,9 @@
 ﻿#include "AIDrone.h"
 #include "AIDronePlayerController.h"
+#include "AIDroneFleetSubsystem.h"
+#include "AIDroneNavSubsystem.h"
+#include "AIDroneDistanceField.h"
+#include "AIDroneStats.h"
 #include "Net/UnrealNetwork.h"
 #include "Materials/MaterialInstanceDynamic.h"
 #include "GameFramework/PlayerController.h"
@@ -8,6 +12,13 @@
 #include "Kismet/GameplayStatics.h"
 #include "AIController.h"
 #include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarDroneTraceDynamicObstacles(
+    TEXT("drone.DistanceField.TraceDynamicObstacles"),
+    false,
+    TEXT("Inside the baked distance field, still trace against WorldDynamic objects the bake cannot know about."),
+    ECVF_Default);
 
 AAIDrone::AAIDrone()
 {
@@ -57,10 +68,41 @@ void AAIDrone::BeginPlay()
 {
     Super::BeginPlay();
     UpdateVisualFeedback();
+
+    // Starting from world time keeps drones that spawn together bobbing together
+    HoverTime = GetWorld()->GetTimeSeconds();
+
+    FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+    if (FleetSubsystem)
+    {
+        FleetSubsystem->RegisterDrone(this);
+    }
+
+    NavSubsystem = GetWorld()->GetSubsystem<UAIDroneNavSubsystem>();
+}
+
+void AAIDrone::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (FleetSubsystem)
+    {
+        FleetSubsystem->UnregisterDrone(this);
+        FleetSubsystem = nullptr;
+    }
+
+    // A parked controller is not attached to the drone, so nothing else would clean it up
+    if (IsValid(ParkedAIController))
+    {
+        ParkedAIController->Destroy();
+    }
+    ParkedAIController = nullptr;
+
+    Super::EndPlay(EndPlayReason);
 }
 
 void AAIDrone::Tick(float DeltaTime)
 {
+    DRONE_SCOPED_TIMER(Tick);
+
     Super::Tick(DeltaTime);
 
     if (IsLocallyControlled() && !HasAuthority())
@@ -77,73 +119,131 @@ void AAIDrone::Tick(float DeltaTime)
         }
     }
 
-   if (HasAuthority())
+    // Moves merged by the rate limit go through once this connection has a token again
+    if (bHasPendingMove && HasAuthority())
     {
-        if (CurrentState == EDroneState::Possessed)
+        AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(OwningPC);
+        if (!DronePC || DronePC->TryConsumeMoveToken())
         {
-            if (GetLastMovementInputVector().IsNearlyZero())
-            {
-                ApplyHoverPhysics(DeltaTime);
-            }
+            ApplyPendingMove();
+        }
+    }
+
+    // Normally the fleet subsystem schedules AI updates within its frame budget
+    if (HasAuthority() && !FleetSubsystem)
+    {
+        UpdateDroneAI(DeltaTime);
+    }
+}
+
+void AAIDrone::UpdateDroneAI(float DeltaTime)
+{
+    DRONE_SCOPED_TIMER(UpdateAI);
+    DRONE_COUNTER_ADD(AIUpdates, 1);
+
+    if (CurrentState == EDroneState::Possessed)
+    {
+        if (GetLastMovementInputVector().IsNearlyZero())
+        {
+            ApplyHoverPhysics(DeltaTime);
         }
-        else if (CurrentState == EDroneState::Following && IsValid(FollowTarget))
+    }
+    else if (CurrentState == EDroneState::Following && !IsValid(FollowTarget))
+    {
+        if (bAwaitingFollowTarget)
         {
-            FVector Dir = FollowTarget->GetActorLocation() - GetActorLocation();
-            float Dist = Dir.Size();
+            // The fleet hands the player back once they rejoin; until then hover where the snapshot left us
+            ApplyHoverPhysics(DeltaTime);
+            ApplyAvoidanceInput();
+        }
+        else
+        {
+            // The target was destroyed under us; without this the drone would stop moving and never go idle
+            FollowTarget = nullptr;
+            SetDroneState(EDroneState::Idle);
+        }
+    }
+    else if (CurrentState == EDroneState::Following)
+    {
+        FVector Dir = FollowTarget->GetActorLocation() - GetActorLocation();
+        float Dist = Dir.Size();
+        
+        if (Dist > FollowDistance)
+        {
+            FVector TargetDirection = GetFlightDirection(FollowTarget->GetActorLocation());
+            FVector AvoidanceVector = FVector::ZeroVector;
+            float AvoidanceDistance = 300.0f;
+            float AvoidanceForce = 1.0f;
+            FVector HitNormal;
             
-            if (Dist > FollowDistance)
+            if (FindObstacleAhead(TargetDirection, AvoidanceDistance, HitNormal))
             {
-                FVector AvoidanceVector = FVector::ZeroVector;
-                float AvoidanceDistance = 300.0f;
-                float AvoidanceForce = 1.0f;
-                FHitResult HitResult;
-                FCollisionQueryParams Params;
-                Params.AddIgnoredActor(this);
-                
-                if (GetWorld()->LineTraceSingleByChannel(HitResult, GetActorLocation(), GetActorLocation() + Dir.GetSafeNormal() * AvoidanceDistance, ECC_Visibility, Params))
+                PendingFlightEvents |= EDroneFlightEvent::ObstacleAhead;
+
+                if (FMath::Abs(HitNormal.Z) < 0.7f)
                 {
-                    FVector HitNormal = HitResult.Normal;
-                    if (FMath::Abs(HitNormal.Z) < 0.7f)
-                    {
-                        AvoidanceVector = FVector::CrossProduct(HitNormal, GetActorRightVector());
-                        AvoidanceVector.Z += 0.5f; 
-                    }
-                    else
-                    {
-                        AvoidanceVector = GetActorRightVector();
-                    }
-                    AvoidanceVector = AvoidanceVector.GetSafeNormal() * AvoidanceForce;
+                    AvoidanceVector = FVector::CrossProduct(HitNormal, GetActorRightVector());
+                    AvoidanceVector.Z += 0.5f; 
                 }
+                else
+                {
+                    AvoidanceVector = GetActorRightVector();
+                }
+                AvoidanceVector = AvoidanceVector.GetSafeNormal() * AvoidanceForce;
+            }
 
-                FVector TargetDirection = Dir.GetSafeNormal();
-                FVector FinalMoveDirection = (TargetDirection + AvoidanceVector).GetSafeNormal();
+            FVector FinalMoveDirection = (TargetDirection + AvoidanceVector).GetSafeNormal();
 
-                FRotator TargetRot = FinalMoveDirection.Rotation();
-                TargetRot.Pitch = 0.0f;
-                TargetRot.Roll = 0.0f;
-                FRotator NewRot = FMath::RInterpTo(GetActorRotation(), TargetRot, DeltaTime, 8.0f);
-                SetActorRotation(NewRot);
-                
-                float MovementMagnitude = FMath::Clamp((Dist - FollowDistance) / FollowDistance, 0.1f, 1.0f);
-                AddMovementInput(FinalMoveDirection, MovementMagnitude);
+            FRotator TargetRot = FinalMoveDirection.Rotation();
+            TargetRot.Pitch = 0.0f;
+            TargetRot.Roll = 0.0f;
+            FRotator NewRot = FMath::RInterpTo(GetActorRotation(), TargetRot, DeltaTime, 8.0f);
+            SetActorRotation(NewRot);
+            
+            float MovementMagnitude = FMath::Clamp((Dist - FollowDistance) / FollowDistance, 0.1f, 1.0f);
+
+            // Publish this frame's intent for the fleet solve and steer with the last avoidance result
+            FVector AvoidanceVelocity;
+            if (FleetSubsystem)
+            {
+                FleetSubsystem->SetPreferredVelocity(this, FinalMoveDirection * MovementMagnitude * GetMaxSpeed());
             }
-            else 
+
+            if (FleetSubsystem && FleetSubsystem->GetAvoidanceVelocity(this, AvoidanceVelocity) && GetMaxSpeed() > 0.0f)
             {
-                ApplyHoverPhysics(DeltaTime);
+                AddMovementInput(AvoidanceVelocity.GetSafeNormal(), FMath::Min(AvoidanceVelocity.Size() / GetMaxSpeed(), 1.0f));
+                PendingFlightEvents |= EDroneFlightEvent::AvoidanceAdjusted;
+            }
+            else
+            {
+                AddMovementInput(FinalMoveDirection, MovementMagnitude);
             }
         }
-        else if (CurrentState == EDroneState::Idle)
+        else 
         {
             ApplyHoverPhysics(DeltaTime);
+            ApplyAvoidanceInput();
         }
     }
+    else if (CurrentState == EDroneState::Idle)
+    {
+        ApplyHoverPhysics(DeltaTime);
+        ApplyAvoidanceInput();
+    }
+
+    if (FleetSubsystem)
+    {
+        FleetSubsystem->RecordFlight(this);
+    }
 }
 
 void AAIDrone::ApplyHoverPhysics(float DeltaTime)
 {
-    float Time = GetWorld()->GetTimeSeconds();
-    float CurrentHoverHeight = FMath::Sin(Time * HoverFrequency) * HoverAmplitude;
-    float PreviousHoverHeight = FMath::Sin((Time - DeltaTime) * HoverFrequency) * HoverAmplitude;
+    DRONE_SCOPED_TIMER(HoverPhysics);
+
+    HoverTime += DeltaTime;
+    float CurrentHoverHeight = FMath::Sin(HoverTime * HoverFrequency) * HoverAmplitude;
+    float PreviousHoverHeight = FMath::Sin((HoverTime - DeltaTime) * HoverFrequency) * HoverAmplitude;
     float HoverVelZ = (CurrentHoverHeight - PreviousHoverHeight) / DeltaTime;
 
     if (MovementComponent)
@@ -152,6 +252,130 @@ void AAIDrone::ApplyHoverPhysics(float DeltaTime)
     }
 }
 
+void AAIDrone::ApplyAvoidanceInput()
+{
+    // Hovering drones prefer to stay put, so any avoidance velocity is purely them making way
+    FVector AvoidanceVelocity;
+    if (FleetSubsystem && FleetSubsystem->GetAvoidanceVelocity(this, AvoidanceVelocity) && GetMaxSpeed() > 0.0f && !AvoidanceVelocity.IsNearlyZero(1.0f))
+    {
+        AddMovementInput(AvoidanceVelocity.GetSafeNormal(), FMath::Min(AvoidanceVelocity.Size() / GetMaxSpeed(), 1.0f));
+        PendingFlightEvents |= EDroneFlightEvent::AvoidanceAdjusted;
+    }
+}
+
+FVector AAIDrone::GetFlightDirection(const FVector& Goal)
+{
+    const FVector Location = GetActorLocation();
+    if (!bUseFlightNavigation || !NavSubsystem || !NavSubsystem->IsNavigationReady())
+    {
+        return (Goal - Location).GetSafeNormal();
+    }
+
+    // Re-plan once the goal has left the region the current path was planned for
+    if (!bNavPathPending && (!NavPath.IsValid() || FVector::DistSquared(NavPathGoal, Goal) > FMath::Square(NavSubsystem->GetReplanDistance())))
+    {
+        NavPathGoal = Goal;
+        bNavPathPending = true;
+        TSharedPtr<const FDroneNavPath> CachedPath = NavSubsystem->RequestPath(Location, Goal, FOnDronePathFound::CreateWeakLambda(this, [this](TSharedPtr<const FDroneNavPath> Path)
+        {
+            bNavPathPending = false;
+            SetNavPath(Path);
+        }));
+
+        if (CachedPath.IsValid())
+        {
+            bNavPathPending = false;
+            SetNavPath(CachedPath);
+        }
+    }
+
+    if (NavPath.IsValid())
+    {
+        const float ReachDistanceSq = FMath::Square(NavSubsystem->GetReplanDistance() * 0.25f);
+        while (NavPath->Points.IsValidIndex(NavPathIndex) && FVector::DistSquared(Location, NavPath->Points[NavPathIndex]) < ReachDistanceSq)
+        {
+            ++NavPathIndex;
+        }
+
+        if (NavPath->Points.IsValidIndex(NavPathIndex))
+        {
+            return (NavPath->Points[NavPathIndex] - Location).GetSafeNormal();
+        }
+    }
+
+    return (Goal - Location).GetSafeNormal();
+}
+
+void AAIDrone::SetNavPath(TSharedPtr<const FDroneNavPath> Path)
+{
+    NavPath = Path;
+    NavPathIndex = 0;
+
+    if (!NavPath.IsValid())
+    {
+        return;
+    }
+
+    // Shared paths may start where another drone was; join at the closest waypoint
+    const FVector Location = GetActorLocation();
+    double BestDistSq = TNumericLimits<double>::Max();
+    for (int32 Index = 0; Index < NavPath->Points.Num(); ++Index)
+    {
+        const double DistSq = FVector::DistSquared(Location, NavPath->Points[Index]);
+        if (DistSq < BestDistSq)
+        {
+            BestDistSq = DistSq;
+            NavPathIndex = Index;
+        }
+    }
+}
+
+bool AAIDrone::FindObstacleAhead(const FVector& Direction, float Distance, FVector& OutNormal) const
+{
+    DRONE_SCOPED_TIMER(ObstacleTrace);
+    DRONE_COUNTER_ADD(ObstacleQueries, 1);
+
+    const FVector Location = GetActorLocation();
+    FCollisionQueryParams Params;
+    Params.AddIgnoredActor(this);
+
+    // The baked field answers for static geometry with a few memory reads instead of a scene query.
+    // Zero clearance, like the line traces below: padding the ray by AvoidanceRadius would report a hit
+    // at the start whenever the drone flies level within that distance of a floor or ceiling.
+    if (const FDroneDistanceField* DistanceField = NavSubsystem ? NavSubsystem->GetDistanceField() : nullptr)
+    {
+        bool bInBounds = false;
+        if (DistanceField->Raycast(Location, Direction, Distance, 0.0f, OutNormal, bInBounds))
+        {
+            return true;
+        }
+
+        if (bInBounds)
+        {
+            if (CVarDroneTraceDynamicObstacles.GetValueOnGameThread())
+            {
+                DRONE_COUNTER_ADD(SceneTraces, 1);
+                FHitResult HitResult;
+                if (GetWorld()->LineTraceSingleByObjectType(HitResult, Location, Location + Direction * Distance, FCollisionObjectQueryParams(ECC_WorldDynamic), Params))
+                {
+                    OutNormal = HitResult.Normal;
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    DRONE_COUNTER_ADD(SceneTraces, 1);
+    FHitResult HitResult;
+    if (GetWorld()->LineTraceSingleByChannel(HitResult, Location, Location + Direction * Distance, ECC_Visibility, Params))
+    {
+        OutNormal = HitResult.Normal;
+        return true;
+    }
+    return false;
+}
+
 void AAIDrone::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
     Super::SetupPlayerInputComponent(PlayerInputComponent);
@@ -173,7 +397,8 @@ void AAIDrone::PossessedBy(AController* NewController)
     OwningPC = Cast<APlayerController>(NewController);
     if (OwningPC && HasAuthority())
     {
-        CurrentState = EDroneState::Possessed;
+        PendingFlightEvents |= EDroneFlightEvent::Possessed;
+        SetDroneState(EDroneState::Possessed);
         SetOwner(NewController);
     }
 }
@@ -182,51 +407,76 @@ void AAIDrone::OnRep_PlayerState()
 {
     Super::OnRep_PlayerState();
     
-    if (APlayerController* PC = Cast<APlayerController>(GetController()))
+    // Usually already active from a predicted swap, in which case this changes nothing
+    if (AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(GetController()))
     {
-        if (PC->IsLocalController())
-        {
-            if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PC->GetLocalPlayer()))
-            {
-                Subsystem->ClearAllMappings();
-                Subsystem->AddMappingContext(DroneMappingContext, 2);
-            }
-        }
+        DronePC->ActivateInputContext(DroneMappingContext);
     }
 }
 
 void AAIDrone::UnPossessed()
 {
+    AController* OldController = GetController();
+    const bool bWasPlayerControlled = OldController && OldController->IsPlayerController();
+
     Super::UnPossessed();
-    
-    if (OwningPC && OwningPC->IsLocalController())
+
+    // The mapping context stays applied at a low priority for the next swap; the next pawn's context outranks it
+
+    OwningPC = nullptr;
+    PendingMoveInput = FVector::ZeroVector;
+    bHasPendingMove = false;
+
+    if (HasAuthority())
     {
-        if (ULocalPlayer* LocalPlayer = OwningPC->GetLocalPlayer())
+        PendingFlightEvents |= EDroneFlightEvent::Unpossessed;
+        FollowTarget = nullptr;
+        SetDroneState(EDroneState::Idle);
+
+        // Hand the drone back to the controller the player displaced instead of spawning one per swap,
+        // which used to leave the displaced controller and a second spare behind on every possession
+        if (!bWasPlayerControlled)
         {
-            if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(LocalPlayer))
-            {
-                Subsystem->RemoveMappingContext(DroneMappingContext);
-            }
+            ParkedAIController = Cast<AAIController>(OldController);
+        }
+        else if (IsValid(ParkedAIController))
+        {
+            AController* AIController = ParkedAIController;
+            ParkedAIController = nullptr;
+            AIController->Possess(this);
+        }
+        else
+        {
+            SpawnDefaultController();
         }
     }
+}
 
-    OwningPC = nullptr;
+void AAIDrone::SetDroneState(EDroneState NewState)
+{
+    // A command that stops the drone following wins over the snapshot it was restored from
+    if (NewState != EDroneState::Following)
+    {
+        bAwaitingFollowTarget = false;
+    }
 
-    if (HasAuthority())
+    if (CurrentState != NewState)
     {
-        CurrentState = EDroneState::Idle;
-        FollowTarget = nullptr;
-        SpawnDefaultController();
+        CurrentState = NewState;
+        OnRep_State();
     }
 }
 
 void AAIDrone::OnRep_State()
 {
     UpdateVisualFeedback();
+    OnStateChanged.Broadcast(this);
 }
 
 void AAIDrone::UpdateVisualFeedback()
 {
+    DRONE_SCOPED_TIMER(VisualFeedback);
+
     if (DroneMesh)
     {
         UMaterialInstanceDynamic* MID = DroneMesh->CreateAndSetMaterialInstanceDynamic(0);
@@ -268,6 +518,10 @@ void AAIDrone::Unpossess(const FInputActionValue& Value)
 {
     if (IsLocallyControlled())
     {
+        if (AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(GetController()))
+        {
+            DronePC->PredictPossession(DronePC->GetPreviousPawn());
+        }
         ServerUnpossess();
     }
 }
@@ -279,6 +533,8 @@ bool AAIDrone::ServerUnpossess_Validate()
 
 void AAIDrone::ServerUnpossess_Implementation()
 {
+    PendingFlightEvents |= EDroneFlightEvent::UnpossessRequest;
+
     if (!OwningPC) return;
     
     AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(OwningPC);
@@ -294,6 +550,38 @@ bool AAIDrone::ServerMove_Validate(FVector ClientLocation, FVector InputVector,
 
 void AAIDrone::ServerMove_Implementation(FVector ClientLocation, FVector InputVector, FRotator ControlRotation, float DeltaTime)
 {
+    DRONE_SCOPED_TIMER(ServerMove);
+    DRONE_COUNTER_ADD(ServerMoves, 1);
+
+    PendingServerMoves = (uint16)FMath::Min<int32>(PendingServerMoves + 1, MAX_uint16);
+
+    AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(OwningPC);
+    const EDroneMoveAdmission Admission = DronePC ? DronePC->AdmitServerMove() : EDroneMoveAdmission::Process;
+    if (Admission == EDroneMoveAdmission::Drop)
+    {
+        return;
+    }
+
+    // The newest move carries the location and rotation; inputs add up like the separate calls would have
+    PendingMoveLocation = ClientLocation;
+    PendingMoveInput += InputVector;
+    PendingMoveRotation = ControlRotation;
+    bHasPendingMove = true;
+
+    if (Admission == EDroneMoveAdmission::Process)
+    {
+        ApplyPendingMove();
+    }
+}
+
+void AAIDrone::ApplyPendingMove()
+{
+    const FVector ClientLocation = PendingMoveLocation;
+    const FVector InputVector = PendingMoveInput;
+    const FRotator ControlRotation = PendingMoveRotation;
+    PendingMoveInput = FVector::ZeroVector;
+    bHasPendingMove = false;
+
     FVector ServerLocation = GetActorLocation();
     float DistSq = FVector::DistSquared(ClientLocation, ServerLocation);
     const float MaxDistSq = 10000.0f;
@@ -302,6 +590,11 @@ void AAIDrone::ServerMove_Implementation(FVector ClientLocation, FVector InputVe
     {
         SetActorLocation(ClientLocation);
     }
+    else
+    {
+        // The client is snapped back to the server location by movement replication
+        DRONE_COUNTER_ADD(ServerMoveCorrections, 1);
+    }
     
     if (!InputVector.IsNearlyZero())
     {
@@ -323,6 +616,8 @@ void AAIDrone::ServerMove_Implementation(FVector ClientLocation, FVector InputVe
 bool AAIDrone::ServerRequestPossess_Validate(APlayerController* Requester) { return Requester != nullptr; }
 void AAIDrone::ServerRequestPossess_Implementation(APlayerController* Requester)
 {
+    PendingFlightEvents |= EDroneFlightEvent::PossessRequest;
+
     if (Requester && CurrentState != EDroneState::Possessed)
     {
         if (APawn* PlayerPawn = Requester->GetPawn())
@@ -333,4 +628,12 @@ void AAIDrone::ServerRequestPossess_Implementation(APlayerController* Requester)
             }
         }
     }
+
+    if (Requester && Requester->GetPawn() != this)
+    {
+        if (AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(Requester))
+        {
+            DronePC->ClientRejectPossession(this);
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+﻿#include "AIDroneAvoidance.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	FORCEINLINE FIntVector GetCell(const FVector& Position, float InvCellSize)
+	{
+		return FIntVector(
+			FMath::FloorToInt(Position.X * InvCellSize),
+			FMath::FloorToInt(Position.Y * InvCellSize),
+			FMath::FloorToInt(Position.Z * InvCellSize));
+	}
+
+	struct FOrcaPlane
+	{
+		FVector Point;
+		FVector Normal;
+	};
+
+	// Builds the ORCA half-space for agent A against neighbour B (RVO2-3D formulation)
+	FOrcaPlane MakeOrcaPlane(const FVector& PosA, const FVector& VelA, const FVector& PosB, const FVector& VelB,
+		float CombinedRadius, float Responsibility, float InvTimeHorizon, float InvDeltaTime)
+	{
+		const FVector RelativePosition = PosB - PosA;
+		const FVector RelativeVelocity = VelA - VelB;
+		const double DistSq = RelativePosition.SizeSquared();
+		const double CombinedRadiusSq = FMath::Square(CombinedRadius);
+
+		FVector U;
+		FOrcaPlane Plane;
+
+		if (DistSq > CombinedRadiusSq)
+		{
+			// No collision yet
+			const FVector W = RelativeVelocity - InvTimeHorizon * RelativePosition;
+			const double WLengthSq = W.SizeSquared();
+			const double DotProduct = FVector::DotProduct(W, RelativePosition);
+
+			if (DotProduct < 0.0 && FMath::Square(DotProduct) > CombinedRadiusSq * WLengthSq)
+			{
+				// Project on cut-off circle
+				const double WLength = FMath::Sqrt(WLengthSq);
+				const FVector UnitW = WLength > UE_SMALL_NUMBER ? W / WLength : FVector::UpVector;
+				Plane.Normal = UnitW;
+				U = (CombinedRadius * InvTimeHorizon - WLength) * UnitW;
+			}
+			else
+			{
+				// Project on cone
+				const double A = DistSq;
+				const double B = FVector::DotProduct(RelativePosition, RelativeVelocity);
+				const double C = RelativeVelocity.SizeSquared() - FVector::CrossProduct(RelativePosition, RelativeVelocity).SizeSquared() / (DistSq - CombinedRadiusSq);
+				const double T = (B + FMath::Sqrt(FMath::Max(B * B - A * C, 0.0))) / A;
+				const FVector WW = RelativeVelocity - T * RelativePosition;
+				const double WWLength = WW.Size();
+				const FVector UnitWW = WWLength > UE_SMALL_NUMBER ? WW / WWLength : FVector::UpVector;
+				Plane.Normal = UnitWW;
+				U = (CombinedRadius * T - WWLength) * UnitWW;
+			}
+		}
+		else
+		{
+			// Already overlapping, resolve within one step
+			const FVector W = RelativeVelocity - InvDeltaTime * RelativePosition;
+			const double WLength = W.Size();
+			const FVector UnitW = WLength > UE_SMALL_NUMBER ? W / WLength : FVector::UpVector;
+			Plane.Normal = UnitW;
+			U = (CombinedRadius * InvDeltaTime - WLength) * UnitW;
+		}
+
+		Plane.Point = VelA + Responsibility * U;
+		return Plane;
+	}
+}
+
+void FDroneNeighbourQuery::Reset(int32 NumAgents)
+{
+	Positions.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	Velocities.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	Radii.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+}
+
+void FDroneNeighbourQuery::Build(float QueryRadius, int32 MaxNeighbours)
+{
+	const int32 NumAgents = Num();
+	MaxNeighbours = FMath::Clamp(MaxNeighbours, 0, MaxNeighboursLimit);
+	QueryRadius = FMath::Max(QueryRadius, 1.0f);
+
+	Neighbours.SetNumUninitialized(NumAgents * MaxNeighboursLimit, EAllowShrinking::No);
+	NeighbourCounts.SetNumZeroed(NumAgents, EAllowShrinking::No);
+
+	if (NumAgents < 2 || MaxNeighbours == 0)
+	{
+		return;
+	}
+
+	// Bucket agents once; cells are the query radius wide so every candidate is in the 3x3x3 block around an agent
+	const float InvCellSize = 1.0f / QueryRadius;
+	CellHeads.Reset();
+	NextInCell.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		int32& Head = CellHeads.FindOrAdd(GetCell(Positions[Index], InvCellSize), INDEX_NONE);
+		NextInCell[Index] = Head;
+		Head = Index;
+	}
+
+	const double QueryRadiusSq = FMath::Square(QueryRadius);
+
+	ParallelFor(NumAgents, [this, InvCellSize, QueryRadiusSq, MaxNeighbours](int32 Index)
+	{
+		const FVector& Position = Positions[Index];
+		const FIntVector Cell = GetCell(Position, InvCellSize);
+
+		int32* OutNeighbours = Neighbours.GetData() + Index * MaxNeighboursLimit;
+		double DistancesSq[MaxNeighboursLimit];
+		int32 Count = 0;
+
+		for (int32 Z = -1; Z <= 1; ++Z)
+		for (int32 Y = -1; Y <= 1; ++Y)
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			const int32* Head = CellHeads.Find(Cell + FIntVector(X, Y, Z));
+			for (int32 Other = Head ? *Head : INDEX_NONE; Other != INDEX_NONE; Other = NextInCell[Other])
+			{
+				if (Other == Index)
+				{
+					continue;
+				}
+
+				const double DistSq = FVector::DistSquared(Position, Positions[Other]);
+				if (DistSq > QueryRadiusSq || (Count == MaxNeighbours && DistSq >= DistancesSq[Count - 1]))
+				{
+					continue;
+				}
+
+				// Insertion into the nearest-first list, dropping the farthest once full
+				int32 Slot = Count < MaxNeighbours ? Count++ : Count - 1;
+				while (Slot > 0 && DistancesSq[Slot - 1] > DistSq)
+				{
+					DistancesSq[Slot] = DistancesSq[Slot - 1];
+					OutNeighbours[Slot] = OutNeighbours[Slot - 1];
+					--Slot;
+				}
+				DistancesSq[Slot] = DistSq;
+				OutNeighbours[Slot] = Other;
+			}
+		}
+
+		NeighbourCounts[Index] = Count;
+	});
+}
+
+void FDroneAvoidance::Solve(const FDroneNeighbourQuery& Query, TConstArrayView<FVector> PreferredVelocities, TConstArrayView<float> MaxSpeeds,
+	TConstArrayView<bool> Responsive, const FParams& Params, TArrayView<FVector> OutVelocities)
+{
+	const int32 NumAgents = Query.Num();
+	check(PreferredVelocities.Num() == NumAgents && MaxSpeeds.Num() == NumAgents && Responsive.Num() == NumAgents && OutVelocities.Num() == NumAgents);
+
+	const float InvTimeHorizon = 1.0f / FMath::Max(Params.TimeHorizon, UE_KINDA_SMALL_NUMBER);
+	const float InvDeltaTime = 1.0f / FMath::Max(Params.DeltaTime, UE_KINDA_SMALL_NUMBER);
+	const int32 SolverIterations = FMath::Max(Params.SolverIterations, 1);
+
+	ParallelFor(NumAgents, [&](int32 Index)
+	{
+		const FVector& Preferred = PreferredVelocities[Index];
+		const int32 Count = Query.NeighbourCounts[Index];
+
+		if (!Responsive[Index] || Count == 0)
+		{
+			OutVelocities[Index] = Preferred;
+			return;
+		}
+
+		const FVector& Position = Query.Positions[Index];
+		const FVector& Velocity = Query.Velocities[Index];
+		const int32* Neighbours = Query.GetNeighbours(Index);
+
+		FOrcaPlane Planes[FDroneNeighbourQuery::MaxNeighboursLimit];
+		for (int32 Slot = 0; Slot < Count; ++Slot)
+		{
+			const int32 Other = Neighbours[Slot];
+			// Share the work with other avoiding drones, take all of it against player-driven ones
+			const float Responsibility = Responsive[Other] ? 0.5f : 1.0f;
+			Planes[Slot] = MakeOrcaPlane(Position, Velocity, Query.Positions[Other], Query.Velocities[Other],
+				Query.Radii[Index] + Query.Radii[Other], Responsibility, InvTimeHorizon, InvDeltaTime);
+		}
+
+		// Cyclic projection onto the violated half-spaces instead of the exact 3D linear program;
+		// a few passes converge closely enough for steering and keep the cost fixed per neighbour
+		const float MaxSpeed = MaxSpeeds[Index];
+		FVector Result = Preferred.GetClampedToMaxSize(MaxSpeed);
+		for (int32 Iteration = 0; Iteration < SolverIterations; ++Iteration)
+		{
+			bool bSatisfied = true;
+			for (int32 Slot = 0; Slot < Count; ++Slot)
+			{
+				const double Violation = FVector::DotProduct(Planes[Slot].Point - Result, Planes[Slot].Normal);
+				if (Violation > 0.0)
+				{
+					Result += Violation * Planes[Slot].Normal;
+					bSatisfied = false;
+				}
+			}
+
+			Result = Result.GetClampedToMaxSize(MaxSpeed);
+			if (bSatisfied)
+			{
+				break;
+			}
+		}
+
+		OutVelocities[Index] = Result;
+	});
+}
@@ -0,0 +1,393 @@
+﻿#include "AIDroneDistanceField.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Async/MappedFileHandle.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	constexpr float DistanceInfinity = 1.0e20f;
+
+	// Felzenszwalb & Huttenlocher exact 1D squared distance transform
+	void DistanceTransform1D(const float* F, int32 Num, float* D, int32* V, float* Z)
+	{
+		int32 K = 0;
+		V[0] = 0;
+		Z[0] = -DistanceInfinity;
+		Z[1] = DistanceInfinity;
+		for (int32 Q = 1; Q < Num; ++Q)
+		{
+			float S = ((F[Q] + Q * Q) - (F[V[K]] + V[K] * V[K])) / (2 * Q - 2 * V[K]);
+			while (S <= Z[K])
+			{
+				--K;
+				S = ((F[Q] + Q * Q) - (F[V[K]] + V[K] * V[K])) / (2 * Q - 2 * V[K]);
+			}
+			++K;
+			V[K] = Q;
+			Z[K] = S;
+			Z[K + 1] = DistanceInfinity;
+		}
+
+		K = 0;
+		for (int32 Q = 0; Q < Num; ++Q)
+		{
+			while (Z[K + 1] < Q)
+			{
+				++K;
+			}
+			D[Q] = FMath::Square(float(Q - V[K])) + F[V[K]];
+		}
+	}
+
+	void DistanceTransformAxis(TArray64<float>& Grid, const FIntVector& Num, int32 Axis)
+	{
+		const int64 Strides[3] = { 1, Num.X, int64(Num.X) * Num.Y };
+		const int32 AxisA = (Axis + 1) % 3;
+		const int32 AxisB = (Axis + 2) % 3;
+		const int32 Length = Num[Axis];
+
+		ParallelFor(Num[AxisA] * Num[AxisB], [&](int32 Line)
+		{
+			const int64 Base = (Line % Num[AxisA]) * Strides[AxisA] + (Line / Num[AxisA]) * Strides[AxisB];
+
+			TArray<float> F, D, Z;
+			TArray<int32> V;
+			F.SetNumUninitialized(Length);
+			D.SetNumUninitialized(Length);
+			V.SetNumUninitialized(Length);
+			Z.SetNumUninitialized(Length + 1);
+
+			for (int32 Index = 0; Index < Length; ++Index)
+			{
+				F[Index] = Grid[Base + Index * Strides[Axis]];
+			}
+			DistanceTransform1D(F.GetData(), Length, D.GetData(), V.GetData(), Z.GetData());
+			for (int32 Index = 0; Index < Length; ++Index)
+			{
+				Grid[Base + Index * Strides[Axis]] = D[Index];
+			}
+		});
+	}
+
+	FORCEINLINE uint8 QuantizeDistance(float Distance, float MaxDistance)
+	{
+		const float Normalized = (FMath::Clamp(Distance, -MaxDistance, MaxDistance) + MaxDistance) / (2.0f * MaxDistance);
+		return uint8(FMath::RoundToInt(Normalized * 255.0f));
+	}
+}
+
+FDroneDistanceField::FDroneDistanceField() = default;
+
+FDroneDistanceField::~FDroneDistanceField()
+{
+	Unload();
+}
+
+FString FDroneDistanceField::GetBakePath(const FString& MapName)
+{
+	return FPaths::ProjectContentDir() / TEXT("DroneData") / (MapName + TEXT(".dsdf"));
+}
+
+bool FDroneDistanceField::Bake(UWorld* World, const FBakeSettings& Settings, TArray64<uint8>& OutData)
+{
+	if (!World || !Settings.Bounds.IsValid || Settings.VoxelSize <= 0.0f || Settings.MaxDistance <= 0.0f)
+	{
+		return false;
+	}
+
+	const float VoxelSize = Settings.VoxelSize;
+	const float BrickSize = VoxelSize * BrickCells;
+	const FVector BoundsSize = Settings.Bounds.GetSize();
+	const FIntVector NumBricks(
+		FMath::Max(FMath::CeilToInt(BoundsSize.X / BrickSize), 1),
+		FMath::Max(FMath::CeilToInt(BoundsSize.Y / BrickSize), 1),
+		FMath::Max(FMath::CeilToInt(BoundsSize.Z / BrickSize), 1));
+	const FIntVector Num = NumBricks * BrickCells;
+	const int64 NumVoxels = int64(Num.X) * Num.Y * Num.Z;
+	const FVector Origin = Settings.Bounds.Min;
+
+	auto VoxelIndex = [&Num](int32 X, int32 Y, int32 Z)
+	{
+		return X + int64(Num.X) * (Y + int64(Num.Y) * Z);
+	};
+
+	// Occupancy of the static world; one coarse overlap rejects empty bricks before their 512 voxels
+	FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(DroneDistanceFieldBake), false);
+	const FCollisionShape VoxelShape = FCollisionShape::MakeBox(FVector(VoxelSize * 0.5f));
+	const FCollisionShape BrickShape = FCollisionShape::MakeBox(FVector(BrickSize * 0.5f));
+
+	TArray64<uint8> Occupied;
+	Occupied.SetNumZeroed(NumVoxels);
+	int64 NumOccupied = 0;
+
+	for (int32 BZ = 0; BZ < NumBricks.Z; ++BZ)
+	for (int32 BY = 0; BY < NumBricks.Y; ++BY)
+	for (int32 BX = 0; BX < NumBricks.X; ++BX)
+	{
+		const FVector BrickMin = Origin + FVector(BX, BY, BZ) * BrickSize;
+		if (!World->OverlapAnyTestByObjectType(BrickMin + FVector(BrickSize * 0.5f), FQuat::Identity, ObjectParams, BrickShape, QueryParams))
+		{
+			continue;
+		}
+
+		for (int32 Z = 0; Z < BrickCells; ++Z)
+		for (int32 Y = 0; Y < BrickCells; ++Y)
+		for (int32 X = 0; X < BrickCells; ++X)
+		{
+			const FVector Center = BrickMin + (FVector(X, Y, Z) + 0.5) * VoxelSize;
+			if (World->OverlapAnyTestByObjectType(Center, FQuat::Identity, ObjectParams, VoxelShape, QueryParams))
+			{
+				Occupied[VoxelIndex(BX * BrickCells + X, BY * BrickCells + Y, BZ * BrickCells + Z)] = 1;
+				++NumOccupied;
+			}
+		}
+	}
+
+	// Exact squared euclidean distance to the nearest occupied voxel, and to the nearest free one for the interior
+	TArray64<float> Outside;
+	TArray64<float> Inside;
+	Outside.SetNumUninitialized(NumVoxels);
+	Inside.SetNumUninitialized(NumVoxels);
+	for (int64 Index = 0; Index < NumVoxels; ++Index)
+	{
+		Outside[Index] = Occupied[Index] ? 0.0f : DistanceInfinity;
+		Inside[Index] = Occupied[Index] ? DistanceInfinity : 0.0f;
+	}
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		DistanceTransformAxis(Outside, Num, Axis);
+		DistanceTransformAxis(Inside, Num, Axis);
+	}
+
+	auto SignedDistance = [&](int32 X, int32 Y, int32 Z)
+	{
+		const int64 Index = VoxelIndex(FMath::Min(X, Num.X - 1), FMath::Min(Y, Num.Y - 1), FMath::Min(Z, Num.Z - 1));
+		// Centre-to-centre distances, shifted by half a voxel to approximate the surface in between
+		return Occupied[Index]
+			? -(FMath::Sqrt(Inside[Index]) - 0.5f) * VoxelSize
+			: (FMath::Sqrt(Outside[Index]) - 0.5f) * VoxelSize;
+	};
+
+	FDroneDistanceFieldHeader BakeHeader;
+	BakeHeader.Origin = FVector3f(Origin);
+	BakeHeader.VoxelSize = VoxelSize;
+	BakeHeader.MaxDistance = Settings.MaxDistance;
+	BakeHeader.NumBricks = NumBricks;
+	BakeHeader.IndexOffset = sizeof(FDroneDistanceFieldHeader);
+
+	const int64 NumBrickEntries = int64(NumBricks.X) * NumBricks.Y * NumBricks.Z;
+	TArray<uint32> BrickTable;
+	BrickTable.SetNumUninitialized(IntCastChecked<int32>(NumBrickEntries));
+	TArray64<uint8> Bricks;
+	uint8 Samples[BrickBytes];
+
+	for (int32 BZ = 0; BZ < NumBricks.Z; ++BZ)
+	for (int32 BY = 0; BY < NumBricks.Y; ++BY)
+	for (int32 BX = 0; BX < NumBricks.X; ++BX)
+	{
+		bool bAllEmpty = true;
+		bool bAllSolid = true;
+		int32 SampleIndex = 0;
+		for (int32 Z = 0; Z < BrickSamples; ++Z)
+		for (int32 Y = 0; Y < BrickSamples; ++Y)
+		for (int32 X = 0; X < BrickSamples; ++X)
+		{
+			const uint8 Quantized = QuantizeDistance(SignedDistance(BX * BrickCells + X, BY * BrickCells + Y, BZ * BrickCells + Z), Settings.MaxDistance);
+			bAllEmpty &= Quantized == MAX_uint8;
+			bAllSolid &= Quantized == 0;
+			Samples[SampleIndex++] = Quantized;
+		}
+
+		uint32& Entry = BrickTable[BX + NumBricks.X * (BY + NumBricks.Y * BZ)];
+		if (bAllEmpty)
+		{
+			Entry = EmptyBrick;
+		}
+		else if (bAllSolid)
+		{
+			Entry = SolidBrick;
+		}
+		else
+		{
+			Entry = BakeHeader.NumStoredBricks++;
+			Bricks.Append(Samples, BrickBytes);
+		}
+	}
+
+	BakeHeader.PayloadOffset = Align(BakeHeader.IndexOffset + NumBrickEntries * sizeof(uint32), 16);
+
+	OutData.SetNumZeroed(BakeHeader.PayloadOffset + Bricks.Num());
+	FMemory::Memcpy(OutData.GetData(), &BakeHeader, sizeof(BakeHeader));
+	FMemory::Memcpy(OutData.GetData() + BakeHeader.IndexOffset, BrickTable.GetData(), BrickTable.Num() * sizeof(uint32));
+	FMemory::Memcpy(OutData.GetData() + BakeHeader.PayloadOffset, Bricks.GetData(), Bricks.Num());
+
+	UE_LOG(LogAIDrone, Log, TEXT("Baked drone distance field: %d x %d x %d bricks, %u stored, %lld occupied voxels, %lld bytes"),
+		NumBricks.X, NumBricks.Y, NumBricks.Z, BakeHeader.NumStoredBricks, NumOccupied, OutData.Num());
+	return true;
+}
+
+bool FDroneDistanceField::Load(const FString& Path)
+{
+	Unload();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	int64 Size = 0;
+
+	MappedHandle.Reset(PlatformFile.OpenMapped(*Path));
+	if (MappedHandle)
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+	}
+
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedHandle.Reset();
+		if (!FFileHelper::LoadFileToArray(LoadedData, *Path, FILEREAD_Silent))
+		{
+			return false;
+		}
+		Data = LoadedData.GetData();
+		Size = LoadedData.Num();
+	}
+
+	if (Size < int64(sizeof(FDroneDistanceFieldHeader)))
+	{
+		Unload();
+		return false;
+	}
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+	const int64 NumBrickEntries = int64(Header.NumBricks.X) * Header.NumBricks.Y * Header.NumBricks.Z;
+	if (Header.Magic != FDroneDistanceFieldHeader::ExpectedMagic
+		|| Header.Version != FDroneDistanceFieldHeader::CurrentVersion
+		|| Header.VoxelSize <= 0.0f
+		|| NumBrickEntries <= 0
+		|| int64(Header.IndexOffset) + NumBrickEntries * int64(sizeof(uint32)) > Size
+		|| int64(Header.PayloadOffset) + int64(Header.NumStoredBricks) * BrickBytes > Size)
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Ignoring invalid or outdated drone distance field '%s'"), *Path);
+		Unload();
+		return false;
+	}
+
+	BrickIndex = reinterpret_cast<const uint32*>(Data + Header.IndexOffset);
+	Payload = Data + Header.PayloadOffset;
+	InvVoxelSize = 1.0f / Header.VoxelSize;
+	NumSamples = Header.NumBricks * BrickCells;
+	return true;
+}
+
+void FDroneDistanceField::Unload()
+{
+	Data = nullptr;
+	BrickIndex = nullptr;
+	Payload = nullptr;
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	LoadedData.Empty();
+}
+
+FBox FDroneDistanceField::GetBounds() const
+{
+	const FVector Origin(Header.Origin);
+	return FBox(Origin, Origin + FVector(NumSamples) * Header.VoxelSize);
+}
+
+bool FDroneDistanceField::Sample(const FVector& Location, float& OutDistance, FVector& OutGradient) const
+{
+	if (!Data)
+	{
+		return false;
+	}
+
+	// Continuous sample coordinates; samples sit at voxel centres
+	const FVector3f Local = (FVector3f(Location) - Header.Origin) * InvVoxelSize - FVector3f(0.5f);
+	if (Local.X < 0.0f || Local.Y < 0.0f || Local.Z < 0.0f
+		|| Local.X >= NumSamples.X - 1 || Local.Y >= NumSamples.Y - 1 || Local.Z >= NumSamples.Z - 1)
+	{
+		return false;
+	}
+
+	const FIntVector Cell(FMath::FloorToInt32(Local.X), FMath::FloorToInt32(Local.Y), FMath::FloorToInt32(Local.Z));
+	const FIntVector Brick(Cell.X / BrickCells, Cell.Y / BrickCells, Cell.Z / BrickCells);
+	const uint32 Entry = BrickIndex[Brick.X + Header.NumBricks.X * (Brick.Y + Header.NumBricks.Y * Brick.Z)];
+
+	if (Entry == EmptyBrick || Entry == SolidBrick)
+	{
+		OutDistance = Entry == EmptyBrick ? Header.MaxDistance : -Header.MaxDistance;
+		OutGradient = FVector::ZeroVector;
+		return true;
+	}
+
+	const uint8* Samples = Payload + uint64(Entry) * BrickBytes;
+	const int32 Base = (Cell.X - Brick.X * BrickCells) + BrickSamples * ((Cell.Y - Brick.Y * BrickCells) + BrickSamples * (Cell.Z - Brick.Z * BrickCells));
+	constexpr int32 StrideY = BrickSamples;
+	constexpr int32 StrideZ = BrickSamples * BrickSamples;
+
+	const float C000 = Samples[Base];
+	const float C100 = Samples[Base + 1];
+	const float C010 = Samples[Base + StrideY];
+	const float C110 = Samples[Base + StrideY + 1];
+	const float C001 = Samples[Base + StrideZ];
+	const float C101 = Samples[Base + StrideZ + 1];
+	const float C011 = Samples[Base + StrideZ + StrideY];
+	const float C111 = Samples[Base + StrideZ + StrideY + 1];
+
+	const float FX = Local.X - Cell.X;
+	const float FY = Local.Y - Cell.Y;
+	const float FZ = Local.Z - Cell.Z;
+
+	const float C00 = FMath::Lerp(C000, C100, FX);
+	const float C10 = FMath::Lerp(C010, C110, FX);
+	const float C01 = FMath::Lerp(C001, C101, FX);
+	const float C11 = FMath::Lerp(C011, C111, FX);
+	const float C0 = FMath::Lerp(C00, C10, FY);
+	const float C1 = FMath::Lerp(C01, C11, FY);
+
+	// Analytic gradient of the trilinear interpolant
+	const float DX = FMath::Lerp(FMath::Lerp(C100 - C000, C110 - C010, FY), FMath::Lerp(C101 - C001, C111 - C011, FY), FZ);
+	const float DY = FMath::Lerp(FMath::Lerp(C010 - C000, C110 - C100, FX), FMath::Lerp(C011 - C001, C111 - C101, FX), FZ);
+	const float DZ = C1 - C0;
+
+	OutDistance = FMath::Lerp(C0, C1, FZ) * (2.0f * Header.MaxDistance / 255.0f) - Header.MaxDistance;
+	OutGradient = FVector(DX, DY, DZ).GetSafeNormal();
+	return true;
+}
+
+bool FDroneDistanceField::Raycast(const FVector& Start, const FVector& Direction, float Distance, float Clearance, FVector& OutNormal, bool& OutInBounds) const
+{
+	OutInBounds = true;
+	const float MinStep = Header.VoxelSize * 0.5f;
+
+	for (float T = 0.0f; T <= Distance; )
+	{
+		float SampleDistance;
+		FVector Gradient;
+		if (!Sample(Start + Direction * T, SampleDistance, Gradient))
+		{
+			OutInBounds = false;
+			return false;
+		}
+
+		if (SampleDistance < Clearance)
+		{
+			OutNormal = Gradient.IsNearlyZero() ? -Direction : Gradient;
+			return true;
+		}
+
+		// Nothing can be closer than the sampled distance, so skip ahead by it
+		T += FMath::Max(SampleDistance - Clearance, MinStep);
+	}
+
+	return false;
+}
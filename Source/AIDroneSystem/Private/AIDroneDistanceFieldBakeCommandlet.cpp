@@ -0,0 +1,93 @@
+﻿#include "AIDroneDistanceFieldBakeCommandlet.h"
+#include "AIDroneDistanceField.h"
+#include "AIDroneNavVolume.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+UAIDroneDistanceFieldBakeCommandlet::UAIDroneDistanceFieldBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UAIDroneDistanceFieldBakeCommandlet::Main(const FString& Params)
+{
+	FString MapName;
+	if (!FParse::Value(*Params, TEXT("Map="), MapName))
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Usage: -run=AIDroneDistanceFieldBake -Map=/Game/Maps/MyMap [-VoxelSize=100] [-MaxDistance=800] [-Out=Path.dsdf]"));
+		return 1;
+	}
+
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Could not load map '%s'"), *MapName);
+		return 1;
+	}
+
+	// Only collision is needed; skip everything else a playable world would set up
+	World->AddToRoot();
+	World->WorldType = EWorldType::Editor;
+	if (!World->bIsWorldInitialized)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.RequiresHitProxies(false)
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(true)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(true));
+	}
+	World->UpdateWorldComponents(true, false);
+
+	FDroneDistanceField::FBakeSettings Settings;
+	float VolumeVoxelSize = TNumericLimits<float>::Max();
+	for (TActorIterator<AAIDroneNavVolume> It(World); It; ++It)
+	{
+		Settings.Bounds += It->GetBounds().GetBox();
+		VolumeVoxelSize = FMath::Min(VolumeVoxelSize, It->VoxelSize);
+	}
+
+	int32 Result = 0;
+	if (!Settings.Bounds.IsValid)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Map '%s' has no AIDroneNavVolume to bake"), *MapName);
+		Result = 1;
+	}
+	else
+	{
+		Settings.VoxelSize = VolumeVoxelSize;
+		FParse::Value(*Params, TEXT("VoxelSize="), Settings.VoxelSize);
+		FParse::Value(*Params, TEXT("MaxDistance="), Settings.MaxDistance);
+
+		FString OutPath;
+		if (!FParse::Value(*Params, TEXT("Out="), OutPath))
+		{
+			OutPath = FDroneDistanceField::GetBakePath(FPackageName::GetShortName(MapName));
+		}
+
+		TArray64<uint8> Data;
+		if (!FDroneDistanceField::Bake(World, Settings, Data) || !FFileHelper::SaveArrayToFile(Data, *OutPath))
+		{
+			UE_LOG(LogAIDrone, Error, TEXT("Failed to bake drone distance field to '%s'"), *OutPath);
+			Result = 1;
+		}
+		else
+		{
+			UE_LOG(LogAIDrone, Display, TEXT("Wrote drone distance field '%s'"), *OutPath);
+		}
+	}
+
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+	return Result;
+}
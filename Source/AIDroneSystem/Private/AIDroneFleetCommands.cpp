@@ -0,0 +1,70 @@
+﻿#include "AIDroneFleetSubsystem.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorldAndArgs DroneRecorderStartCommand(
+	TEXT("drone.Recorder.Start"),
+	TEXT("Starts recording every drone's updates to a binary file. Usage: drone.Recorder.Start [Path]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UAIDroneFleetSubsystem* FleetSubsystem = World ? World->GetSubsystem<UAIDroneFleetSubsystem>() : nullptr)
+		{
+			FleetSubsystem->StartFlightRecording(Args.Num() > 0 ? Args[0] : FDroneFlightRecorder::GetDefaultPath(UWorld::RemovePIEPrefix(World->GetMapName())));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld DroneRecorderStopCommand(
+	TEXT("drone.Recorder.Stop"),
+	TEXT("Stops the drone flight recording and closes its file."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UAIDroneFleetSubsystem* FleetSubsystem = World ? World->GetSubsystem<UAIDroneFleetSubsystem>() : nullptr)
+		{
+			FleetSubsystem->StopFlightRecording();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs DroneSnapshotSaveCommand(
+	TEXT("drone.Snapshot.Save"),
+	TEXT("Saves every drone to a binary fleet snapshot. Usage: drone.Snapshot.Save [Path]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UAIDroneFleetSubsystem* FleetSubsystem = World ? World->GetSubsystem<UAIDroneFleetSubsystem>() : nullptr)
+		{
+			FleetSubsystem->SaveSnapshot(Args.Num() > 0 ? Args[0] : FDroneFleetSnapshot::GetDefaultPath(UWorld::RemovePIEPrefix(World->GetMapName())));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs DroneSnapshotRestoreCommand(
+	TEXT("drone.Snapshot.Restore"),
+	TEXT("Adds the drones in a binary fleet snapshot to the world. Usage: drone.Snapshot.Restore [Path]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UAIDroneFleetSubsystem* FleetSubsystem = World ? World->GetSubsystem<UAIDroneFleetSubsystem>() : nullptr)
+		{
+			FleetSubsystem->RestoreSnapshot(Args.Num() > 0 ? Args[0] : FDroneFleetSnapshot::GetDefaultPath(UWorld::RemovePIEPrefix(World->GetMapName())));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld DroneWorkerStatusCommand(
+	TEXT("drone.Worker.Status"),
+	TEXT("Logs whether fleet avoidance runs in a drone worker and the round-trip latency of its frames."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		const UAIDroneFleetSubsystem* FleetSubsystem = World ? World->GetSubsystem<UAIDroneFleetSubsystem>() : nullptr;
+		if (!FleetSubsystem)
+		{
+			return;
+		}
+
+		const FDroneWorkerClient& WorkerClient = FleetSubsystem->GetWorkerClient();
+		const FDroneWorkerLatency& Latency = WorkerClient.GetLatency();
+		const double NumResults = (double)FMath::Max<uint64>(Latency.NumResults, 1);
+		UE_LOG(LogAIDrone, Display, TEXT("Drone worker: %s, slot %d, worker %s"),
+			WorkerClient.IsConnected() ? TEXT("connected") : TEXT("not connected"), WorkerClient.GetSlotIndex(),
+			WorkerClient.IsWorkerAlive() ? TEXT("alive") : TEXT("not responding"));
+		UE_LOG(LogAIDrone, Display, TEXT("Drone worker: %llu results, %llu timeouts; round trip last %.3f ms, average %.3f ms, max %.3f ms; solve last %.3f ms, average %.3f ms"),
+			Latency.NumResults, Latency.NumTimeouts, Latency.LastRoundTripMs, Latency.TotalRoundTripMs / NumResults, Latency.MaxRoundTripMs,
+			Latency.LastWorkerMs, Latency.TotalWorkerMs / NumResults);
+	}));
@@ -0,0 +1,162 @@
+﻿#include "AIDroneFleetListEntry.h"
+#include "AIDroneFleetProxy.h"
+#include "Components/TextBlock.h"
+#include "GameFramework/Character.h"
+
+#define LOCTEXT_NAMESPACE "AIDroneFleetList"
+
+void UAIDroneFleetListItem::SetDrone(AAIDrone* InDrone)
+{
+	if (AAIDrone* OldDrone = Drone.Get())
+	{
+		OldDrone->OnStateChanged.Remove(StateChangedHandle);
+	}
+	StateChangedHandle.Reset();
+
+	Drone = InDrone;
+	bDormant = false;
+	if (InDrone)
+	{
+		StateChangedHandle = InDrone->OnStateChanged.AddUObject(this, &UAIDroneFleetListItem::HandleStateChanged);
+		NameText = FText::FromString(InDrone->GetName());
+	}
+	StateText = FText::GetEmpty();
+	UpdateStateText();
+}
+
+void UAIDroneFleetListItem::SetDormantRecord(AAIDroneFleetProxy* Proxy, int32 RecordId)
+{
+	SetDrone(nullptr);
+
+	bDormant = true;
+	const UClass* DroneClass = Proxy ? Proxy->GetDroneClass().Get() : nullptr;
+	NameText = FText::Format(LOCTEXT("DormantName", "{0} #{1}"), DroneClass ? DroneClass->GetDisplayNameText() : FText::GetEmpty(), RecordId);
+	StateText = FText::GetEmpty();
+	UpdateStateText();
+}
+
+void UAIDroneFleetListItem::Update(float InDistance, bool bInLinked)
+{
+	bool bChanged = bLinked != bInLinked;
+	bLinked = bInLinked;
+	Distance = InDistance;
+
+	const int32 Metres = FMath::RoundToInt(InDistance / 100.0f);
+	if (Metres != DisplayedMetres)
+	{
+		DisplayedMetres = Metres;
+		DistanceText = FText::Format(LOCTEXT("DistanceMetres", "{0} m"), Metres);
+		bChanged = true;
+	}
+
+	// FollowTarget replicates without a notify, so it is picked up here rather than from an event
+	const ACharacter* FollowTarget = Drone.IsValid() ? Drone->FollowTarget : nullptr;
+	if (FollowTarget != DisplayedFollowTarget.Get() || (!FollowTarget && FollowTargetText.IsEmpty()))
+	{
+		DisplayedFollowTarget = FollowTarget;
+		FollowTargetText = FollowTarget ? FText::FromString(FollowTarget->GetName()) : LOCTEXT("NoFollowTarget", "--");
+		bChanged = true;
+	}
+
+	bChanged |= UpdateStateText();
+
+	if (bChanged)
+	{
+		OnChanged.Broadcast();
+	}
+}
+
+void UAIDroneFleetListItem::HandleStateChanged(AAIDrone* InDrone)
+{
+	if (UpdateStateText())
+	{
+		OnChanged.Broadcast();
+	}
+}
+
+bool UAIDroneFleetListItem::UpdateStateText()
+{
+	const AAIDrone* CurrentDrone = Drone.Get();
+	const EDroneState NewState = CurrentDrone ? CurrentDrone->CurrentState : EDroneState::Idle;
+	if (NewState == State && !StateText.IsEmpty())
+	{
+		return false;
+	}
+
+	State = NewState;
+	if (bDormant)
+	{
+		StateText = LOCTEXT("StateDormant", "Dormant");
+		return true;
+	}
+
+	switch (State)
+	{
+	case EDroneState::Idle:
+		StateText = LOCTEXT("StateIdle", "Idle");
+		break;
+	case EDroneState::Following:
+		StateText = LOCTEXT("StateFollowing", "Following");
+		break;
+	case EDroneState::Possessed:
+		StateText = LOCTEXT("StatePossessed", "Player Controlled");
+		break;
+	default:
+		StateText = LOCTEXT("StateUnknown", "Unknown");
+		break;
+	}
+	return true;
+}
+
+void UAIDroneFleetEntryWidget::NativeOnListItemObjectSet(UObject* ListItemObject)
+{
+	IUserObjectListEntry::NativeOnListItemObjectSet(ListItemObject);
+
+	if (Item)
+	{
+		Item->OnChanged.Remove(ItemChangedHandle);
+	}
+
+	Item = Cast<UAIDroneFleetListItem>(ListItemObject);
+	if (Item)
+	{
+		ItemChangedHandle = Item->OnChanged.AddUObject(this, &UAIDroneFleetEntryWidget::HandleItemChanged);
+		HandleItemChanged();
+	}
+}
+
+void UAIDroneFleetEntryWidget::NativeOnEntryReleased()
+{
+	if (Item)
+	{
+		Item->OnChanged.Remove(ItemChangedHandle);
+		Item = nullptr;
+	}
+	ItemChangedHandle.Reset();
+
+	IUserObjectListEntry::NativeOnEntryReleased();
+}
+
+void UAIDroneFleetEntryWidget::HandleItemChanged()
+{
+	if (NameText)
+	{
+		NameText->SetText(Item->NameText);
+	}
+	if (StateText)
+	{
+		StateText->SetText(Item->StateText);
+	}
+	if (DistanceText)
+	{
+		DistanceText->SetText(Item->DistanceText);
+	}
+	if (FollowTargetText)
+	{
+		FollowTargetText->SetText(Item->FollowTargetText);
+	}
+
+	OnItemChanged(Item);
+}
+
+#undef LOCTEXT_NAMESPACE
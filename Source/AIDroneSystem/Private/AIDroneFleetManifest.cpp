@@ -0,0 +1,23 @@
+﻿#include "AIDroneFleetManifest.h"
+#include "AIDrone.h"
+
+int32 UAIDroneFleetManifest::GetNumDrones() const
+{
+	int32 NumDrones = 0;
+	for (const FDroneFleetGroup& Group : Groups)
+	{
+		NumDrones += Group.Placements.Num();
+	}
+	return NumDrones;
+}
+
+void UAIDroneFleetManifest::GetDroneClassPaths(TArray<FSoftObjectPath>& OutPaths) const
+{
+	for (const FDroneFleetGroup& Group : Groups)
+	{
+		if (!Group.DroneClass.IsNull())
+		{
+			OutPaths.AddUnique(Group.DroneClass.ToSoftObjectPath());
+		}
+	}
+}
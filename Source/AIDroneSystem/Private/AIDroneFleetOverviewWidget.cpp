@@ -0,0 +1,239 @@
+﻿#include "AIDroneFleetOverviewWidget.h"
+#include "AIDrone.h"
+#include "AIDroneFleetListEntry.h"
+#include "AIDroneFleetProxy.h"
+#include "AIDroneFleetSubsystem.h"
+#include "AIDroneHUDWidget.h"
+#include "Algo/Sort.h"
+#include "Components/ListView.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "TimerManager.h"
+
+namespace AIDroneFleetOverview
+{
+	/** Plain data for one candidate row, so filtering and sorting never touch a widget or list item */
+	struct FRow
+	{
+		TPair<FObjectKey, int32> Key;
+		AAIDrone* Drone = nullptr;
+		AAIDroneFleetProxy* Proxy = nullptr;
+		int32 RecordId = INDEX_NONE;
+		double DistanceSq = 0.0;
+		FName SortName;
+		EDroneState State = EDroneState::Idle;
+		bool bDormant = false;
+	};
+}
+
+void UAIDroneFleetOverviewWidget::NativeConstruct()
+{
+	Super::NativeConstruct();
+
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	FleetSubsystem = World->GetSubsystem<UAIDroneFleetSubsystem>();
+	if (FleetSubsystem.IsValid())
+	{
+		FleetChangedHandle = FleetSubsystem->OnFleetChanged.AddUObject(this, &UAIDroneFleetOverviewWidget::HandleFleetChanged);
+	}
+
+	World->GetTimerManager().SetTimer(RefreshTimer, this, &UAIDroneFleetOverviewWidget::Refresh, FMath::Max(RefreshInterval, 0.05f), true, 0.0f);
+}
+
+void UAIDroneFleetOverviewWidget::NativeDestruct()
+{
+	if (UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().ClearAllTimersForObject(this);
+	}
+	bRefreshQueued = false;
+
+	if (UAIDroneFleetSubsystem* Fleet = FleetSubsystem.Get())
+	{
+		Fleet->OnFleetChanged.Remove(FleetChangedHandle);
+	}
+	FleetChangedHandle.Reset();
+
+	Super::NativeDestruct();
+}
+
+void UAIDroneFleetOverviewWidget::SetSortMode(EDroneFleetSortMode InSortMode)
+{
+	if (SortMode != InSortMode)
+	{
+		SortMode = InSortMode;
+		RequestRefresh();
+	}
+}
+
+void UAIDroneFleetOverviewWidget::RequestRefresh()
+{
+	UWorld* World = GetWorld();
+	if (World && !bRefreshQueued)
+	{
+		bRefreshQueued = true;
+		World->GetTimerManager().SetTimerForNextTick(this, &UAIDroneFleetOverviewWidget::Refresh);
+	}
+}
+
+void UAIDroneFleetOverviewWidget::HandleFleetChanged()
+{
+	// Spawning a wave fires this once per drone; one rebuild next frame covers all of them
+	RequestRefresh();
+}
+
+UAIDroneFleetListItem* UAIDroneFleetOverviewWidget::FindOrAddItem(const FRowKey& Key, bool& bOutAdded)
+{
+	if (TObjectPtr<UAIDroneFleetListItem>* Existing = ItemsByKey.Find(Key))
+	{
+		bOutAdded = false;
+		return *Existing;
+	}
+
+	bOutAdded = true;
+	return NewObject<UAIDroneFleetListItem>(this);
+}
+
+void UAIDroneFleetOverviewWidget::Refresh()
+{
+	using AIDroneFleetOverview::FRow;
+
+	bRefreshQueued = false;
+
+	const UAIDroneFleetSubsystem* Fleet = FleetSubsystem.Get();
+	APlayerController* PlayerController = GetOwningPlayer();
+	if (!Fleet || !PlayerController || !DroneList)
+	{
+		return;
+	}
+
+	FVector Origin;
+	if (const APawn* Pawn = PlayerController->GetPawn())
+	{
+		Origin = Pawn->GetActorLocation();
+	}
+	else
+	{
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(Origin, ViewRotation);
+	}
+
+	const double RangeSq = Range > 0.0f ? FMath::Square((double)Range) : TNumericLimits<double>::Max();
+	const AAIDrone* LinkedDrone = UAIDroneHUDWidget::GetTargetDrone(PlayerController->GetPawn());
+
+	TArray<FRow> Rows;
+	Rows.Reserve(Fleet->GetDrones().Num());
+	for (AAIDrone* Drone : Fleet->GetDrones())
+	{
+		if (!(StateFilter & (1 << (int32)Drone->CurrentState)))
+		{
+			continue;
+		}
+
+		const double DistanceSq = FVector::DistSquared(Origin, Drone->GetActorLocation());
+		if (DistanceSq <= RangeSq)
+		{
+			FRow& Row = Rows.AddDefaulted_GetRef();
+			Row.Key = FRowKey(FObjectKey(Drone), INDEX_NONE);
+			Row.Drone = Drone;
+			Row.DistanceSq = DistanceSq;
+			Row.SortName = Drone->GetFName();
+			Row.State = Drone->CurrentState;
+		}
+	}
+
+	if (bShowDormant)
+	{
+		for (AAIDroneFleetProxy* Proxy : Fleet->GetProxies())
+		{
+			const FName ClassName = Proxy->GetDroneClass() ? Proxy->GetDroneClass()->GetFName() : NAME_None;
+			for (const FDroneFleetRecord& Record : Proxy->GetRecords())
+			{
+				const double DistanceSq = FVector::DistSquared(Origin, FVector(Record.Location));
+				if (DistanceSq <= RangeSq)
+				{
+					FRow& Row = Rows.AddDefaulted_GetRef();
+					Row.Key = FRowKey(FObjectKey(Proxy), Record.RecordId);
+					Row.Proxy = Proxy;
+					Row.RecordId = Record.RecordId;
+					Row.DistanceSq = DistanceSq;
+					Row.SortName = FName(ClassName, Record.RecordId);
+					Row.bDormant = true;
+				}
+			}
+		}
+	}
+
+	switch (SortMode)
+	{
+	case EDroneFleetSortMode::Name:
+		Algo::Sort(Rows, [](const FRow& A, const FRow& B) { return A.SortName.LexicalLess(B.SortName); });
+		break;
+	case EDroneFleetSortMode::State:
+		// Dormant drones sort after every awake state
+		Algo::Sort(Rows, [](const FRow& A, const FRow& B)
+		{
+			const int32 StateA = A.bDormant ? MAX_uint8 : (int32)A.State;
+			const int32 StateB = B.bDormant ? MAX_uint8 : (int32)B.State;
+			return StateA != StateB ? StateA < StateB : A.DistanceSq < B.DistanceSq;
+		});
+		break;
+	default:
+		Algo::Sort(Rows, [](const FRow& A, const FRow& B) { return A.DistanceSq < B.DistanceSq; });
+		break;
+	}
+
+	// Items are reused across refreshes so rows that stay listed keep their entry widget and cached text
+	TArray<UObject*> NewItems;
+	NewItems.Reserve(Rows.Num());
+	TMap<FRowKey, TObjectPtr<UAIDroneFleetListItem>> NewItemsByKey;
+	NewItemsByKey.Reserve(Rows.Num());
+	for (const FRow& Row : Rows)
+	{
+		bool bAdded;
+		UAIDroneFleetListItem* Item = FindOrAddItem(Row.Key, bAdded);
+		if (bAdded)
+		{
+			if (Row.bDormant)
+			{
+				Item->SetDormantRecord(Row.Proxy, Row.RecordId);
+			}
+			else
+			{
+				Item->SetDrone(Row.Drone);
+			}
+		}
+		Item->Update(FMath::Sqrt(Row.DistanceSq), Row.Drone && Row.Drone == LinkedDrone);
+
+		NewItems.Add(Item);
+		NewItemsByKey.Add(Row.Key, Item);
+	}
+
+	// Dropped items are no longer referenced by the list or by ListedItems and are left to garbage collection
+	for (const TPair<FRowKey, TObjectPtr<UAIDroneFleetListItem>>& Pair : ItemsByKey)
+	{
+		if (!NewItemsByKey.Contains(Pair.Key))
+		{
+			Pair.Value->SetDrone(nullptr);
+		}
+	}
+	ItemsByKey = MoveTemp(NewItemsByKey);
+
+	bool bOrderChanged = NewItems.Num() != ListedItems.Num();
+	for (int32 Index = 0; !bOrderChanged && Index < NewItems.Num(); ++Index)
+	{
+		bOrderChanged = NewItems[Index] != ListedItems[Index];
+	}
+
+	if (bOrderChanged)
+	{
+		ListedItems.Reset(NewItems.Num());
+		ListedItems.Append(NewItems);
+		DroneList->SetListItems(NewItems);
+	}
+}
@@ -0,0 +1,198 @@
+﻿#include "AIDroneFleetProxy.h"
+#include "AIDrone.h"
+#include "AIDroneFleetSubsystem.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+
+void FDroneFleetRecord::PostReplicatedAdd(const FDroneFleetRecordArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnRecordAdded(*this);
+	}
+}
+
+void FDroneFleetRecord::PostReplicatedChange(const FDroneFleetRecordArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnRecordChanged(*this);
+	}
+}
+
+void FDroneFleetRecord::PreReplicatedRemove(const FDroneFleetRecordArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnRecordRemoved(*this);
+	}
+}
+
+AAIDroneFleetProxy::AAIDroneFleetProxy()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+	bAlwaysRelevant = true;
+
+	// Records only change when drones go dormant or wake up, and both force an update
+	SetNetUpdateFrequency(2.0f);
+
+	Instances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Instances"));
+	Instances->SetMobility(EComponentMobility::Movable);
+	Instances->bSupportRemoveAtSwap = true;
+	RootComponent = Instances;
+
+	Records.Owner = this;
+}
+
+void AAIDroneFleetProxy::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AAIDroneFleetProxy, DroneClass);
+	DOREPLIFETIME(AAIDroneFleetProxy, Records);
+}
+
+void AAIDroneFleetProxy::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>())
+	{
+		FleetSubsystem->RegisterProxy(this);
+	}
+}
+
+void AAIDroneFleetProxy::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>())
+	{
+		FleetSubsystem->UnregisterProxy(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAIDroneFleetProxy::SetDroneClass(TSubclassOf<AAIDrone> InDroneClass)
+{
+	DroneClass = InDroneClass;
+	OnRep_DroneClass();
+}
+
+void AAIDroneFleetProxy::OnRep_DroneClass()
+{
+	// Look exactly like, and block traces exactly like, a real drone of this class
+	const AAIDrone* DefaultDrone = DroneClass ? DroneClass->GetDefaultObject<AAIDrone>() : nullptr;
+	const UStaticMeshComponent* DefaultMesh = DefaultDrone ? DefaultDrone->GetDroneMesh() : nullptr;
+	if (!DefaultMesh)
+	{
+		return;
+	}
+
+	Instances->SetStaticMesh(DefaultMesh->GetStaticMesh());
+	for (int32 MaterialIndex = 0; MaterialIndex < DefaultMesh->GetNumMaterials(); ++MaterialIndex)
+	{
+		Instances->SetMaterial(MaterialIndex, DefaultMesh->GetMaterial(MaterialIndex));
+	}
+	Instances->SetCollisionProfileName(DefaultMesh->GetCollisionProfileName());
+}
+
+FTransform AAIDroneFleetProxy::GetRecordTransform(const FDroneFleetRecord& Record)
+{
+	return FTransform(FRotator(0.0f, Record.Yaw, 0.0f), Record.Location);
+}
+
+void AAIDroneFleetProxy::AddRecord(const FDroneFleetRecord& Record)
+{
+	FDroneFleetRecord& Added = Records.Items.Add_GetRef(Record);
+	Records.MarkItemDirty(Added);
+	OnRecordAdded(Added);
+	ForceNetUpdate();
+}
+
+void AAIDroneFleetProxy::AddRecords(TConstArrayView<FDroneFleetRecord> NewRecords)
+{
+	if (NewRecords.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<FTransform> Transforms;
+	Transforms.Reserve(NewRecords.Num());
+	Records.Items.Reserve(Records.Items.Num() + NewRecords.Num());
+	InstanceRecordIds.Reserve(InstanceRecordIds.Num() + NewRecords.Num());
+
+	for (const FDroneFleetRecord& Record : NewRecords)
+	{
+		FDroneFleetRecord& Added = Records.Items.Add_GetRef(Record);
+		Records.MarkItemDirty(Added);
+		Transforms.Add(GetRecordTransform(Added));
+		InstanceRecordIds.Add(Added.RecordId);
+	}
+
+	Instances->AddInstances(Transforms, false, true);
+	NotifyFleetChanged();
+	ForceNetUpdate();
+}
+
+bool AAIDroneFleetProxy::RemoveRecord(int32 RecordId, FDroneFleetRecord& OutRecord)
+{
+	const int32 Index = Records.Items.IndexOfByPredicate([RecordId](const FDroneFleetRecord& Record) { return Record.RecordId == RecordId; });
+	if (Index == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutRecord = Records.Items[Index];
+	Records.Items.RemoveAtSwap(Index);
+	Records.MarkArrayDirty();
+	OnRecordRemoved(OutRecord);
+	ForceNetUpdate();
+	return true;
+}
+
+bool AAIDroneFleetProxy::GetRecordIdForInstance(int32 InstanceIndex, int32& OutRecordId) const
+{
+	if (InstanceRecordIds.IsValidIndex(InstanceIndex))
+	{
+		OutRecordId = InstanceRecordIds[InstanceIndex];
+		return true;
+	}
+	return false;
+}
+
+void AAIDroneFleetProxy::OnRecordAdded(const FDroneFleetRecord& Record)
+{
+	Instances->AddInstance(GetRecordTransform(Record), true);
+	InstanceRecordIds.Add(Record.RecordId);
+	NotifyFleetChanged();
+}
+
+void AAIDroneFleetProxy::OnRecordChanged(const FDroneFleetRecord& Record)
+{
+	const int32 InstanceIndex = InstanceRecordIds.IndexOfByKey(Record.RecordId);
+	if (InstanceIndex != INDEX_NONE)
+	{
+		Instances->UpdateInstanceTransform(InstanceIndex, GetRecordTransform(Record), true, true);
+	}
+}
+
+void AAIDroneFleetProxy::OnRecordRemoved(const FDroneFleetRecord& Record)
+{
+	// The component swaps the last instance into the hole, so mirror that
+	const int32 InstanceIndex = InstanceRecordIds.IndexOfByKey(Record.RecordId);
+	if (InstanceIndex != INDEX_NONE)
+	{
+		Instances->RemoveInstance(InstanceIndex);
+		InstanceRecordIds.RemoveAtSwap(InstanceIndex);
+	}
+	NotifyFleetChanged();
+}
+
+void AAIDroneFleetProxy::NotifyFleetChanged() const
+{
+	if (UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>())
+	{
+		FleetSubsystem->OnFleetChanged.Broadcast();
+	}
+}
@@ -0,0 +1,167 @@
+﻿#include "AIDroneFleetSnapshot.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+FDroneFleetSnapshot::FDroneFleetSnapshot() = default;
+
+FDroneFleetSnapshot::~FDroneFleetSnapshot()
+{
+	Unload();
+}
+
+FString FDroneFleetSnapshot::GetDefaultPath(const FString& MapName)
+{
+	return FPaths::ProjectSavedDir() / TEXT("DroneSnapshots") / MapName + TEXT(".dfs");
+}
+
+void FDroneFleetSnapshot::Build(double WorldTime, TConstArrayView<FString> InStrings, TConstArrayView<FDroneSnapshotDrone> InDrones,
+	TConstArrayView<FDroneSnapshotRecord> InRecords, TArray64<uint8>& OutData)
+{
+	FDroneSnapshotHeader SnapshotHeader;
+	SnapshotHeader.WorldTime = WorldTime;
+	SnapshotHeader.NumStrings = InStrings.Num();
+	SnapshotHeader.NumDrones = InDrones.Num();
+	SnapshotHeader.NumRecords = InRecords.Num();
+
+	OutData.Reset();
+	OutData.AddZeroed(sizeof(FDroneSnapshotHeader));
+
+	SnapshotHeader.StringsOffset = OutData.Num();
+	for (const FString& String : InStrings)
+	{
+		const FTCHARToUTF8 Utf8(*String);
+		const uint32 Length = Utf8.Length();
+		OutData.Append(reinterpret_cast<const uint8*>(&Length), sizeof(Length));
+		OutData.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Length);
+	}
+
+	OutData.SetNumZeroed(Align(OutData.Num(), 16));
+	SnapshotHeader.DronesOffset = OutData.Num();
+	OutData.Append(reinterpret_cast<const uint8*>(InDrones.GetData()), InDrones.Num() * sizeof(FDroneSnapshotDrone));
+
+	OutData.SetNumZeroed(Align(OutData.Num(), 16));
+	SnapshotHeader.RecordsOffset = OutData.Num();
+	OutData.Append(reinterpret_cast<const uint8*>(InRecords.GetData()), InRecords.Num() * sizeof(FDroneSnapshotRecord));
+
+	FMemory::Memcpy(OutData.GetData(), &SnapshotHeader, sizeof(SnapshotHeader));
+}
+
+TFuture<bool> FDroneFleetSnapshot::SaveAsync(const FString& Path, TArray64<uint8>&& InData)
+{
+	return Async(EAsyncExecution::ThreadPool, [Path, FileData = MoveTemp(InData)]()
+	{
+		const FString TempPath = Path + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(FileData, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true))
+		{
+			UE_LOG(LogAIDrone, Error, TEXT("Could not write drone fleet snapshot '%s'"), *Path);
+			IFileManager::Get().Delete(*TempPath, false, false, true);
+			return false;
+		}
+		return true;
+	});
+}
+
+bool FDroneFleetSnapshot::Load(const FString& Path, FString& OutError)
+{
+	Unload();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	int64 Size = 0;
+
+	MappedHandle.Reset(PlatformFile.OpenMapped(*Path));
+	if (MappedHandle)
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+	}
+
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedHandle.Reset();
+		if (!FFileHelper::LoadFileToArray(LoadedData, *Path, FILEREAD_Silent))
+		{
+			OutError = FString::Printf(TEXT("Could not open '%s'"), *Path);
+			return false;
+		}
+		Data = LoadedData.GetData();
+		Size = LoadedData.Num();
+	}
+
+	if (Size < int64(sizeof(FDroneSnapshotHeader)))
+	{
+		OutError = TEXT("File is too small to be a drone fleet snapshot");
+		Unload();
+		return false;
+	}
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+	if (Header.Magic != FDroneSnapshotHeader::ExpectedMagic || Header.Version != FDroneSnapshotHeader::CurrentVersion)
+	{
+		OutError = FString::Printf(TEXT("Not a version %u drone fleet snapshot"), FDroneSnapshotHeader::CurrentVersion);
+		Unload();
+		return false;
+	}
+
+	if (int64(Header.DronesOffset) + int64(Header.NumDrones) * int64(sizeof(FDroneSnapshotDrone)) > Size
+		|| int64(Header.RecordsOffset) + int64(Header.NumRecords) * int64(sizeof(FDroneSnapshotRecord)) > Size
+		|| !IsAligned(Header.DronesOffset, alignof(FDroneSnapshotDrone)) || !IsAligned(Header.RecordsOffset, alignof(FDroneSnapshotRecord)))
+	{
+		OutError = TEXT("Snapshot is truncated");
+		Unload();
+		return false;
+	}
+
+	// Strings are few and short, so they are the only part that is copied out
+	int64 Offset = Header.StringsOffset;
+	Strings.Reserve(Header.NumStrings);
+	for (uint32 Index = 0; Index < Header.NumStrings; ++Index)
+	{
+		uint32 Length = 0;
+		if (Offset + int64(sizeof(Length)) > Size)
+		{
+			break;
+		}
+		FMemory::Memcpy(&Length, Data + Offset, sizeof(Length));
+		Offset += sizeof(Length);
+		if (Offset + Length > Size)
+		{
+			break;
+		}
+
+		const FUTF8ToTCHAR String(reinterpret_cast<const UTF8CHAR*>(Data + Offset), Length);
+		Strings.Emplace(String.Length(), String.Get());
+		Offset += Length;
+	}
+
+	if (Strings.Num() != int32(Header.NumStrings))
+	{
+		OutError = TEXT("Snapshot is truncated");
+		Unload();
+		return false;
+	}
+
+	Drones = reinterpret_cast<const FDroneSnapshotDrone*>(Data + Header.DronesOffset);
+	Records = reinterpret_cast<const FDroneSnapshotRecord*>(Data + Header.RecordsOffset);
+	return true;
+}
+
+void FDroneFleetSnapshot::Unload()
+{
+	Header = FDroneSnapshotHeader();
+	Strings.Empty();
+	Data = nullptr;
+	Drones = nullptr;
+	Records = nullptr;
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	LoadedData.Empty();
+}
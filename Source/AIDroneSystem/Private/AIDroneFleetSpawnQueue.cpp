@@ -0,0 +1,561 @@
+﻿#include "AIDroneFleetSubsystem.h"
+#include "AIDrone.h"
+#include "AIDroneFleetManifest.h"
+#include "AIDroneFleetProxy.h"
+#include "AIDronePlayerController.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "AIDroneSystem/AIDroneSystemCharacter.h"
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<float> CVarDroneSpawnBudgetMs(
+	TEXT("drone.Spawn.BudgetMs"),
+	4.0f,
+	TEXT("Game thread milliseconds per frame for spawning drones from snapshots and fleet manifests; 0 spawns them all in one frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<bool> CVarDroneSnapshotRestoreIdleAsDormant(
+	TEXT("drone.Snapshot.RestoreIdleAsDormant"),
+	true,
+	TEXT("Restores idle, unlinked drones as dormant records, which wake as players approach, instead of spawning their actors."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneSnapshotAutoSaveInterval(
+	TEXT("drone.Snapshot.AutoSaveInterval"),
+	0.0f,
+	TEXT("When above 0, the server saves the map's default drone snapshot every this many seconds."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<bool> CVarDroneSnapshotAutoRestore(
+	TEXT("drone.Snapshot.AutoRestore"),
+	false,
+	TEXT("Restores the map's default drone snapshot, if there is one, when the server's world begins play."),
+	ECVF_Default);
+
+namespace AIDroneFleet
+{
+	/** Survives a reconnect or a server restart, unlike the player state itself */
+	FString GetSnapshotPlayerId(const APlayerState* PlayerState)
+	{
+		return PlayerState->GetUniqueId().IsValid() ? PlayerState->GetUniqueId().ToString() : PlayerState->GetPlayerName();
+	}
+}
+
+void UAIDroneFleetSubsystem::TickSnapshots(float DeltaTime)
+{
+	SpawnQueuedDrones();
+
+	// Players rejoin over seconds, so there is no need to look for them every frame
+	SnapshotLinkCheckTime += DeltaTime;
+	if (SnapshotLinks.Num() > 0 && SnapshotLinkCheckTime >= 0.5f)
+	{
+		SnapshotLinkCheckTime = 0.0f;
+		ResolveSnapshotLinks();
+	}
+
+	const float AutoSaveInterval = CVarDroneSnapshotAutoSaveInterval.GetValueOnGameThread();
+	SnapshotAutoSaveTime += DeltaTime;
+	if (AutoSaveInterval > 0.0f && SnapshotAutoSaveTime >= AutoSaveInterval)
+	{
+		SnapshotAutoSaveTime = 0.0f;
+		SaveSnapshot(FDroneFleetSnapshot::GetDefaultPath(UWorld::RemovePIEPrefix(GetWorld()->GetMapName())));
+	}
+}
+
+void UAIDroneFleetSubsystem::AutoRestoreSnapshot()
+{
+	if (CVarDroneSnapshotAutoRestore.GetValueOnGameThread())
+	{
+		const FString Path = FDroneFleetSnapshot::GetDefaultPath(UWorld::RemovePIEPrefix(GetWorld()->GetMapName()));
+		if (FPaths::FileExists(Path))
+		{
+			RestoreSnapshot(Path);
+		}
+	}
+}
+
+bool UAIDroneFleetSubsystem::SaveSnapshot(const FString& Path)
+{
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Drone fleet snapshots can only be saved on the server"));
+		return false;
+	}
+
+	if (SnapshotWrite.IsValid() && !SnapshotWrite.IsReady())
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Skipped saving drone fleet snapshot '%s': the previous one is still being written"), *Path);
+		return false;
+	}
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	TArray<FString> Strings;
+	TMap<FString, int32> StringIndices;
+	auto AddString = [&Strings, &StringIndices](const FString& String)
+	{
+		if (const int32* Found = StringIndices.Find(String))
+		{
+			return *Found;
+		}
+		const int32 Index = Strings.Add(String);
+		StringIndices.Add(String, Index);
+		return Index;
+	};
+
+	// Links not restored yet still belong to their players, so carry them into the new snapshot
+	TMap<const AAIDrone*, int32> LinkedPlayers;
+	TMap<const AAIDrone*, int32> FollowedPlayers;
+	for (const FSnapshotLink& Link : SnapshotLinks)
+	{
+		if (const AAIDrone* Drone = Link.Drone.Get())
+		{
+			(Link.bFollow ? FollowedPlayers : LinkedPlayers).Add(Drone, AddString(Link.PlayerId));
+		}
+	}
+
+	TMap<const AActor*, int32> CharacterPlayers;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (!PC || !PC->PlayerState)
+		{
+			continue;
+		}
+
+		const int32 PlayerIndex = AddString(AIDroneFleet::GetSnapshotPlayerId(PC->PlayerState));
+		const AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(PC);
+		for (const APawn* Pawn : { PC->GetPawn(), DronePC ? DronePC->GetPreviousPawn() : nullptr })
+		{
+			if (const AAIDroneSystemCharacter* Character = Cast<AAIDroneSystemCharacter>(Pawn))
+			{
+				CharacterPlayers.Add(Character, PlayerIndex);
+				if (Character->AIDrone)
+				{
+					LinkedPlayers.Add(Character->AIDrone, PlayerIndex);
+				}
+			}
+			else if (const AAIDrone* Drone = Cast<AAIDrone>(Pawn))
+			{
+				LinkedPlayers.Add(Drone, PlayerIndex);
+			}
+		}
+	}
+
+	TArray<FDroneSnapshotDrone> SavedDrones;
+	SavedDrones.Reserve(Drones.Num() + GetNumQueuedSpawns());
+	for (const AAIDrone* Drone : Drones)
+	{
+		FDroneSnapshotDrone& Saved = SavedDrones.AddDefaulted_GetRef();
+		Saved.Location = FVector3f(Drone->GetActorLocation());
+		Saved.Yaw = Drone->GetActorRotation().Yaw;
+		Saved.Velocity = FVector3f(Drone->GetVelocity());
+		Saved.HoverTime = Drone->HoverTime;
+		Saved.ClassIndex = AddString(Drone->GetClass()->GetPathName());
+		Saved.State = (uint8)Drone->CurrentState;
+
+		if (const int32* PlayerIndex = LinkedPlayers.Find(Drone))
+		{
+			Saved.LinkedPlayerIndex = *PlayerIndex;
+		}
+
+		// Saved whatever the state, so the player is not lost while a follow is pending; the restore checks State before following
+		const int32* FollowIndex = Drone->FollowTarget ? CharacterPlayers.Find(Drone->FollowTarget) : nullptr;
+		FollowIndex = FollowIndex ? FollowIndex : FollowedPlayers.Find(Drone);
+		Saved.FollowPlayerIndex = FollowIndex ? *FollowIndex : INDEX_NONE;
+	}
+
+	// Drones from a restore or a manifest that have not spawned yet
+	for (int32 Index = NextQueuedSpawn; Index < SpawnQueue.Num(); ++Index)
+	{
+		FDroneSnapshotDrone Saved = SpawnQueue[Index];
+		Saved.ClassIndex = AddString(SpawnQueueStrings[Saved.ClassIndex]);
+		Saved.FollowPlayerIndex = SpawnQueueStrings.IsValidIndex(Saved.FollowPlayerIndex) ? AddString(SpawnQueueStrings[Saved.FollowPlayerIndex]) : INDEX_NONE;
+		Saved.LinkedPlayerIndex = SpawnQueueStrings.IsValidIndex(Saved.LinkedPlayerIndex) ? AddString(SpawnQueueStrings[Saved.LinkedPlayerIndex]) : INDEX_NONE;
+		SavedDrones.Add(Saved);
+	}
+
+	TArray<FDroneSnapshotRecord> SavedRecords;
+	for (const AAIDroneFleetProxy* Proxy : Proxies)
+	{
+		if (!Proxy->GetDroneClass())
+		{
+			continue;
+		}
+
+		const uint32 ClassIndex = AddString(Proxy->GetDroneClass()->GetPathName());
+		SavedRecords.Reserve(SavedRecords.Num() + Proxy->GetRecords().Num());
+		for (const FDroneFleetRecord& Record : Proxy->GetRecords())
+		{
+			FDroneSnapshotRecord& Saved = SavedRecords.AddDefaulted_GetRef();
+			Saved.Location = FVector3f(Record.Location);
+			Saved.Yaw = Record.Yaw;
+			Saved.ClassIndex = ClassIndex;
+		}
+	}
+
+	TArray64<uint8> Data;
+	FDroneFleetSnapshot::Build(GetWorld()->GetTimeSeconds(), Strings, SavedDrones, SavedRecords, Data);
+	SnapshotWrite = FDroneFleetSnapshot::SaveAsync(Path, MoveTemp(Data));
+
+	UE_LOG(LogAIDrone, Log, TEXT("Saving %d drones and %d dormant drones to '%s' (%.2f ms on the game thread)"),
+		SavedDrones.Num(), SavedRecords.Num(), *Path, FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+	return true;
+}
+
+bool UAIDroneFleetSubsystem::RestoreSnapshot(const FString& Path)
+{
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Drone fleet snapshots can only be restored on the server"));
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	FDroneFleetSnapshot Snapshot;
+	FString Error;
+	if (!Snapshot.Load(Path, Error))
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Could not restore drone fleet snapshot '%s': %s"), *Path, *Error);
+		return false;
+	}
+
+	if (SpawnRequestTime == 0.0)
+	{
+		SpawnRequestTime = StartTime;
+	}
+
+	// The snapshot's strings go after whatever the queue still holds, so its indices move by that much
+	const int32 StringBase = SpawnQueueStrings.Num();
+	SpawnQueueStrings.Append(Snapshot.GetStrings());
+	SpawnQueueClasses.AddZeroed(Snapshot.GetStrings().Num());
+
+	auto ResolveClass = [this, StringBase](uint32 ClassIndex) -> UClass*
+	{
+		const int32 Index = StringBase + ClassIndex;
+		if (!SpawnQueueClasses.IsValidIndex(Index))
+		{
+			return nullptr;
+		}
+
+		if (!SpawnQueueClasses[Index])
+		{
+			UClass* Class = LoadClass<AAIDrone>(nullptr, *SpawnQueueStrings[Index]);
+			if (!Class)
+			{
+				UE_LOG(LogAIDrone, Warning, TEXT("Drone snapshot: could not load '%s'; restoring AAIDrone"), *SpawnQueueStrings[Index]);
+				Class = AAIDrone::StaticClass();
+			}
+			SpawnQueueClasses[Index] = Class;
+		}
+		return SpawnQueueClasses[Index];
+	};
+
+	// Every record of a class goes onto its proxy in one batch instead of one instance and one net update each
+	TMap<UClass*, TArray<FDroneFleetRecord>> RecordsByClass;
+	auto AddRecord = [this, &RecordsByClass](UClass* Class, const FVector3f& Location, float Yaw)
+	{
+		FDroneFleetRecord& Record = RecordsByClass.FindOrAdd(Class).AddDefaulted_GetRef();
+		Record.RecordId = NextRecordId++;
+		Record.Location = FVector(Location);
+		Record.Yaw = Yaw;
+	};
+
+	for (const FDroneSnapshotRecord& Saved : Snapshot.GetRecords())
+	{
+		if (UClass* Class = ResolveClass(Saved.ClassIndex))
+		{
+			AddRecord(Class, Saved.Location, Saved.Yaw);
+		}
+	}
+
+	// Records only wake up through dormancy checks, so they are no shortcut when dormancy is off
+	const bool bIdleAsDormant = CVarDroneSnapshotRestoreIdleAsDormant.GetValueOnGameThread() && IsDormancyEnabled();
+	int32 NumQueued = 0;
+	SpawnQueue.Reserve(SpawnQueue.Num() + Snapshot.GetDrones().Num());
+	for (const FDroneSnapshotDrone& Saved : Snapshot.GetDrones())
+	{
+		UClass* Class = ResolveClass(Saved.ClassIndex);
+		if (!Class)
+		{
+			continue;
+		}
+
+		if (bIdleAsDormant && Saved.State == (uint8)EDroneState::Idle && Saved.LinkedPlayerIndex == INDEX_NONE)
+		{
+			AddRecord(Class, Saved.Location, Saved.Yaw);
+			continue;
+		}
+
+		FDroneSnapshotDrone& Queued = SpawnQueue.Add_GetRef(Saved);
+		Queued.ClassIndex += StringBase;
+		Queued.FollowPlayerIndex = Saved.FollowPlayerIndex != INDEX_NONE ? Saved.FollowPlayerIndex + StringBase : INDEX_NONE;
+		Queued.LinkedPlayerIndex = Saved.LinkedPlayerIndex != INDEX_NONE ? Saved.LinkedPlayerIndex + StringBase : INDEX_NONE;
+		++NumQueued;
+	}
+
+	int32 NumRecords = 0;
+	for (const TPair<UClass*, TArray<FDroneFleetRecord>>& ClassRecords : RecordsByClass)
+	{
+		if (AAIDroneFleetProxy* Proxy = FindOrSpawnProxy(ClassRecords.Key))
+		{
+			Proxy->AddRecords(ClassRecords.Value);
+			NumRecords += ClassRecords.Value.Num();
+		}
+	}
+
+	UE_LOG(LogAIDrone, Log, TEXT("Restoring drone fleet snapshot '%s': %d dormant drones in %.1f ms, %d drones to spawn"),
+		*Path, NumRecords, (FPlatformTime::Seconds() - StartTime) * 1000.0, NumQueued);
+
+	SpawnQueuedDrones();
+	return true;
+}
+
+bool UAIDroneFleetSubsystem::SpawnManifest(const TSoftObjectPtr<UAIDroneFleetManifest>& Manifest)
+{
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Drone fleet manifests can only be spawned on the server"));
+		return false;
+	}
+
+	if (Manifest.IsNull())
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	if (SpawnRequestTime == 0.0)
+	{
+		SpawnRequestTime = StartTime;
+	}
+
+	// First the manifest, then every drone class it uses, which brings their meshes and materials along in the same request
+	++NumLoadingManifests;
+	FStreamableManager& Streamable = UAssetManager::GetStreamableManager();
+	ManifestLoadHandles.Add(Streamable.RequestAsyncLoad(Manifest.ToSoftObjectPath(), FStreamableDelegate::CreateWeakLambda(this, [this, Manifest, StartTime]()
+	{
+		const UAIDroneFleetManifest* LoadedManifest = Manifest.Get();
+		if (!LoadedManifest)
+		{
+			UE_LOG(LogAIDrone, Warning, TEXT("Could not load drone fleet manifest '%s'"), *Manifest.ToString());
+			--NumLoadingManifests;
+			SpawnQueuedDrones();
+			return;
+		}
+
+		TArray<FSoftObjectPath> ClassPaths;
+		LoadedManifest->GetDroneClassPaths(ClassPaths);
+		ManifestLoadHandles.Add(UAssetManager::GetStreamableManager().RequestAsyncLoad(ClassPaths, FStreamableDelegate::CreateWeakLambda(this, [this, Manifest, StartTime]()
+		{
+			--NumLoadingManifests;
+			if (const UAIDroneFleetManifest* ManifestToQueue = Manifest.Get())
+			{
+				UE_LOG(LogAIDrone, Log, TEXT("Loaded drone fleet manifest '%s' and its drone classes in %.1f ms"),
+					*Manifest.ToString(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+				QueueManifest(ManifestToQueue);
+			}
+			else
+			{
+				SpawnQueuedDrones();
+			}
+		})));
+	})));
+
+	return true;
+}
+
+void UAIDroneFleetSubsystem::QueueManifest(const UAIDroneFleetManifest* Manifest)
+{
+	const bool bAllowDormant = IsDormancyEnabled();
+	const float HoverTime = GetWorld()->GetTimeSeconds();
+	int32 NumRecords = 0;
+	int32 NumQueued = 0;
+
+	SpawnQueue.Reserve(SpawnQueue.Num() + Manifest->GetNumDrones());
+	for (const FDroneFleetGroup& Group : Manifest->Groups)
+	{
+		UClass* Class = Group.DroneClass.Get();
+		if (!Class)
+		{
+			UE_LOG(LogAIDrone, Warning, TEXT("Drone fleet manifest '%s': could not load '%s'"), *Manifest->GetName(), *Group.DroneClass.ToString());
+			continue;
+		}
+
+		if (Group.bStartDormant && bAllowDormant)
+		{
+			TArray<FDroneFleetRecord> NewRecords;
+			NewRecords.Reserve(Group.Placements.Num());
+			for (const FTransform& Placement : Group.Placements)
+			{
+				FDroneFleetRecord& Record = NewRecords.AddDefaulted_GetRef();
+				Record.RecordId = NextRecordId++;
+				Record.Location = Placement.GetLocation();
+				Record.Yaw = Placement.Rotator().Yaw;
+			}
+
+			if (AAIDroneFleetProxy* Proxy = FindOrSpawnProxy(Class))
+			{
+				Proxy->AddRecords(NewRecords);
+				NumRecords += NewRecords.Num();
+			}
+			continue;
+		}
+
+		const int32 ClassIndex = SpawnQueueStrings.Add(Class->GetPathName());
+		SpawnQueueClasses.Add(Class);
+
+		// Every drone of the manifest bobs in phase, as if they had all spawned in this frame
+		for (const FTransform& Placement : Group.Placements)
+		{
+			FDroneSnapshotDrone& Queued = SpawnQueue.AddDefaulted_GetRef();
+			Queued.Location = FVector3f(Placement.GetLocation());
+			Queued.Yaw = Placement.Rotator().Yaw;
+			Queued.HoverTime = HoverTime;
+			Queued.ClassIndex = ClassIndex;
+			++NumQueued;
+		}
+	}
+
+	UE_LOG(LogAIDrone, Log, TEXT("Drone fleet manifest '%s': %d dormant drones added, %d drones to spawn"), *Manifest->GetName(), NumRecords, NumQueued);
+
+	SpawnQueuedDrones();
+}
+
+void UAIDroneFleetSubsystem::SpawnQueuedDrones()
+{
+	if (SpawnRequestTime == 0.0)
+	{
+		return;
+	}
+
+	// A request can be nothing but dormant records, which completes it at once, or a manifest that is still streaming
+	if (GetNumQueuedSpawns() == 0)
+	{
+		if (NumLoadingManifests == 0)
+		{
+			FinishSpawnRequests();
+		}
+		return;
+	}
+
+	const double BudgetMs = CVarDroneSpawnBudgetMs.GetValueOnGameThread();
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	// Snapshot positions were valid when saved and manifest placements are authored, so skip the overlap search a fresh spawn needs
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	while (GetNumQueuedSpawns() > 0 && (BudgetMs <= 0.0 || FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) < BudgetMs))
+	{
+		const FDroneSnapshotDrone& Queued = SpawnQueue[NextQueuedSpawn++];
+		AAIDrone* Drone = GetWorld()->SpawnActor<AAIDrone>(SpawnQueueClasses[Queued.ClassIndex], FVector(Queued.Location), FRotator(0.0f, Queued.Yaw, 0.0f), SpawnParams);
+		if (!Drone)
+		{
+			continue;
+		}
+
+		Drone->HoverTime = Queued.HoverTime;
+		if (Drone->MovementComponent)
+		{
+			Drone->MovementComponent->Velocity = FVector(Queued.Velocity);
+		}
+
+		// A following drone hovers in place until its player is back; a possessed one comes back idle next to its character
+		if (Queued.State == (uint8)EDroneState::Following && SpawnQueueStrings.IsValidIndex(Queued.FollowPlayerIndex))
+		{
+			Drone->SetDroneState(EDroneState::Following);
+			Drone->bAwaitingFollowTarget = true;
+			SnapshotLinks.Add({ Drone, SpawnQueueStrings[Queued.FollowPlayerIndex], true });
+		}
+		if (SpawnQueueStrings.IsValidIndex(Queued.LinkedPlayerIndex))
+		{
+			SnapshotLinks.Add({ Drone, SpawnQueueStrings[Queued.LinkedPlayerIndex], false });
+		}
+	}
+
+	++NumSpawnFrames;
+	WorstSpawnFrameMs = FMath::Max(WorstSpawnFrameMs, FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+
+	// Finishing drops the load handles, which must outlive any manifest still streaming
+	if (GetNumQueuedSpawns() == 0 && NumLoadingManifests == 0)
+	{
+		FinishSpawnRequests();
+	}
+}
+
+void UAIDroneFleetSubsystem::FinishSpawnRequests()
+{
+	UE_LOG(LogAIDrone, Log, TEXT("Drone fleet ready %.1f ms after it was requested: %d drones spawned over %d frames, worst frame %.2f ms"),
+		(FPlatformTime::Seconds() - SpawnRequestTime) * 1000.0, SpawnQueue.Num(), NumSpawnFrames, WorstSpawnFrameMs);
+
+	SpawnQueue.Empty();
+	NextQueuedSpawn = 0;
+	SpawnQueueStrings.Empty();
+	SpawnQueueClasses.Empty();
+	ManifestLoadHandles.Empty();
+	SpawnRequestTime = 0.0;
+	NumSpawnFrames = 0;
+	WorstSpawnFrameMs = 0.0;
+
+	ResolveSnapshotLinks();
+	OnFleetReady.Broadcast();
+}
+
+void UAIDroneFleetSubsystem::ResolveSnapshotLinks()
+{
+	TMap<FString, AAIDroneSystemCharacter*> Characters;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (!PC || !PC->PlayerState)
+		{
+			continue;
+		}
+
+		const AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(PC);
+		for (APawn* Pawn : { PC->GetPawn(), DronePC ? DronePC->GetPreviousPawn() : nullptr })
+		{
+			if (AAIDroneSystemCharacter* Character = Cast<AAIDroneSystemCharacter>(Pawn))
+			{
+				Characters.Add(AIDroneFleet::GetSnapshotPlayerId(PC->PlayerState), Character);
+			}
+		}
+	}
+
+	if (Characters.Num() == 0)
+	{
+		return;
+	}
+
+	for (int32 Index = SnapshotLinks.Num() - 1; Index >= 0; --Index)
+	{
+		const FSnapshotLink& Link = SnapshotLinks[Index];
+		AAIDrone* Drone = Link.Drone.Get();
+		AAIDroneSystemCharacter* const* Character = Drone ? Characters.Find(Link.PlayerId) : nullptr;
+		if (Drone && !Character)
+		{
+			continue;
+		}
+
+		// Anything the player or the drone did in the meantime wins over the snapshot
+		if (Drone && Link.bFollow)
+		{
+			if (Drone->CurrentState == EDroneState::Following && !IsValid(Drone->FollowTarget))
+			{
+				Drone->FollowTarget = *Character;
+			}
+			Drone->bAwaitingFollowTarget = false;
+		}
+		else if (Drone && !(*Character)->AIDrone)
+		{
+			(*Character)->SetAIDrone(Drone);
+		}
+
+		SnapshotLinks.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	}
+}
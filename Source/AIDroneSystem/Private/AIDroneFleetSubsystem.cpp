@@ -0,0 +1,685 @@
+﻿#include "AIDroneFleetSubsystem.h"
+#include "AIDrone.h"
+#include "AIDroneFleetProxy.h"
+#include "AIDronePlayerController.h"
+#include "AIDroneStats.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "AIDroneSystem/AIDroneSystemCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarDroneAvoidanceEnable(
+	TEXT("drone.Avoidance.Enable"),
+	true,
+	TEXT("Enables reciprocal velocity obstacle avoidance between drones."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDroneAvoidanceMaxNeighbours(
+	TEXT("drone.Avoidance.MaxNeighbours"),
+	8,
+	TEXT("Maximum number of neighbours each drone avoids per frame (capped at 16)."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneAvoidanceNeighbourRadius(
+	TEXT("drone.Avoidance.NeighbourRadius"),
+	600.0f,
+	TEXT("Radius in cm within which other drones are considered for avoidance."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneAvoidanceTimeHorizon(
+	TEXT("drone.Avoidance.TimeHorizon"),
+	1.0f,
+	TEXT("How far ahead in seconds drones guarantee a collision-free velocity against each other."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneSchedulerBudgetMs(
+	TEXT("drone.Scheduler.BudgetMs"),
+	2.0f,
+	TEXT("Game thread milliseconds per frame for drone AI updates. Possessed drones always update; 0 disables the budget."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneSchedulerNearPlayerDistance(
+	TEXT("drone.Scheduler.NearPlayerDistance"),
+	3000.0f,
+	TEXT("Following drones closer than this to their target are updated before other following drones."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneSchedulerMaxDeferSeconds(
+	TEXT("drone.Scheduler.MaxDeferSeconds"),
+	0.5f,
+	TEXT("Drones deferred for longer than this are moved ahead of every other budgeted drone."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<bool> CVarDroneDormancyEnable(
+	TEXT("drone.Dormancy.Enable"),
+	true,
+	TEXT("Demotes idle drones far from every player to lightweight fleet records."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneDormancyDemoteAfterSeconds(
+	TEXT("drone.Dormancy.DemoteAfterSeconds"),
+	30.0f,
+	TEXT("Seconds an idle, unlinked drone must go without a player nearby before it is demoted."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneDormancyDemoteRangeScale(
+	TEXT("drone.Dormancy.DemoteRangeScale"),
+	1.5f,
+	TEXT("Multiple of CommandRange a player must stay outside of for a drone to be demoted; keeps promote and demote from flickering."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneDormancyCheckInterval(
+	TEXT("drone.Dormancy.CheckInterval"),
+	0.25f,
+	TEXT("Seconds between checks for drones to demote or promote."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneSimFixedStep(
+	TEXT("drone.Sim.FixedStep"),
+	0.0f,
+	TEXT("When above 0, drone AI, movement and avoidance run in fixed steps of this many seconds, every drone every step, instead of once per frame within the budget."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDroneSimMaxSubsteps(
+	TEXT("drone.Sim.MaxSubsteps"),
+	8,
+	TEXT("Most fixed drone steps run in one frame; time beyond that is dropped rather than carried into later frames."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDroneRecorderCapacity(
+	TEXT("drone.Recorder.Capacity"),
+	256,
+	TEXT("Samples kept per drone between flight recorder flushes; applies to the next recording."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneRecorderFlushInterval(
+	TEXT("drone.Recorder.FlushInterval"),
+	0.25f,
+	TEXT("Seconds between handing recorded drone samples to the writer thread."),
+	ECVF_Default);
+
+bool UAIDroneFleetSubsystem::IsDormancyEnabled()
+{
+	return CVarDroneDormancyEnable.GetValueOnGameThread();
+}
+
+bool UAIDroneFleetSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UAIDroneFleetSubsystem::Deinitialize()
+{
+	StopFlightRecording();
+	Worker.Disconnect();
+
+	// Let a snapshot still being written finish rather than leave only its temporary file
+	if (SnapshotWrite.IsValid())
+	{
+		SnapshotWrite.Wait();
+	}
+
+	Super::Deinitialize();
+}
+
+void UAIDroneFleetSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.GetNetMode() != NM_Client)
+	{
+		AutoRestoreSnapshot();
+	}
+}
+
+TStatId UAIDroneFleetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAIDroneFleetSubsystem, STATGROUP_Tickables);
+}
+
+void UAIDroneFleetSubsystem::RegisterDrone(AAIDrone* Drone)
+{
+	if (!Drone || Drone->FleetIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	Drone->FleetIndex = Drones.Add(Drone);
+	PreferredVelocities.Add(FVector::ZeroVector);
+	AvoidanceVelocities.Add(FVector::ZeroVector);
+	MaxSpeeds.Add(0.0f);
+	Responsive.Add(false);
+	HasAvoidanceVelocity.Add(false);
+	Worker.AddDrone();
+	PendingDeltaTimes.Add(0.0f);
+	LastActiveTimes.Add(GetWorld()->GetTimeSeconds());
+	if (FlightRecorder)
+	{
+		FlightRecorder->AddDrone(Drone);
+	}
+	if (bFixedStepMovement && Drone->GetMovementComponent())
+	{
+		Drone->GetMovementComponent()->SetComponentTickEnabled(false);
+	}
+
+	OnFleetChanged.Broadcast();
+}
+
+void UAIDroneFleetSubsystem::UnregisterDrone(AAIDrone* Drone)
+{
+	if (!Drone || !Drones.IsValidIndex(Drone->FleetIndex) || Drones[Drone->FleetIndex] != Drone)
+	{
+		return;
+	}
+
+	const int32 Index = Drone->FleetIndex;
+	Drones.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PreferredVelocities.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	AvoidanceVelocities.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	MaxSpeeds.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Responsive.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	HasAvoidanceVelocity.RemoveAtSwap(Index);
+	Worker.RemoveDroneAtSwap(Index);
+	PendingDeltaTimes.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	LastActiveTimes.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (FlightRecorder)
+	{
+		FlightRecorder->RemoveDroneAtSwap(Index);
+	}
+
+	if (Drones.IsValidIndex(Index))
+	{
+		Drones[Index]->FleetIndex = Index;
+	}
+	Drone->FleetIndex = INDEX_NONE;
+
+	OnFleetChanged.Broadcast();
+}
+
+void UAIDroneFleetSubsystem::SetPreferredVelocity(const AAIDrone* Drone, const FVector& Velocity)
+{
+	if (Drone && PreferredVelocities.IsValidIndex(Drone->FleetIndex))
+	{
+		PreferredVelocities[Drone->FleetIndex] = Velocity;
+	}
+}
+
+bool UAIDroneFleetSubsystem::GetAvoidanceVelocity(const AAIDrone* Drone, FVector& OutVelocity) const
+{
+	if (Drone && AvoidanceVelocities.IsValidIndex(Drone->FleetIndex) && HasAvoidanceVelocity[Drone->FleetIndex])
+	{
+		OutVelocity = AvoidanceVelocities[Drone->FleetIndex];
+		return true;
+	}
+	return false;
+}
+
+void UAIDroneFleetSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (GetWorld()->GetNetMode() != NM_Client)
+	{
+		TickServer(DeltaTime);
+	}
+
+	// Drones register on every machine, so clients report their fleet too
+	for (const AAIDrone* Drone : Drones)
+	{
+		switch (Drone->CurrentState)
+		{
+		case EDroneState::Idle:      DRONE_COUNTER_ADD(DronesIdle, 1); break;
+		case EDroneState::Following: DRONE_COUNTER_ADD(DronesFollowing, 1); break;
+		case EDroneState::Possessed: DRONE_COUNTER_ADD(DronesPossessed, 1); break;
+		}
+	}
+	for (const AAIDroneFleetProxy* Proxy : Proxies)
+	{
+		DRONE_COUNTER_ADD(DronesDormant, Proxy->GetRecords().Num());
+	}
+
+	// Fleet subsystems tick after every actor, so the frame holds all of this frame's drone work
+	FDroneFrameStats::Get().EndFrame();
+}
+
+void UAIDroneFleetSubsystem::TickServer(float DeltaTime)
+{
+	Worker.UpdateConnection();
+
+	const float FixedStep = CVarDroneSimFixedStep.GetValueOnGameThread();
+	SetFixedStepMovement(FixedStep > 0.0f);
+	if (FixedStep > 0.0f)
+	{
+		const int32 MaxSubsteps = FMath::Max(CVarDroneSimMaxSubsteps.GetValueOnGameThread(), 1);
+		FixedStepTime += DeltaTime;
+
+		// The small tolerance keeps a frame that is an exact multiple of the step from losing its last step to rounding
+		int32 NumSubsteps = 0;
+		for (; NumSubsteps < MaxSubsteps && FixedStepTime >= FixedStep * 0.999; ++NumSubsteps)
+		{
+			FixedStepTime -= FixedStep;
+			Worker.Resolve(NeighbourQuery, AvoidanceVelocities, HasAvoidanceVelocity);
+			UpdateDronesFixedStep(FixedStep);
+			UpdateAvoidance(FixedStep);
+		}
+
+		if (NumSubsteps == MaxSubsteps)
+		{
+			FixedStepTime = FMath::Min(FixedStepTime, (double)FixedStep);
+		}
+	}
+	else
+	{
+		FixedStepTime = 0.0;
+		Worker.Resolve(NeighbourQuery, AvoidanceVelocities, HasAvoidanceVelocity);
+		UpdateDrones(DeltaTime);
+		UpdateAvoidance(DeltaTime);
+	}
+
+	UpdateDormancy(DeltaTime);
+
+	TickSnapshots(DeltaTime);
+
+	FlightRecorderFlushTime += DeltaTime;
+	if (FlightRecorder && FlightRecorderFlushTime >= CVarDroneRecorderFlushInterval.GetValueOnGameThread())
+	{
+		FlightRecorderFlushTime = 0.0f;
+		FlightRecorder->Flush();
+	}
+}
+
+UAIDroneFleetSubsystem::EScheduleBucket UAIDroneFleetSubsystem::GetScheduleBucket(int32 Index) const
+{
+	const AAIDrone* Drone = Drones[Index];
+	switch (Drone->CurrentState)
+	{
+	case EDroneState::Possessed:
+		return EScheduleBucket::Possessed;
+	case EDroneState::Following:
+		if (IsValid(Drone->FollowTarget)
+			&& FVector::DistSquared(Drone->GetActorLocation(), Drone->FollowTarget->GetActorLocation()) < FMath::Square(CVarDroneSchedulerNearPlayerDistance.GetValueOnGameThread()))
+		{
+			return EScheduleBucket::FollowingNearPlayer;
+		}
+		return EScheduleBucket::Following;
+	default:
+		return EScheduleBucket::Idle;
+	}
+}
+
+void UAIDroneFleetSubsystem::UpdateDrones(float DeltaTime)
+{
+	DRONE_SCOPED_TIMER(Schedule);
+
+	const int32 NumDrones = Drones.Num();
+	const float MaxDeferSeconds = CVarDroneSchedulerMaxDeferSeconds.GetValueOnGameThread();
+
+	for (TArray<int32>& Bucket : Buckets)
+	{
+		Bucket.Reset();
+	}
+
+	// Starved drones move up to the highest budgeted bucket so nothing waits forever under load
+	for (int32 Index = 0; Index < NumDrones; ++Index)
+	{
+		PendingDeltaTimes[Index] += DeltaTime;
+		EScheduleBucket Bucket = GetScheduleBucket(Index);
+		if (Bucket != EScheduleBucket::Possessed && PendingDeltaTimes[Index] > MaxDeferSeconds)
+		{
+			Bucket = EScheduleBucket::FollowingNearPlayer;
+		}
+		Buckets[(int32)Bucket].Add(Index);
+	}
+
+	const double BudgetMs = CVarDroneSchedulerBudgetMs.GetValueOnGameThread();
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	bool bOverBudget = false;
+	NumDeferredUpdates = 0;
+
+	for (int32 BucketIndex = 0; BucketIndex < (int32)EScheduleBucket::Num; ++BucketIndex)
+	{
+		const TArray<int32>& Bucket = Buckets[BucketIndex];
+		const bool bBudgeted = BucketIndex != (int32)EScheduleBucket::Possessed && BudgetMs > 0.0;
+
+		// Start where the previous frame stopped so every drone in a bucket gets its turn
+		int32& Cursor = RoundRobinCursors[BucketIndex];
+		Cursor = Bucket.Num() > 0 ? Cursor % Bucket.Num() : 0;
+
+		int32 NumProcessed = 0;
+		for (; NumProcessed < Bucket.Num(); ++NumProcessed)
+		{
+			if (bBudgeted && (bOverBudget || FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) >= BudgetMs))
+			{
+				bOverBudget = true;
+				break;
+			}
+
+			const int32 Index = Bucket[(Cursor + NumProcessed) % Bucket.Num()];
+			Drones[Index]->UpdateDroneAI(PendingDeltaTimes[Index]);
+			PendingDeltaTimes[Index] = 0.0f;
+		}
+
+		Cursor += NumProcessed;
+		NumDeferredUpdates += Bucket.Num() - NumProcessed;
+	}
+
+	DRONE_COUNTER_ADD(DeferredUpdates, NumDeferredUpdates);
+}
+
+void UAIDroneFleetSubsystem::UpdateDronesFixedStep(float StepTime)
+{
+	DRONE_SCOPED_TIMER(Schedule);
+
+	// No wall-clock budget here: which drones update must not depend on how fast the machine is
+	NumDeferredUpdates = 0;
+	for (int32 Index = 0; Index < Drones.Num(); ++Index)
+	{
+		Drones[Index]->UpdateDroneAI(StepTime);
+		PendingDeltaTimes[Index] = 0.0f;
+	}
+
+	// Integrate the input each drone just added, so the next step's AI and avoidance see where it moved to
+	for (AAIDrone* Drone : Drones)
+	{
+		if (UPawnMovementComponent* Movement = Drone->GetMovementComponent())
+		{
+			Movement->TickComponent(StepTime, LEVELTICK_All, nullptr);
+		}
+	}
+}
+
+void UAIDroneFleetSubsystem::SetFixedStepMovement(bool bEnable)
+{
+	if (bFixedStepMovement == bEnable)
+	{
+		return;
+	}
+
+	// In fixed steps the fleet ticks drone movement itself; the component's own tick would integrate the input twice
+	bFixedStepMovement = bEnable;
+	for (AAIDrone* Drone : Drones)
+	{
+		if (UPawnMovementComponent* Movement = Drone->GetMovementComponent())
+		{
+			Movement->SetComponentTickEnabled(!bEnable);
+		}
+	}
+}
+
+void UAIDroneFleetSubsystem::UpdateAvoidance(float DeltaTime)
+{
+	DRONE_SCOPED_TIMER(Avoidance);
+
+	const int32 NumDrones = Drones.Num();
+	if (!CVarDroneAvoidanceEnable.GetValueOnGameThread() || NumDrones == 0 || DeltaTime <= 0.0f)
+	{
+		HasAvoidanceVelocity.SetRange(0, NumDrones, false);
+		return;
+	}
+
+	// Snapshot the fleet into SoA once; everything after this runs without touching actors
+	NeighbourQuery.Reset(NumDrones);
+	for (int32 Index = 0; Index < NumDrones; ++Index)
+	{
+		const AAIDrone* Drone = Drones[Index];
+		NeighbourQuery.Positions[Index] = Drone->GetActorLocation();
+		NeighbourQuery.Velocities[Index] = Drone->GetVelocity();
+		NeighbourQuery.Radii[Index] = Drone->AvoidanceRadius;
+		MaxSpeeds[Index] = Drone->GetMaxSpeed();
+		Responsive[Index] = Drone->CurrentState != EDroneState::Possessed;
+	}
+
+	const float NeighbourRadius = CVarDroneAvoidanceNeighbourRadius.GetValueOnGameThread();
+	const int32 MaxNeighbours = CVarDroneAvoidanceMaxNeighbours.GetValueOnGameThread();
+	FDroneAvoidance::FParams Params;
+	Params.TimeHorizon = CVarDroneAvoidanceTimeHorizon.GetValueOnGameThread();
+	Params.DeltaTime = DeltaTime;
+
+	if (!Worker.Submit(NeighbourQuery, PreferredVelocities, MaxSpeeds, Responsive, NeighbourRadius, MaxNeighbours, Params))
+	{
+		NeighbourQuery.Build(NeighbourRadius, MaxNeighbours);
+		FDroneAvoidance::Solve(NeighbourQuery, PreferredVelocities, MaxSpeeds, Responsive, Params, AvoidanceVelocities);
+
+		HasAvoidanceVelocity.SetRange(0, NumDrones, true);
+	}
+
+	// Drones that do not steer this frame are hovering in place
+	for (FVector& Preferred : PreferredVelocities)
+	{
+		Preferred = FVector::ZeroVector;
+	}
+}
+
+void UAIDroneFleetSubsystem::RegisterProxy(AAIDroneFleetProxy* Proxy)
+{
+	Proxies.AddUnique(Proxy);
+}
+
+void UAIDroneFleetSubsystem::UnregisterProxy(AAIDroneFleetProxy* Proxy)
+{
+	Proxies.RemoveSingleSwap(Proxy);
+}
+
+AAIDroneFleetProxy* UAIDroneFleetSubsystem::FindOrSpawnProxy(TSubclassOf<AAIDrone> DroneClass)
+{
+	for (AAIDroneFleetProxy* Proxy : Proxies)
+	{
+		if (Proxy->GetDroneClass() == DroneClass)
+		{
+			return Proxy;
+		}
+	}
+
+	AAIDroneFleetProxy* Proxy = GetWorld()->SpawnActor<AAIDroneFleetProxy>();
+	if (Proxy)
+	{
+		Proxy->SetDroneClass(DroneClass);
+	}
+	return Proxy;
+}
+
+bool UAIDroneFleetSubsystem::DemoteDrone(AAIDrone* Drone)
+{
+	if (!Drone || !Drone->HasAuthority() || Drone->CurrentState == EDroneState::Possessed)
+	{
+		return false;
+	}
+
+	AAIDroneFleetProxy* Proxy = FindOrSpawnProxy(Drone->GetClass());
+	if (!Proxy)
+	{
+		return false;
+	}
+
+	FDroneFleetRecord Record;
+	Record.RecordId = NextRecordId++;
+	Record.Location = Drone->GetActorLocation();
+	Record.Yaw = Drone->GetActorRotation().Yaw;
+
+	// The AI controller goes with the actor; promotion spawns a fresh one through AutoPossessAI
+	if (AController* Controller = Drone->GetController())
+	{
+		Controller->UnPossess();
+		Controller->Destroy();
+	}
+	Drone->Destroy();
+
+	Proxy->AddRecord(Record);
+	return true;
+}
+
+AAIDrone* UAIDroneFleetSubsystem::PromoteDrone(AAIDroneFleetProxy* Proxy, int32 RecordId)
+{
+	FDroneFleetRecord Record;
+	if (!Proxy || !Proxy->RemoveRecord(RecordId, Record))
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	AAIDrone* Drone = GetWorld()->SpawnActor<AAIDrone>(Proxy->GetDroneClass(), FVector(Record.Location), FRotator(0.0f, Record.Yaw, 0.0f), SpawnParams);
+	if (!Drone)
+	{
+		Proxy->AddRecord(Record);
+	}
+	return Drone;
+}
+
+void UAIDroneFleetSubsystem::UpdateDormancy(float DeltaTime)
+{
+	DormancyCheckTime += DeltaTime;
+	if (!CVarDroneDormancyEnable.GetValueOnGameThread() || DormancyCheckTime < CVarDroneDormancyCheckInterval.GetValueOnGameThread())
+	{
+		return;
+	}
+	DormancyCheckTime = 0.0f;
+
+	DRONE_SCOPED_TIMER(Dormancy);
+
+	// Players are few, so testing every drone against every player is cheaper than any structure
+	TArray<FVector, TInlineAllocator<16>> PlayerLocations;
+	TSet<const AAIDrone*> LinkedDrones;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (const APawn* Pawn = PC ? PC->GetPawn() : nullptr)
+		{
+			PlayerLocations.Add(Pawn->GetActorLocation());
+		}
+
+		const AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(PC);
+		for (const APawn* Pawn : { PC ? PC->GetPawn() : nullptr, DronePC ? DronePC->GetPreviousPawn() : nullptr })
+		{
+			if (const AAIDroneSystemCharacter* Character = Cast<AAIDroneSystemCharacter>(Pawn))
+			{
+				LinkedDrones.Add(Character->AIDrone);
+			}
+		}
+	}
+
+	// Restored drones whose player has not rejoined yet are still theirs
+	for (const FSnapshotLink& Link : SnapshotLinks)
+	{
+		LinkedDrones.Add(Link.Drone.Get());
+	}
+
+	auto IsPlayerWithin = [&PlayerLocations](const FVector& Location, float Range)
+	{
+		const double RangeSq = FMath::Square(Range);
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			if (FVector::DistSquared(Location, PlayerLocation) <= RangeSq)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float DemoteAfterSeconds = CVarDroneDormancyDemoteAfterSeconds.GetValueOnGameThread();
+	const float DemoteRangeScale = FMath::Max(CVarDroneDormancyDemoteRangeScale.GetValueOnGameThread(), 1.0f);
+
+	TArray<AAIDrone*> ToDemote;
+	for (int32 Index = 0; Index < Drones.Num(); ++Index)
+	{
+		const AAIDrone* Drone = Drones[Index];
+		if (Drone->CurrentState != EDroneState::Idle || LinkedDrones.Contains(Drone)
+			|| IsPlayerWithin(Drone->GetActorLocation(), Drone->CommandRange * DemoteRangeScale))
+		{
+			LastActiveTimes[Index] = Now;
+		}
+		else if (Now - LastActiveTimes[Index] > DemoteAfterSeconds)
+		{
+			ToDemote.Add(Drones[Index]);
+		}
+	}
+
+	// Wake records a player has walked up to
+	TArray<TPair<AAIDroneFleetProxy*, int32>> ToPromote;
+	for (AAIDroneFleetProxy* Proxy : Proxies)
+	{
+		const AAIDrone* DefaultDrone = Proxy->GetDroneClass() ? Proxy->GetDroneClass()->GetDefaultObject<AAIDrone>() : nullptr;
+		if (!DefaultDrone)
+		{
+			continue;
+		}
+
+		for (const FDroneFleetRecord& Record : Proxy->GetRecords())
+		{
+			if (IsPlayerWithin(Record.Location, DefaultDrone->CommandRange))
+			{
+				ToPromote.Emplace(Proxy, Record.RecordId);
+			}
+		}
+	}
+
+	for (AAIDrone* Drone : ToDemote)
+	{
+		DemoteDrone(Drone);
+	}
+	for (const TPair<AAIDroneFleetProxy*, int32>& Promotion : ToPromote)
+	{
+		PromoteDrone(Promotion.Key, Promotion.Value);
+	}
+}
+
+bool UAIDroneFleetSubsystem::StartFlightRecording(const FString& Path)
+{
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Drone flight recording only runs where drone AI runs, on the server"));
+		return false;
+	}
+
+	StopFlightRecording();
+
+	FlightRecorder = MakeUnique<FDroneFlightRecorder>(Path, CVarDroneRecorderCapacity.GetValueOnGameThread());
+	if (!FlightRecorder->IsOpen())
+	{
+		FlightRecorder.Reset();
+		return false;
+	}
+
+	for (const AAIDrone* Drone : Drones)
+	{
+		FlightRecorder->AddDrone(Drone);
+	}
+	FlightRecorderFlushTime = 0.0f;
+
+	UE_LOG(LogAIDrone, Log, TEXT("Recording drone flights to '%s'"), *Path);
+	return true;
+}
+
+void UAIDroneFleetSubsystem::StopFlightRecording()
+{
+	if (FlightRecorder)
+	{
+		const FString Path = FlightRecorder->GetPath();
+		const int64 NumDropped = FlightRecorder->GetNumDroppedSamples();
+		FlightRecorder.Reset();
+
+		UE_LOG(LogAIDrone, Log, TEXT("Stopped recording drone flights to '%s' (%lld samples dropped)"), *Path, NumDropped);
+	}
+}
+
+void UAIDroneFleetSubsystem::RecordFlight(AAIDrone* Drone)
+{
+	if (FlightRecorder && Drones.IsValidIndex(Drone->FleetIndex))
+	{
+		FDroneFlightSample Sample;
+		Sample.Time = GetWorld()->GetTimeSeconds();
+		Sample.Position = FVector3f(Drone->GetActorLocation());
+		Sample.Velocity = FVector3f(Drone->GetVelocity());
+		Sample.Input = FVector3f(Drone->GetPendingMovementInputVector());
+		Sample.State = (uint8)Drone->CurrentState;
+		Sample.Events = Drone->PendingFlightEvents;
+		Sample.ServerMoves = Drone->PendingServerMoves;
+		FlightRecorder->Record(Drone->FleetIndex, Sample);
+	}
+
+	Drone->PendingFlightEvents = EDroneFlightEvent::None;
+	Drone->PendingServerMoves = 0;
+}
@@ -0,0 +1,127 @@
+﻿#include "AIDroneFleetWorker.h"
+#include "AIDroneStats.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarDroneWorkerEnable(
+	TEXT("drone.Worker.Enable"),
+	false,
+	TEXT("Hands fleet avoidance to an out-of-process drone worker (-run=AIDroneWorker) when one is running on this machine, falling back to solving it in process."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneWorkerWaitMs(
+	TEXT("drone.Worker.WaitMs"),
+	2.0f,
+	TEXT("Milliseconds the server waits at the start of a frame for the worker's avoidance result before solving it in process."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneWorkerRetryInterval(
+	TEXT("drone.Worker.RetryInterval"),
+	5.0f,
+	TEXT("Seconds between attempts to find a drone worker while none is connected."),
+	ECVF_Default);
+
+void FDroneFleetWorker::UpdateConnection()
+{
+	if (!CVarDroneWorkerEnable.GetValueOnGameThread())
+	{
+		Disconnect();
+		return;
+	}
+
+	// A worker that stopped leaves its pool behind; let go of it so a restarted worker's pool is found
+	if (Client.IsConnected() && !Client.IsWorkerAlive())
+	{
+		UE_LOG(LogAIDrone, Warning, TEXT("Drone worker stopped responding; solving avoidance in process"));
+		Client.Disconnect();
+	}
+
+	// Every tick, not just when there is a frame to submit, or an empty fleet's slot would look abandoned
+	Client.TouchHeartbeat();
+
+	const double Now = FPlatformTime::Seconds();
+	if (!Client.IsConnected() && Now >= NextConnectTime)
+	{
+		NextConnectTime = Now + CVarDroneWorkerRetryInterval.GetValueOnGameThread();
+		Client.Connect(FDroneWorkerPool::GetDefaultName());
+	}
+}
+
+void FDroneFleetWorker::Disconnect()
+{
+	Client.Disconnect();
+}
+
+void FDroneFleetWorker::AddDrone()
+{
+	SubmittedIndices.Add(INDEX_NONE);
+}
+
+void FDroneFleetWorker::RemoveDroneAtSwap(int32 Index)
+{
+	SubmittedIndices.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+}
+
+bool FDroneFleetWorker::Submit(const FDroneNeighbourQuery& Query, TConstArrayView<FVector> PreferredVelocities, TConstArrayView<float> MaxSpeeds,
+	TConstArrayView<bool> Responsive, float NeighbourRadius, int32 MaxNeighbours, const FDroneAvoidance::FParams& Params)
+{
+	if (!Client.IsConnected())
+	{
+		return false;
+	}
+
+	if (!Client.Submit(Query, PreferredVelocities, MaxSpeeds, Responsive, NeighbourRadius, MaxNeighbours, Params))
+	{
+		DRONE_COUNTER_ADD(WorkerFallbacks, 1);
+		return false;
+	}
+
+	// Drones can register and unregister before the result is back, so keep the frame as submitted
+	bSubmitted = true;
+	SubmittedNeighbourRadius = NeighbourRadius;
+	SubmittedMaxNeighbours = MaxNeighbours;
+	SubmittedParams = Params;
+	SubmittedPreferredVelocities = PreferredVelocities;
+	SubmittedMaxSpeeds = MaxSpeeds;
+	SubmittedResponsive = Responsive;
+	for (int32 Index = 0; Index < SubmittedIndices.Num(); ++Index)
+	{
+		SubmittedIndices[Index] = Index;
+	}
+	return true;
+}
+
+void FDroneFleetWorker::Resolve(FDroneNeighbourQuery& Query, TArrayView<FVector> OutVelocities, TBitArray<>& OutHasVelocity)
+{
+	if (!bSubmitted)
+	{
+		return;
+	}
+	bSubmitted = false;
+
+	DRONE_SCOPED_TIMER(Avoidance);
+
+	SubmittedVelocities.SetNumUninitialized(Query.Num(), EAllowShrinking::No);
+	if (Client.Collect(CVarDroneWorkerWaitMs.GetValueOnGameThread() / 1000.0, SubmittedVelocities))
+	{
+		DRONE_COUNTER_ADD(WorkerResults, 1);
+		CSV_CUSTOM_STAT(Drones, WorkerRoundTripMs, (float)Client.GetLatency().LastRoundTripMs, ECsvCustomStatOp::Set);
+	}
+	else
+	{
+		// Too late or the worker is gone, so solve the submitted frame here with the settings it was submitted with
+		DRONE_COUNTER_ADD(WorkerFallbacks, 1);
+		Query.Build(SubmittedNeighbourRadius, SubmittedMaxNeighbours);
+		FDroneAvoidance::Solve(Query, SubmittedPreferredVelocities, SubmittedMaxSpeeds, SubmittedResponsive, SubmittedParams, SubmittedVelocities);
+	}
+
+	for (int32 Index = 0; Index < SubmittedIndices.Num(); ++Index)
+	{
+		const int32 SubmittedIndex = SubmittedIndices[Index];
+		OutHasVelocity[Index] = SubmittedIndex != INDEX_NONE;
+		if (SubmittedIndex != INDEX_NONE)
+		{
+			OutVelocities[Index] = SubmittedVelocities[SubmittedIndex];
+		}
+	}
+}
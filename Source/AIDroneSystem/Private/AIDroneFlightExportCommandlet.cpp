@@ -0,0 +1,77 @@
+﻿#include "AIDroneFlightExportCommandlet.h"
+#include "AIDroneFlightRecorder.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+UAIDroneFlightExportCommandlet::UAIDroneFlightExportCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UAIDroneFlightExportCommandlet::Main(const FString& Params)
+{
+	FString InPath;
+	if (!FParse::Value(*Params, TEXT("In="), InPath))
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Usage: -run=AIDroneFlightExport -In=Path.dfr [-Out=Path.csv]"));
+		return 1;
+	}
+
+	FString OutPath;
+	if (!FParse::Value(*Params, TEXT("Out="), OutPath))
+	{
+		OutPath = FPaths::ChangeExtension(InPath, TEXT("csv"));
+	}
+
+	TUniquePtr<FArchive> Out(IFileManager::Get().CreateFileWriter(*OutPath));
+	if (!Out)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Could not open '%s' for writing"), *OutPath);
+		return 1;
+	}
+
+	// Rows are streamed out as they are read, so recordings larger than memory still export
+	auto WriteLine = [&Out](const FString& Line)
+	{
+		const FTCHARToUTF8 Utf8(*Line);
+		Out->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+		Out->Serialize(const_cast<ANSICHAR*>("\n"), 1);
+	};
+	WriteLine(TEXT("DroneId,Name,Time,State,PosX,PosY,PosZ,VelX,VelY,VelZ,InputX,InputY,InputZ,Events,ServerMoves"));
+
+	TMap<uint32, FString> Names;
+	int64 NumSamples = 0;
+	FString Error;
+	const bool bRead = FDroneFlightRecorder::ReadFile(InPath,
+		[&Names](uint32 DroneId, const FString& Name)
+		{
+			Names.Add(DroneId, Name);
+		},
+		[&Names, &NumSamples, &WriteLine](uint32 DroneId, const FDroneFlightSample& Sample)
+		{
+			const FString* Name = Names.Find(DroneId);
+			WriteLine(FString::Printf(TEXT("%u,%s,%.4f,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f,%u,%u"),
+				DroneId, Name ? **Name : TEXT(""), Sample.Time, (uint32)Sample.State,
+				Sample.Position.X, Sample.Position.Y, Sample.Position.Z,
+				Sample.Velocity.X, Sample.Velocity.Y, Sample.Velocity.Z,
+				Sample.Input.X, Sample.Input.Y, Sample.Input.Z,
+				(uint32)Sample.Events, (uint32)Sample.ServerMoves));
+			++NumSamples;
+		},
+		Error);
+
+	Out->Close();
+
+	if (!bRead)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Failed to read '%s': %s"), *InPath, *Error);
+		return 1;
+	}
+
+	UE_LOG(LogAIDrone, Display, TEXT("Wrote %lld samples from %d drones to '%s'"), NumSamples, Names.Num(), *OutPath);
+	return 0;
+}
@@ -0,0 +1,248 @@
+﻿#include "AIDroneFlightRecorder.h"
+#include "AIDrone.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Containers/Queue.h"
+#include "HAL/FileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+/** Appends buffers to the recording on its own thread and hands them back empty for reuse */
+class FDroneFlightWriter : public FRunnable
+{
+public:
+	explicit FDroneFlightWriter(TUniquePtr<FArchive> InArchive)
+		: Archive(MoveTemp(InArchive))
+	{
+		WorkEvent = FPlatformProcess::GetSynchEventFromPool();
+		Thread.Reset(FRunnableThread::Create(this, TEXT("DroneFlightWriter"), 0, TPri_BelowNormal));
+	}
+
+	virtual ~FDroneFlightWriter() override
+	{
+		bStopping = true;
+		WorkEvent->Trigger();
+		Thread->WaitForCompletion();
+		Thread.Reset();
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+
+		Archive->Close();
+	}
+
+	void Enqueue(TArray<uint8>&& Buffer)
+	{
+		Pending.Enqueue(MoveTemp(Buffer));
+		WorkEvent->Trigger();
+	}
+
+	/** An empty buffer with the capacity of one the writer has finished with, when there is one */
+	TArray<uint8> AcquireBuffer()
+	{
+		TArray<uint8> Buffer;
+		Free.Dequeue(Buffer);
+		return Buffer;
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopping)
+		{
+			WorkEvent->Wait();
+			WritePending();
+		}
+
+		// The recorder flushed before stopping us, so this catches the last buffer
+		WritePending();
+		return 0;
+	}
+
+private:
+	void WritePending()
+	{
+		TArray<uint8> Buffer;
+		while (Pending.Dequeue(Buffer))
+		{
+			Archive->Serialize(Buffer.GetData(), Buffer.Num());
+			Buffer.Reset();
+			Free.Enqueue(MoveTemp(Buffer));
+		}
+		Archive->Flush();
+	}
+
+	TUniquePtr<FArchive> Archive;
+	TUniquePtr<FRunnableThread> Thread;
+	FEvent* WorkEvent = nullptr;
+	std::atomic<bool> bStopping = false;
+
+	TQueue<TArray<uint8>, EQueueMode::Spsc> Pending;
+	TQueue<TArray<uint8>, EQueueMode::Spsc> Free;
+};
+
+FDroneFlightRecorder::FDroneFlightRecorder(const FString& InPath, int32 InCapacity)
+	: Path(InPath)
+	, CapacityMask(FMath::RoundUpToPowerOfTwo(FMath::Max(InCapacity, 2)) - 1)
+{
+	TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileWriter(*Path, FILEWRITE_EvenIfReadOnly));
+	if (!Archive)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Could not open drone flight recording '%s'"), *Path);
+		return;
+	}
+
+	FFileHeader Header = { Magic, Version, (uint16)sizeof(FDroneFlightSample), 0 };
+	Archive->Serialize(&Header, sizeof(Header));
+
+	Writer = MakeUnique<FDroneFlightWriter>(MoveTemp(Archive));
+}
+
+FDroneFlightRecorder::~FDroneFlightRecorder()
+{
+	if (Writer)
+	{
+		Flush();
+		Writer.Reset();
+	}
+}
+
+FString FDroneFlightRecorder::GetDefaultPath(const FString& MapName)
+{
+	return FPaths::ProjectSavedDir() / TEXT("DroneFlights") / FString::Printf(TEXT("%s_%s.dfr"), *MapName, *FDateTime::Now().ToString());
+}
+
+void FDroneFlightRecorder::AppendChunk(EChunkType Type, uint32 DroneId, uint32 Count, const void* Data, int64 Size)
+{
+	const FChunkHeader Header = { Type, DroneId, Count };
+	Staging.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	Staging.Append(static_cast<const uint8*>(Data), Size);
+}
+
+void FDroneFlightRecorder::AddDrone(const AAIDrone* Drone)
+{
+	FRing& Ring = Rings.AddDefaulted_GetRef();
+	Ring.DroneId = NextDroneId++;
+	Ring.Samples.SetNumZeroed(CapacityMask + 1);
+
+	const FTCHARToUTF8 Name(*Drone->GetName());
+	AppendChunk(EChunkType::Drone, Ring.DroneId, Name.Length(), Name.Get(), Name.Length());
+}
+
+void FDroneFlightRecorder::RemoveDroneAtSwap(int32 Index)
+{
+	AppendRing(Rings[Index]);
+	Rings.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+}
+
+void FDroneFlightRecorder::AppendRing(FRing& Ring)
+{
+	const uint64 Capacity = CapacityMask + 1;
+	uint64 NumNew = Ring.NumWritten - Ring.NumFlushed;
+	if (NumNew == 0)
+	{
+		return;
+	}
+
+	if (NumNew > Capacity)
+	{
+		NumDroppedSamples += NumNew - Capacity;
+		Ring.NumFlushed = Ring.NumWritten - Capacity;
+		NumNew = Capacity;
+	}
+
+	// New samples may wrap around the end of the ring; write them as one chunk either way
+	const uint64 First = Ring.NumFlushed & CapacityMask;
+	const uint64 NumBeforeWrap = FMath::Min(NumNew, Capacity - First);
+	AppendChunk(EChunkType::Samples, Ring.DroneId, (uint32)NumNew, &Ring.Samples[First], NumBeforeWrap * sizeof(FDroneFlightSample));
+	Staging.Append(reinterpret_cast<const uint8*>(Ring.Samples.GetData()), (NumNew - NumBeforeWrap) * sizeof(FDroneFlightSample));
+
+	Ring.NumFlushed = Ring.NumWritten;
+}
+
+void FDroneFlightRecorder::Flush()
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	for (FRing& Ring : Rings)
+	{
+		AppendRing(Ring);
+	}
+
+	if (Staging.Num() > 0)
+	{
+		Writer->Enqueue(MoveTemp(Staging));
+		Staging = Writer->AcquireBuffer();
+	}
+}
+
+bool FDroneFlightRecorder::ReadFile(const FString& FilePath,
+	TFunctionRef<void(uint32 DroneId, const FString& Name)> OnDrone,
+	TFunctionRef<void(uint32 DroneId, const FDroneFlightSample& Sample)> OnSample,
+	FString& OutError)
+{
+	TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileReader(*FilePath));
+	if (!Archive)
+	{
+		OutError = FString::Printf(TEXT("Could not open '%s'"), *FilePath);
+		return false;
+	}
+
+	FFileHeader Header;
+	if (Archive->TotalSize() < (int64)sizeof(Header))
+	{
+		OutError = TEXT("File is too small to be a drone flight recording");
+		return false;
+	}
+	Archive->Serialize(&Header, sizeof(Header));
+	if (Header.Magic != Magic || Header.Version != Version || Header.SampleSize != sizeof(FDroneFlightSample))
+	{
+		OutError = FString::Printf(TEXT("Not a version %d drone flight recording"), Version);
+		return false;
+	}
+
+	TArray64<uint8> Payload;
+	while (Archive->Tell() < Archive->TotalSize())
+	{
+		FChunkHeader Chunk;
+		if (Archive->TotalSize() - Archive->Tell() < (int64)sizeof(Chunk))
+		{
+			OutError = TEXT("Recording is truncated");
+			return false;
+		}
+		Archive->Serialize(&Chunk, sizeof(Chunk));
+
+		// Count is the number of samples in a Samples chunk and the size in bytes of any other chunk
+		const int64 ChunkSize = Chunk.Type == EChunkType::Samples ? (int64)Chunk.Count * sizeof(FDroneFlightSample) : (int64)Chunk.Count;
+		if (Archive->TotalSize() - Archive->Tell() < ChunkSize)
+		{
+			OutError = TEXT("Recording is truncated");
+			return false;
+		}
+		Payload.SetNumUninitialized(ChunkSize, EAllowShrinking::No);
+		Archive->Serialize(Payload.GetData(), ChunkSize);
+
+		switch (Chunk.Type)
+		{
+		case EChunkType::Drone:
+		{
+			const FUTF8ToTCHAR Name(reinterpret_cast<const ANSICHAR*>(Payload.GetData()), IntCastChecked<int32>(Payload.Num()));
+			OnDrone(Chunk.DroneId, FString(Name.Length(), Name.Get()));
+			break;
+		}
+		case EChunkType::Samples:
+			for (uint32 Index = 0; Index < Chunk.Count; ++Index)
+			{
+				OnSample(Chunk.DroneId, reinterpret_cast<const FDroneFlightSample*>(Payload.GetData())[Index]);
+			}
+			break;
+		default:
+			// Chunk types from newer writers are skipped
+			break;
+		}
+	}
+
+	return !Archive->IsError();
+}
@@ -1,10 +1,13 @@
 ﻿#include "AIDroneHUDWidget.h"
 #include "AIDroneSystem/AIDroneSystemCharacter.h"
 #include "AIDrone.h"
+#include "Components/TextBlock.h"
 #include "GameFramework/PlayerController.h"
 
+#define LOCTEXT_NAMESPACE "AIDroneHUD"
+
 // Helper function to get the actual Drone actor we want to display
-AAIDrone* GetTargetDrone(APawn* OwningPawn)
+AAIDrone* UAIDroneHUDWidget::GetTargetDrone(APawn* OwningPawn)
 {
 	// Case 1: The player is controlling the Drone directly
 	if (AAIDrone* ControlledDrone = Cast<AAIDrone>(OwningPawn))
@@ -21,43 +24,146 @@ AAIDrone* GetTargetDrone(APawn* OwningPawn)
 	return nullptr;
 }
 
-FText UAIDroneHUDWidget::GetDroneNameText() const
+void UAIDroneHUDWidget::NativeConstruct()
 {
-	AAIDrone* Drone = GetTargetDrone(GetOwningPlayerPawn());
+	Super::NativeConstruct();
 
-	if (Drone)
+	if (APlayerController* PlayerController = GetOwningPlayer())
+	{
+		PlayerController->OnPossessedPawnChanged.AddUniqueDynamic(this, &UAIDroneHUDWidget::HandlePossessedPawnChanged);
+	}
+
+	RefreshTarget();
+}
+
+void UAIDroneHUDWidget::NativeDestruct()
+{
+	if (APlayerController* PlayerController = GetOwningPlayer())
 	{
-		return FText::FromString(Drone->GetName());
+		PlayerController->OnPossessedPawnChanged.RemoveDynamic(this, &UAIDroneHUDWidget::HandlePossessedPawnChanged);
 	}
 
-	return FText::FromString(TEXT("No Drone Linked"));
+	Unbind();
+
+	Super::NativeDestruct();
+}
+
+void UAIDroneHUDWidget::HandlePossessedPawnChanged(APawn* OldPawn, APawn* NewPawn)
+{
+	RefreshTarget();
+}
+
+void UAIDroneHUDWidget::HandleLinkedDroneChanged(AAIDrone* Drone)
+{
+	RefreshTarget();
+}
+
+void UAIDroneHUDWidget::HandleDroneStateChanged(AAIDrone* Drone)
+{
+	RefreshText();
+}
+
+void UAIDroneHUDWidget::HandleDroneEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	RefreshTarget();
 }
 
-FText UAIDroneHUDWidget::GetDroneStateText() const
+void UAIDroneHUDWidget::Unbind()
 {
+	if (AAIDroneSystemCharacter* Character = BoundCharacter.Get())
+	{
+		Character->OnLinkedDroneChanged.Remove(LinkedDroneChangedHandle);
+	}
+	if (AAIDrone* Drone = BoundDrone.Get())
+	{
+		Drone->OnStateChanged.Remove(DroneStateChangedHandle);
+		Drone->OnEndPlay.RemoveDynamic(this, &UAIDroneHUDWidget::HandleDroneEndPlay);
+	}
+
+	BoundCharacter.Reset();
+	BoundDrone.Reset();
+	LinkedDroneChangedHandle.Reset();
+	DroneStateChangedHandle.Reset();
+}
+
+void UAIDroneHUDWidget::RefreshTarget()
+{
+	AAIDroneSystemCharacter* Character = GetOwningDroneCharacter();
 	AAIDrone* Drone = GetTargetDrone(GetOwningPlayerPawn());
+	if (Drone && Drone->IsActorBeingDestroyed())
+	{
+		Drone = nullptr;
+	}
+
+	if (Character == BoundCharacter.Get() && Drone == BoundDrone.Get() && !CachedDroneNameText.IsEmpty())
+	{
+		return;
+	}
 
+	Unbind();
+
+	if (Character)
+	{
+		BoundCharacter = Character;
+		LinkedDroneChangedHandle = Character->OnLinkedDroneChanged.AddUObject(this, &UAIDroneHUDWidget::HandleLinkedDroneChanged);
+	}
 	if (Drone)
+	{
+		BoundDrone = Drone;
+		DroneStateChangedHandle = Drone->OnStateChanged.AddUObject(this, &UAIDroneHUDWidget::HandleDroneStateChanged);
+		Drone->OnEndPlay.AddUniqueDynamic(this, &UAIDroneHUDWidget::HandleDroneEndPlay);
+	}
+
+	// The name only changes with the drone, so it is built here rather than on every state change
+	CachedDroneNameText = Drone ? FText::FromString(Drone->GetName()) : LOCTEXT("NoDroneLinked", "No Drone Linked");
+	if (DroneNameText)
+	{
+		DroneNameText->SetText(CachedDroneNameText);
+	}
+
+	RefreshText();
+}
+
+void UAIDroneHUDWidget::RefreshText()
+{
+	const AAIDrone* Drone = BoundDrone.Get();
+
+	if (!Drone)
+	{
+		CachedDroneStateText = LOCTEXT("StatusNone", "Status: --");
+	}
+	else
 	{
 		switch (Drone->CurrentState)
 		{
 		case EDroneState::Idle:
-			return FText::FromString(TEXT("Status: Idle"));
+			CachedDroneStateText = LOCTEXT("StatusIdle", "Status: Idle");
+			break;
 		case EDroneState::Following:
-			return FText::FromString(TEXT("Status: Following"));
+			CachedDroneStateText = LOCTEXT("StatusFollowing", "Status: Following");
+			break;
 		case EDroneState::Possessed:
-			return FText::FromString(TEXT("Status: Player Controlled"));
+			CachedDroneStateText = LOCTEXT("StatusPossessed", "Status: Player Controlled");
+			break;
 		default:
-			return FText::FromString(TEXT("Status: Unknown"));
+			CachedDroneStateText = LOCTEXT("StatusUnknown", "Status: Unknown");
+			break;
 		}
 	}
 
-	return FText::FromString(TEXT("Status: --"));
+	// SetText invalidates only this Text Block, so retainer panels and invalidation boxes redraw once per change
+	if (DroneStateText)
+	{
+		DroneStateText->SetText(CachedDroneStateText);
+	}
+
+	OnDroneInfoChanged();
 }
 
-// You can remove the old GetOwningDroneCharacter helper or leave it unused.
 AAIDroneSystemCharacter* UAIDroneHUDWidget::GetOwningDroneCharacter() const
 {
 	APawn* OwningPawn = GetOwningPlayerPawn();
 	return Cast<AAIDroneSystemCharacter>(OwningPawn);
-}
\ No newline at end of file
+}
+
+#undef LOCTEXT_NAMESPACE
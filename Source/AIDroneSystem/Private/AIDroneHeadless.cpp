@@ -0,0 +1,50 @@
+﻿#include "AIDroneHeadless.h"
+#include "AIDrone.h"
+#include "AIDroneNavVolume.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+
+namespace AIDroneHeadless
+{
+	void SetConsoleVariable(const TCHAR* Name, const FString& Value)
+	{
+		if (IConsoleVariable* Variable = IConsoleManager::Get().FindConsoleVariable(Name))
+		{
+			Variable->Set(*Value, ECVF_SetByCode);
+		}
+	}
+
+	FBox GetFlightArea(UWorld& World)
+	{
+		FBox Area(ForceInit);
+		for (TActorIterator<AAIDroneNavVolume> It(&World); It; ++It)
+		{
+			Area += It->GetBounds().GetBox();
+		}
+		return Area.IsValid ? Area : FBox(FVector(-5000.0f, -5000.0f, 200.0f), FVector(5000.0f, 5000.0f, 1500.0f));
+	}
+
+	UClass* LoadDroneClass(const TCHAR* Key)
+	{
+		FString DroneClassPath = TEXT("/Game/BP_AIDrone.BP_AIDrone_C");
+		FParse::Value(FCommandLine::Get(), Key, DroneClassPath);
+		UClass* DroneClass = LoadClass<AAIDrone>(nullptr, *DroneClassPath);
+		if (!DroneClass)
+		{
+			UE_LOG(LogAIDrone, Warning, TEXT("Could not load drone class '%s'; spawning AAIDrone"), *DroneClassPath);
+			DroneClass = AAIDrone::StaticClass();
+		}
+		return DroneClass;
+	}
+
+	ACharacter* SpawnTarget(UWorld& World, const FVector& Location)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+		return World.SpawnActor<ACharacter>(ACharacter::StaticClass(), Location, FRotator::ZeroRotator, SpawnParams);
+	}
+}
@@ -0,0 +1,261 @@
+﻿#include "AIDroneMemoryReport.h"
+#include "AIDrone.h"
+#include "AIDroneFleetSubsystem.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Net/DataReplication.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "UObject/UObjectHash.h"
+
+static TAutoConsoleVariable<float> CVarDroneMemoryBudgetKB(
+	TEXT("drone.Memory.BudgetKB"),
+	512.0f,
+	TEXT("Kilobytes one drone may cost, with its components and AI controller, before drone.Memory.Report fails; 0 disables the check."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneMemoryReplicationBudgetKB(
+	TEXT("drone.Memory.ReplicationBudgetKB"),
+	16.0f,
+	TEXT("Kilobytes of replication state one drone may cost per client connection before drone.Memory.Report fails; 0 disables the check."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs DroneMemoryReportCommand(
+	TEXT("drone.Memory.Report"),
+	TEXT("Spawns drones, logs what one costs by component and checks it against the budget. With Exit, quits with code 1 when over budget, for automated runs: ")
+	TEXT("-ExecCmds=\"drone.Memory.Report 32 Exit\". Usage: drone.Memory.Report [NumDrones] [DroneClassPath] [Exit]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogAIDrone, Warning, TEXT("drone.Memory.Report spawns drones, so it only runs on a server or in a standalone game"));
+			return;
+		}
+
+		int32 NumDrones = 16;
+		FString DroneClassPath = TEXT("/Game/BP_AIDrone.BP_AIDrone_C");
+		bool bExit = false;
+		for (const FString& Arg : Args)
+		{
+			if (Arg.Equals(TEXT("Exit"), ESearchCase::IgnoreCase))
+			{
+				bExit = true;
+			}
+			else if (Arg.IsNumeric())
+			{
+				NumDrones = FMath::Max(FCString::Atoi(*Arg), 1);
+			}
+			else
+			{
+				DroneClassPath = Arg;
+			}
+		}
+
+		UClass* DroneClass = LoadClass<AAIDrone>(nullptr, *DroneClassPath);
+		if (!DroneClass)
+		{
+			UE_LOG(LogAIDrone, Warning, TEXT("Drone memory report: could not load '%s'; measuring AAIDrone"), *DroneClassPath);
+			DroneClass = AAIDrone::StaticClass();
+		}
+
+		const FDroneMemoryReport Report = FDroneMemoryReport::Measure(*World, DroneClass, NumDrones);
+		Report.Log();
+		const bool bWithinBudget = Report.IsWithinBudget();
+
+		if (bExit)
+		{
+			FPlatformMisc::RequestExitWithStatus(false, bWithinBudget ? 0 : 1);
+		}
+	}));
+
+namespace AIDroneMemory
+{
+	uint64 GetObjectBytes(UObject* Object, uint64& OutPhysicsBytes)
+	{
+		FArchiveCountMem CountMem(Object);
+		const uint64 ResourceBytes = Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+
+		// Physics bodies are part of their component's resource size; split them out
+		OutPhysicsBytes = 0;
+		if (const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Object))
+		{
+			FResourceSizeEx BodySize(EResourceSizeMode::Exclusive);
+			Primitive->BodyInstance.GetBodyInstanceResourceSizeEx(BodySize);
+			OutPhysicsBytes = FMath::Min<uint64>(BodySize.GetTotalMemoryBytes(), ResourceBytes);
+		}
+
+		return Object->GetClass()->GetStructureSize() + CountMem.GetMax() + ResourceBytes - OutPhysicsBytes;
+	}
+}
+
+FDroneMemoryReport FDroneMemoryReport::Measure(UWorld& World, TSubclassOf<AAIDrone> DroneClass, int32 InNumDrones)
+{
+	FDroneMemoryReport Report;
+
+	// Far below the map, spread out so the drones do not touch each other or anything else
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	TArray<AAIDrone*> Spawned;
+	for (int32 Index = 0; Index < InNumDrones; ++Index)
+	{
+		if (AAIDrone* Drone = World.SpawnActor<AAIDrone>(DroneClass, FVector(Index * 1000.0f, 0.0f, -100000.0f), FRotator::ZeroRotator, SpawnParams))
+		{
+			Spawned.Add(Drone);
+		}
+	}
+
+	for (AAIDrone* Drone : Spawned)
+	{
+		auto AddObject = [&Report](UObject* Object, const FString& Category)
+		{
+			uint64 PhysicsBytes = 0;
+			Report.CategoryBytes.FindOrAdd(Category) += AIDroneMemory::GetObjectBytes(Object, PhysicsBytes);
+			if (PhysicsBytes > 0)
+			{
+				Report.CategoryBytes.FindOrAdd(TEXT("Physics bodies")) += PhysicsBytes;
+			}
+		};
+
+		AddObject(Drone, TEXT("Actor"));
+
+		// Components, dynamic materials and anything else the drone owns, which are all outered to it or to one of its components
+		TArray<UObject*> Owned;
+		GetObjectsWithOuter(Drone, Owned, true);
+		for (UObject* Object : Owned)
+		{
+			if (Object->IsA<UMaterialInstanceDynamic>())
+			{
+				AddObject(Object, TEXT("Dynamic materials"));
+			}
+			else if (Object->IsA<UActorComponent>())
+			{
+				AddObject(Object, Object->GetName());
+			}
+			else
+			{
+				AddObject(Object, Object->GetClass()->GetName());
+			}
+		}
+
+		if (AController* Controller = Drone->GetController())
+		{
+			AddObject(Controller, TEXT("AI controller"));
+			TArray<UObject*> ControllerOwned;
+			GetObjectsWithOuter(Controller, ControllerOwned, true);
+			for (UObject* Object : ControllerOwned)
+			{
+				AddObject(Object, TEXT("AI controller"));
+			}
+		}
+	}
+	Report.NumDrones = Spawned.Num();
+
+	for (AAIDrone* Drone : Spawned)
+	{
+		if (AController* Controller = Drone->GetController())
+		{
+			Controller->Destroy();
+		}
+		Drone->Destroy();
+	}
+
+	// Shadow state and changelists the server keeps for each connection that has the drone open
+	const UNetDriver* NetDriver = World.GetNetDriver();
+	const UAIDroneFleetSubsystem* FleetSubsystem = World.GetSubsystem<UAIDroneFleetSubsystem>();
+	if (NetDriver && FleetSubsystem)
+	{
+		Report.NumConnections = NetDriver->ClientConnections.Num();
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			for (AAIDrone* Drone : FleetSubsystem->GetDrones())
+			{
+				UActorChannel* Channel = Connection ? Connection->FindActorChannelRef(Drone) : nullptr;
+				if (!Channel)
+				{
+					continue;
+				}
+
+				FArchiveCountMem CountMem(Channel);
+				for (const TPair<UObject*, TSharedRef<FObjectReplicator>>& Replicator : Channel->ReplicationMap)
+				{
+					Replicator.Value->CountBytes(CountMem);
+				}
+				Report.ReplicationBytes += Channel->GetClass()->GetStructureSize() + CountMem.GetMax();
+				++Report.NumChannels;
+			}
+		}
+	}
+
+	return Report;
+}
+
+double FDroneMemoryReport::GetBytesPerDrone() const
+{
+	uint64 TotalBytes = 0;
+	for (const TPair<FString, uint64>& Category : CategoryBytes)
+	{
+		TotalBytes += Category.Value;
+	}
+	return NumDrones > 0 ? (double)TotalBytes / NumDrones : 0.0;
+}
+
+double FDroneMemoryReport::GetReplicationBytesPerConnection() const
+{
+	return NumChannels > 0 ? (double)ReplicationBytes / NumChannels : 0.0;
+}
+
+void FDroneMemoryReport::Log() const
+{
+	TArray<TPair<FString, uint64>> Sorted = CategoryBytes.Array();
+	Sorted.Sort([](const TPair<FString, uint64>& A, const TPair<FString, uint64>& B) { return A.Value > B.Value; });
+
+	UE_LOG(LogAIDrone, Display, TEXT("Drone memory: %.1f KB per drone, averaged over %d drones"), GetBytesPerDrone() / 1024.0, NumDrones);
+	for (const TPair<FString, uint64>& Category : Sorted)
+	{
+		UE_LOG(LogAIDrone, Display, TEXT("  %-28s %10.2f KB"), *Category.Key, NumDrones > 0 ? Category.Value / 1024.0 / NumDrones : 0.0);
+	}
+
+	if (NumChannels > 0)
+	{
+		UE_LOG(LogAIDrone, Display, TEXT("Drone replication: %.2f KB per drone per connection, over %d channels on %d connections"),
+			GetReplicationBytesPerConnection() / 1024.0, NumChannels, NumConnections);
+	}
+	else
+	{
+		UE_LOG(LogAIDrone, Display, TEXT("Drone replication: no drone channels open on %d client connections"), NumConnections);
+	}
+}
+
+TArray<FString> FDroneMemoryReport::GetBudgetErrors() const
+{
+	TArray<FString> Errors;
+
+	const float BudgetKB = CVarDroneMemoryBudgetKB.GetValueOnGameThread();
+	if (BudgetKB > 0.0f && GetBytesPerDrone() > BudgetKB * 1024.0)
+	{
+		Errors.Add(FString::Printf(TEXT("Drone memory over budget: %.1f KB per drone, budget %.1f KB (drone.Memory.BudgetKB)"), GetBytesPerDrone() / 1024.0, BudgetKB));
+	}
+
+	const float ReplicationBudgetKB = CVarDroneMemoryReplicationBudgetKB.GetValueOnGameThread();
+	if (ReplicationBudgetKB > 0.0f && GetReplicationBytesPerConnection() > ReplicationBudgetKB * 1024.0)
+	{
+		Errors.Add(FString::Printf(TEXT("Drone replication memory over budget: %.2f KB per drone per connection, budget %.1f KB (drone.Memory.ReplicationBudgetKB)"),
+			GetReplicationBytesPerConnection() / 1024.0, ReplicationBudgetKB));
+	}
+
+	return Errors;
+}
+
+bool FDroneMemoryReport::IsWithinBudget() const
+{
+	const TArray<FString> Errors = GetBudgetErrors();
+	for (const FString& Error : Errors)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("%s"), *Error);
+	}
+	return Errors.IsEmpty();
+}
@@ -0,0 +1,329 @@
+﻿#include "AIDroneNavBrickMap.h"
+#include "Algo/Reverse.h"
+
+namespace
+{
+	FORCEINLINE int32 FloorDiv(int32 Value, int32 Divisor)
+	{
+		return Value >= 0 ? Value / Divisor : (Value - Divisor + 1) / Divisor;
+	}
+
+	struct FOpenEntry
+	{
+		float F;
+		int32 Node;
+	};
+
+	struct FOpenEntryPredicate
+	{
+		FORCEINLINE bool operator()(const FOpenEntry& A, const FOpenEntry& B) const { return A.F < B.F; }
+	};
+}
+
+FDroneNavBrickMap::FDroneNavBrickMap(const FBox& InBounds, float InVoxelSize)
+	: Bounds(InBounds)
+	, VoxelSize(FMath::Max(InVoxelSize, 1.0f))
+{
+	const FVector Size = Bounds.GetSize();
+	NumVoxels = FIntVector(
+		FMath::Max(FMath::CeilToInt(Size.X / VoxelSize), 1),
+		FMath::Max(FMath::CeilToInt(Size.Y / VoxelSize), 1),
+		FMath::Max(FMath::CeilToInt(Size.Z / VoxelSize), 1));
+	NumBricks = FIntVector(
+		FMath::DivideAndRoundUp(NumVoxels.X, BrickDim),
+		FMath::DivideAndRoundUp(NumVoxels.Y, BrickDim),
+		FMath::DivideAndRoundUp(NumVoxels.Z, BrickDim));
+}
+
+FIntVector FDroneNavBrickMap::WorldToVoxel(const FVector& Location) const
+{
+	const FVector Local = (Location - Bounds.Min) / VoxelSize;
+	return FIntVector(FMath::FloorToInt(Local.X), FMath::FloorToInt(Local.Y), FMath::FloorToInt(Local.Z));
+}
+
+FVector FDroneNavBrickMap::VoxelToWorld(const FIntVector& Voxel) const
+{
+	return Bounds.Min + (FVector(Voxel) + 0.5) * VoxelSize;
+}
+
+FBox FDroneNavBrickMap::GetBrickBounds(const FIntVector& Brick) const
+{
+	const FVector Min = Bounds.Min + FVector(Brick) * (VoxelSize * BrickDim);
+	return FBox(Min, Min + FVector(VoxelSize * BrickDim));
+}
+
+FIntVector FDroneNavBrickMap::VoxelToBrick(const FIntVector& Voxel)
+{
+	return FIntVector(FloorDiv(Voxel.X, BrickDim), FloorDiv(Voxel.Y, BrickDim), FloorDiv(Voxel.Z, BrickDim));
+}
+
+int32 FDroneNavBrickMap::GetBrickBitIndex(const FIntVector& Voxel)
+{
+	const int32 X = Voxel.X - FloorDiv(Voxel.X, BrickDim) * BrickDim;
+	const int32 Y = Voxel.Y - FloorDiv(Voxel.Y, BrickDim) * BrickDim;
+	const int32 Z = Voxel.Z - FloorDiv(Voxel.Z, BrickDim) * BrickDim;
+	return X + Y * BrickDim + Z * BrickDim * BrickDim;
+}
+
+FIntVector FDroneNavBrickMap::BrickToSector(const FIntVector& Brick)
+{
+	return FIntVector(FloorDiv(Brick.X, SectorDim), FloorDiv(Brick.Y, SectorDim), FloorDiv(Brick.Z, SectorDim));
+}
+
+int32 FDroneNavBrickMap::GetSectorBrickIndex(const FIntVector& Brick)
+{
+	const int32 X = Brick.X - FloorDiv(Brick.X, SectorDim) * SectorDim;
+	const int32 Y = Brick.Y - FloorDiv(Brick.Y, SectorDim) * SectorDim;
+	const int32 Z = Brick.Z - FloorDiv(Brick.Z, SectorDim) * SectorDim;
+	return X + Y * SectorDim + Z * SectorDim * SectorDim;
+}
+
+bool FDroneNavBrickMap::IsInBounds(const FIntVector& Voxel) const
+{
+	return Voxel.X >= 0 && Voxel.Y >= 0 && Voxel.Z >= 0
+		&& Voxel.X < NumVoxels.X && Voxel.Y < NumVoxels.Y && Voxel.Z < NumVoxels.Z;
+}
+
+bool FDroneNavBrickMap::IsBlocked(const FIntVector& Voxel) const
+{
+	if (!IsInBounds(Voxel))
+	{
+		return true;
+	}
+
+	const FIntVector Brick = VoxelToBrick(Voxel);
+	const TSharedPtr<FSector>* Sector = Sectors.Find(BrickToSector(Brick));
+	return Sector && ((*Sector)->Bricks[GetSectorBrickIndex(Brick)] & (uint64(1) << GetBrickBitIndex(Voxel))) != 0;
+}
+
+bool FDroneNavBrickMap::HasLineOfSight(const FVector& From, const FVector& To) const
+{
+	const FVector Delta = To - From;
+	const int32 Steps = FMath::Max(FMath::CeilToInt(Delta.Size() / (VoxelSize * 0.5f)), 1);
+	for (int32 Step = 0; Step <= Steps; ++Step)
+	{
+		if (IsBlocked(WorldToVoxel(From + Delta * (double(Step) / Steps))))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FDroneNavBrickMap::FindNearestFreeVoxel(const FIntVector& Voxel, int32 SearchRadius, FIntVector& OutVoxel) const
+{
+	for (int32 Radius = 0; Radius <= SearchRadius; ++Radius)
+	{
+		for (int32 Z = -Radius; Z <= Radius; ++Z)
+		for (int32 Y = -Radius; Y <= Radius; ++Y)
+		for (int32 X = -Radius; X <= Radius; ++X)
+		{
+			// Only the shell of this radius, inner ones were already checked
+			if (FMath::Max3(FMath::Abs(X), FMath::Abs(Y), FMath::Abs(Z)) != Radius)
+			{
+				continue;
+			}
+
+			const FIntVector Candidate = Voxel + FIntVector(X, Y, Z);
+			if (!IsBlocked(Candidate))
+			{
+				OutVoxel = Candidate;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void FDroneNavBrickMap::SetBrick(const FIntVector& Brick, uint64 Occupancy)
+{
+	const FIntVector SectorCoord = BrickToSector(Brick);
+	const int32 Index = GetSectorBrickIndex(Brick);
+
+	TSharedPtr<FSector>* Sector = Sectors.Find(SectorCoord);
+	if (!Sector)
+	{
+		if (!Occupancy)
+		{
+			return;
+		}
+		Sector = &Sectors.Add(SectorCoord, MakeShared<FSector>());
+	}
+	else if ((*Sector)->Bricks[Index] == Occupancy)
+	{
+		return;
+	}
+	else if (!Sector->IsUnique())
+	{
+		// Published snapshots may still be reading this sector
+		*Sector = MakeShared<FSector>(**Sector);
+	}
+
+	const int32 StoredDelta = (Occupancy != 0 ? 1 : 0) - ((*Sector)->Bricks[Index] != 0 ? 1 : 0);
+	(*Sector)->Bricks[Index] = Occupancy;
+	(*Sector)->NumStoredBricks += StoredDelta;
+	NumStoredBricks += StoredDelta;
+
+	if ((*Sector)->NumStoredBricks == 0)
+	{
+		Sectors.Remove(SectorCoord);
+	}
+}
+
+TSharedPtr<FDroneNavPath> FDroneNavBrickMap::FindPath(const FVector& Start, const FVector& Goal, int32 MaxExpansions) const
+{
+	TSharedPtr<FDroneNavPath> Path = MakeShared<FDroneNavPath>();
+	Path->MapVersion = Version;
+
+	FIntVector StartVoxel;
+	FIntVector GoalVoxel;
+	if (!FindNearestFreeVoxel(WorldToVoxel(Start), 2, StartVoxel))
+	{
+		Path->bPartial = true;
+		return Path;
+	}
+	const bool bGoalReachable = FindNearestFreeVoxel(WorldToVoxel(Goal), 2, GoalVoxel);
+	if (!bGoalReachable)
+	{
+		GoalVoxel = WorldToVoxel(Goal);
+	}
+
+	// Straight shot, no search needed
+	if (bGoalReachable && HasLineOfSight(Start, Goal))
+	{
+		Path->Points = { Start, Goal };
+		return Path;
+	}
+
+	TArray<FIntVector> NodeVoxels;
+	TArray<int32> Parents;
+	TArray<float> GCosts;
+	TBitArray<> Closed;
+	TMap<FIntVector, int32> NodeLookup;
+	TArray<FOpenEntry> Open;
+
+	auto Heuristic = [&GoalVoxel](const FIntVector& Voxel)
+	{
+		return float(FVector(Voxel - GoalVoxel).Size());
+	};
+
+	NodeVoxels.Add(StartVoxel);
+	Parents.Add(INDEX_NONE);
+	GCosts.Add(0.0f);
+	Closed.Add(false);
+	NodeLookup.Add(StartVoxel, 0);
+	Open.HeapPush({ Heuristic(StartVoxel), 0 }, FOpenEntryPredicate());
+
+	int32 BestNode = 0;
+	float BestH = Heuristic(StartVoxel);
+	int32 GoalNode = INDEX_NONE;
+	int32 Expansions = 0;
+
+	while (Open.Num() > 0 && Expansions < MaxExpansions)
+	{
+		FOpenEntry Entry;
+		Open.HeapPop(Entry, FOpenEntryPredicate(), EAllowShrinking::No);
+		if (Closed[Entry.Node])
+		{
+			continue;
+		}
+		Closed[Entry.Node] = true;
+		++Expansions;
+
+		const FIntVector Voxel = NodeVoxels[Entry.Node];
+		if (Voxel == GoalVoxel)
+		{
+			GoalNode = Entry.Node;
+			break;
+		}
+
+		const float H = Heuristic(Voxel);
+		if (H < BestH)
+		{
+			BestH = H;
+			BestNode = Entry.Node;
+		}
+
+		for (int32 Z = -1; Z <= 1; ++Z)
+		for (int32 Y = -1; Y <= 1; ++Y)
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			if (X == 0 && Y == 0 && Z == 0)
+			{
+				continue;
+			}
+
+			const FIntVector Next = Voxel + FIntVector(X, Y, Z);
+			if (IsBlocked(Next))
+			{
+				continue;
+			}
+
+			// Diagonal moves must not cut through blocked corners
+			if ((X != 0 && IsBlocked(Voxel + FIntVector(X, 0, 0)))
+				|| (Y != 0 && IsBlocked(Voxel + FIntVector(0, Y, 0)))
+				|| (Z != 0 && IsBlocked(Voxel + FIntVector(0, 0, Z))))
+			{
+				continue;
+			}
+
+			const float StepCost = FMath::Sqrt(float(X * X + Y * Y + Z * Z));
+			const float G = GCosts[Entry.Node] + StepCost;
+
+			int32 NextNode;
+			if (const int32* Existing = NodeLookup.Find(Next))
+			{
+				NextNode = *Existing;
+				if (Closed[NextNode] || G >= GCosts[NextNode])
+				{
+					continue;
+				}
+				GCosts[NextNode] = G;
+				Parents[NextNode] = Entry.Node;
+			}
+			else
+			{
+				NextNode = NodeVoxels.Add(Next);
+				Parents.Add(Entry.Node);
+				GCosts.Add(G);
+				Closed.Add(false);
+				NodeLookup.Add(Next, NextNode);
+			}
+
+			Open.HeapPush({ G + Heuristic(Next), NextNode }, FOpenEntryPredicate());
+		}
+	}
+
+	const int32 EndNode = GoalNode != INDEX_NONE ? GoalNode : BestNode;
+	Path->bPartial = GoalNode == INDEX_NONE || !bGoalReachable;
+
+	TArray<FVector> Raw;
+	for (int32 Node = EndNode; Node != INDEX_NONE; Node = Parents[Node])
+	{
+		Raw.Add(VoxelToWorld(NodeVoxels[Node]));
+	}
+	Algo::Reverse(Raw);
+	Raw[0] = Start;
+	if (!Path->bPartial)
+	{
+		Raw.Last() = Goal;
+	}
+
+	// Drop every waypoint that can be skipped with a clear line of sight
+	Path->Points.Add(Raw[0]);
+	int32 Anchor = 0;
+	for (int32 Index = 2; Index < Raw.Num(); ++Index)
+	{
+		if (!HasLineOfSight(Raw[Anchor], Raw[Index]))
+		{
+			Anchor = Index - 1;
+			Path->Points.Add(Raw[Anchor]);
+		}
+	}
+	if (Raw.Num() > 1)
+	{
+		Path->Points.Add(Raw.Last());
+	}
+
+	return Path;
+}
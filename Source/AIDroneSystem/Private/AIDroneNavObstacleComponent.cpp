@@ -0,0 +1,65 @@
+﻿#include "AIDroneNavObstacleComponent.h"
+#include "AIDroneNavSubsystem.h"
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+void UAIDroneNavObstacleComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ObstacleBounds = GetOwner()->GetComponentsBoundingBox();
+	if (UAIDroneNavSubsystem* NavSubsystem = GetWorld()->GetSubsystem<UAIDroneNavSubsystem>())
+	{
+		NavSubsystem->RegisterObstacle(this);
+	}
+
+	if (USceneComponent* Root = GetOwner()->GetRootComponent())
+	{
+		TrackedRoot = Root;
+		TransformUpdatedHandle = Root->TransformUpdated.AddUObject(this, &UAIDroneNavObstacleComponent::OnTransformUpdated);
+	}
+}
+
+void UAIDroneNavObstacleComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (USceneComponent* Root = TrackedRoot.Get())
+	{
+		Root->TransformUpdated.Remove(TransformUpdatedHandle);
+	}
+	TrackedRoot.Reset();
+
+	// Unregistering rebuilds the space the actor occupied
+	if (UAIDroneNavSubsystem* NavSubsystem = GetWorld()->GetSubsystem<UAIDroneNavSubsystem>())
+	{
+		NavSubsystem->UnregisterObstacle(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UAIDroneNavObstacleComponent::OnTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	const FBox NewBounds = GetOwner()->GetComponentsBoundingBox();
+	if (NewBounds.IsValid == ObstacleBounds.IsValid && NewBounds.Min.Equals(ObstacleBounds.Min, RebuildDistance) && NewBounds.Max.Equals(ObstacleBounds.Max, RebuildDistance))
+	{
+		return;
+	}
+
+	const FBox OldBounds = ObstacleBounds;
+	ObstacleBounds = NewBounds;
+
+	if (UAIDroneNavSubsystem* NavSubsystem = GetWorld()->GetSubsystem<UAIDroneNavSubsystem>())
+	{
+		// Small moves overlap the old bounds, so one rebuild covers both; a jump rebuilds the two places separately
+		if (OldBounds.Intersect(NewBounds))
+		{
+			NavSubsystem->MarkDirty(OldBounds + NewBounds);
+		}
+		else
+		{
+			NavSubsystem->MarkDirty(OldBounds);
+			NavSubsystem->MarkDirty(NewBounds);
+		}
+	}
+}
@@ -0,0 +1,368 @@
+﻿#include "AIDroneNavSubsystem.h"
+#include "AIDroneNavObstacleComponent.h"
+#include "AIDroneNavVolume.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Async/Async.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+static TAutoConsoleVariable<float> CVarDroneNavBuildBudgetMs(
+	TEXT("drone.Nav.BuildBudgetMs"),
+	2.0f,
+	TEXT("Game thread milliseconds per frame spent voxelizing drone navigation; 0 or less builds everything in one frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDroneNavMaxExpansions(
+	TEXT("drone.Nav.MaxExpansions"),
+	20000,
+	TEXT("Maximum voxels a single background path query may expand before returning a partial path."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneNavPathCacheLifetime(
+	TEXT("drone.Nav.PathCacheLifetime"),
+	2.0f,
+	TEXT("Seconds a computed drone path is shared with other drones heading to the same region."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<bool> CVarDroneNavSynchronousQueries(
+	TEXT("drone.Nav.SynchronousQueries"),
+	false,
+	TEXT("Plans drone paths on the game thread inside RequestPath, so results never depend on thread timing."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs DroneDistanceFieldBenchmarkCommand(
+	TEXT("drone.DistanceField.Benchmark"),
+	TEXT("Compares the cost of distance field raycasts against LineTraceSingleByChannel. Usage: drone.DistanceField.Benchmark [NumQueries]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const UAIDroneNavSubsystem* NavSubsystem = World ? World->GetSubsystem<UAIDroneNavSubsystem>() : nullptr;
+		const FDroneDistanceField* DistanceField = NavSubsystem ? NavSubsystem->GetDistanceField() : nullptr;
+		if (!DistanceField)
+		{
+			UE_LOG(LogAIDrone, Warning, TEXT("No drone distance field loaded for this world"));
+			return;
+		}
+
+		const int32 NumQueries = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const float RayLength = 300.0f;
+		const FBox Bounds = DistanceField->GetBounds();
+
+		// Same rays for both so the comparison is fair
+		FRandomStream Random(1234);
+		TArray<FVector> Starts;
+		TArray<FVector> Directions;
+		for (int32 Index = 0; Index < NumQueries; ++Index)
+		{
+			Starts.Add(Random.RandPointInBox(Bounds.ExpandBy(-RayLength)));
+			Directions.Add(Random.GetUnitVector());
+		}
+
+		int32 FieldHits = 0;
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < NumQueries; ++Index)
+		{
+			FVector Normal;
+			bool bInBounds;
+			FieldHits += DistanceField->Raycast(Starts[Index], Directions[Index], RayLength, 0.0f, Normal, bInBounds) ? 1 : 0;
+		}
+		const double FieldSeconds = FPlatformTime::Seconds() - StartTime;
+
+		int32 TraceHits = 0;
+		const FCollisionQueryParams Params(SCENE_QUERY_STAT(DroneDistanceFieldBenchmark), false);
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < NumQueries; ++Index)
+		{
+			FHitResult HitResult;
+			TraceHits += World->LineTraceSingleByChannel(HitResult, Starts[Index], Starts[Index] + Directions[Index] * RayLength, ECC_Visibility, Params) ? 1 : 0;
+		}
+		const double TraceSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogAIDrone, Display, TEXT("Distance field: %.3f us/query (%d hits), line trace: %.3f us/query (%d hits), speedup %.1fx over %d queries"),
+			FieldSeconds * 1.0e6 / NumQueries, FieldHits, TraceSeconds * 1.0e6 / NumQueries, TraceHits,
+			FieldSeconds > 0.0 ? TraceSeconds / FieldSeconds : 0.0, NumQueries);
+	}));
+
+bool UAIDroneNavSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UAIDroneNavSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAIDroneNavSubsystem, STATGROUP_Tickables);
+}
+
+void UAIDroneNavSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Flight paths are only planned where drone AI runs
+	if (InWorld.GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	const FString BakePath = FDroneDistanceField::GetBakePath(UWorld::RemovePIEPrefix(InWorld.GetMapName()));
+	if (DistanceField.Load(BakePath))
+	{
+		UE_LOG(LogAIDrone, Log, TEXT("Loaded drone distance field '%s'"), *BakePath);
+	}
+
+	FBox Bounds(ForceInit);
+	float VoxelSize = TNumericLimits<float>::Max();
+	for (TActorIterator<AAIDroneNavVolume> It(&InWorld); It; ++It)
+	{
+		Bounds += It->GetBounds().GetBox();
+		VoxelSize = FMath::Min(VoxelSize, It->VoxelSize);
+	}
+
+	if (!Bounds.IsValid)
+	{
+		return;
+	}
+
+	Building = MakeUnique<FDroneNavBrickMap>(Bounds, VoxelSize);
+	QueueBricks(Bounds);
+}
+
+void UAIDroneNavSubsystem::Deinitialize()
+{
+	// In-flight queries hold their own snapshot reference and report back through a weak pointer
+	PendingQueries.Reset();
+	PathCache.Reset();
+	Obstacles.Reset();
+	Building.Reset();
+	Snapshot.Reset();
+	DistanceField.Unload();
+
+	Super::Deinitialize();
+}
+
+float UAIDroneNavSubsystem::GetReplanDistance() const
+{
+	return Snapshot.IsValid() ? Snapshot->GetVoxelSize() * FDroneNavBrickMap::BrickDim : 0.0f;
+}
+
+void UAIDroneNavSubsystem::MarkDirty(const FBox& Region)
+{
+	if (!Snapshot.IsValid() && !Building.IsValid())
+	{
+		return;
+	}
+
+	// Shares every sector with the snapshot; only the ones the rebuild changes get copied
+	if (!Building.IsValid())
+	{
+		Building = MakeUnique<FDroneNavBrickMap>(*Snapshot);
+	}
+	QueueBricks(Region);
+}
+
+void UAIDroneNavSubsystem::FlushBuild()
+{
+	if (Building.IsValid())
+	{
+		ProcessBuildQueue(0.0);
+	}
+}
+
+void UAIDroneNavSubsystem::RegisterObstacle(UAIDroneNavObstacleComponent* Obstacle)
+{
+	Obstacles.AddUnique(Obstacle);
+	MarkDirty(Obstacle->GetObstacleBounds());
+}
+
+void UAIDroneNavSubsystem::UnregisterObstacle(UAIDroneNavObstacleComponent* Obstacle)
+{
+	Obstacles.Remove(Obstacle);
+	MarkDirty(Obstacle->GetObstacleBounds());
+}
+
+void UAIDroneNavSubsystem::QueueBricks(const FBox& Region)
+{
+	const FBox Clipped = Region.Overlap(Building->GetBounds());
+	if (!Clipped.IsValid)
+	{
+		return;
+	}
+
+	const FIntVector MinBrick = FDroneNavBrickMap::VoxelToBrick(Building->WorldToVoxel(Clipped.Min));
+	const FIntVector MaxBrick = FDroneNavBrickMap::VoxelToBrick(Building->WorldToVoxel(Clipped.Max));
+	for (int32 Z = MinBrick.Z; Z <= MaxBrick.Z; ++Z)
+	for (int32 Y = MinBrick.Y; Y <= MaxBrick.Y; ++Y)
+	for (int32 X = MinBrick.X; X <= MaxBrick.X; ++X)
+	{
+		const FIntVector Brick(X, Y, Z);
+		bool bAlreadyQueued = false;
+		QueuedBricks.Add(Brick, &bAlreadyQueued);
+		if (!bAlreadyQueued)
+		{
+			BuildQueue.Add(Brick);
+		}
+	}
+}
+
+uint64 UAIDroneNavSubsystem::SampleBrick(const FIntVector& Brick) const
+{
+	UWorld* World = GetWorld();
+
+	// Movable collision would be baked in where it happened to be; only registered obstacles are tracked
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(DroneNavVoxelize), false);
+
+	const FBox BrickBounds = Building->GetBrickBounds(Brick);
+	TArray<UPrimitiveComponent*, TInlineAllocator<8>> ObstaclePrimitives;
+	for (const TWeakObjectPtr<UAIDroneNavObstacleComponent>& Obstacle : Obstacles)
+	{
+		if (Obstacle.IsValid() && Obstacle->GetObstacleBounds().Intersect(BrickBounds))
+		{
+			Obstacle->GetOwner()->ForEachComponent<UPrimitiveComponent>(false, [&ObstaclePrimitives](UPrimitiveComponent* Primitive)
+			{
+				if (Primitive->IsQueryCollisionEnabled())
+				{
+					ObstaclePrimitives.Add(Primitive);
+				}
+			});
+		}
+	}
+
+	// One coarse overlap rejects empty bricks before touching their 64 voxels
+	const bool bStaticInBrick = World->OverlapAnyTestByObjectType(BrickBounds.GetCenter(), FQuat::Identity, ObjectParams, FCollisionShape::MakeBox(BrickBounds.GetExtent()), QueryParams);
+	if (!bStaticInBrick && ObstaclePrimitives.Num() == 0)
+	{
+		return 0;
+	}
+
+	const float VoxelSize = Building->GetVoxelSize();
+	const FCollisionShape VoxelShape = FCollisionShape::MakeBox(FVector(VoxelSize * 0.5f));
+	const FIntVector FirstVoxel = Brick * FDroneNavBrickMap::BrickDim;
+
+	uint64 Occupancy = 0;
+	for (int32 Z = 0; Z < FDroneNavBrickMap::BrickDim; ++Z)
+	for (int32 Y = 0; Y < FDroneNavBrickMap::BrickDim; ++Y)
+	for (int32 X = 0; X < FDroneNavBrickMap::BrickDim; ++X)
+	{
+		const FIntVector Voxel = FirstVoxel + FIntVector(X, Y, Z);
+		const FVector Center = Building->VoxelToWorld(Voxel);
+		bool bBlocked = bStaticInBrick && World->OverlapAnyTestByObjectType(Center, FQuat::Identity, ObjectParams, VoxelShape, QueryParams);
+		for (int32 Index = 0; !bBlocked && Index < ObstaclePrimitives.Num(); ++Index)
+		{
+			bBlocked = ObstaclePrimitives[Index]->OverlapComponent(Center, FQuat::Identity, VoxelShape);
+		}
+
+		if (bBlocked)
+		{
+			Occupancy |= uint64(1) << FDroneNavBrickMap::GetBrickBitIndex(Voxel);
+		}
+	}
+	return Occupancy;
+}
+
+void UAIDroneNavSubsystem::ProcessBuildQueue(double BudgetSeconds)
+{
+	const double EndTime = BudgetSeconds > 0.0 ? FPlatformTime::Seconds() + BudgetSeconds : TNumericLimits<double>::Max();
+	while (BuildQueue.Num() > 0 && FPlatformTime::Seconds() < EndTime)
+	{
+		const FIntVector Brick = BuildQueue.Pop(EAllowShrinking::No);
+		QueuedBricks.Remove(Brick);
+		Building->SetBrick(Brick, SampleBrick(Brick));
+	}
+
+	if (BuildQueue.Num() == 0)
+	{
+		// Publish; queries already running keep the snapshot they started with
+		Building->Version = Snapshot.IsValid() ? Snapshot->Version + 1 : 1;
+		Snapshot = MakeShareable(Building.Release());
+		PathCache.Reset();
+	}
+}
+
+void UAIDroneNavSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Building.IsValid())
+	{
+		ProcessBuildQueue(CVarDroneNavBuildBudgetMs.GetValueOnGameThread() / 1000.0);
+	}
+
+	// Expire stale shared paths so moving targets get re-planned
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double Lifetime = CVarDroneNavPathCacheLifetime.GetValueOnGameThread();
+	for (auto It = PathCache.CreateIterator(); It; ++It)
+	{
+		if (Now - It->Value.Time > Lifetime)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TSharedPtr<const FDroneNavPath> UAIDroneNavSubsystem::RequestPath(const FVector& Start, const FVector& Goal, FOnDronePathFound OnFound)
+{
+	if (!Snapshot.IsValid())
+	{
+		return nullptr;
+	}
+
+	const FPathKey Key{ FDroneNavBrickMap::VoxelToBrick(Snapshot->WorldToVoxel(Start)), FDroneNavBrickMap::VoxelToBrick(Snapshot->WorldToVoxel(Goal)) };
+	if (const FCachedPath* Cached = PathCache.Find(Key))
+	{
+		return Cached->Path;
+	}
+
+	if (CVarDroneNavSynchronousQueries.GetValueOnGameThread())
+	{
+		TSharedPtr<const FDroneNavPath> Path = Snapshot->FindPath(Start, Goal, CVarDroneNavMaxExpansions.GetValueOnGameThread());
+		PathCache.Add(Key, { Path, GetWorld()->GetTimeSeconds() });
+		return Path;
+	}
+
+	if (TArray<FOnDronePathFound>* Pending = PendingQueries.Find(Key))
+	{
+		Pending->Add(MoveTemp(OnFound));
+		return nullptr;
+	}
+	PendingQueries.Add(Key).Add(MoveTemp(OnFound));
+
+	TSharedPtr<const FDroneNavBrickMap> QuerySnapshot = Snapshot;
+	const int32 MaxExpansions = CVarDroneNavMaxExpansions.GetValueOnGameThread();
+	TWeakObjectPtr<UAIDroneNavSubsystem> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [QuerySnapshot, Start, Goal, MaxExpansions, Key, WeakThis]()
+	{
+		TSharedPtr<const FDroneNavPath> Path = QuerySnapshot->FindPath(Start, Goal, MaxExpansions);
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Key, Path]()
+		{
+			if (UAIDroneNavSubsystem* This = WeakThis.Get())
+			{
+				This->OnPathFound(Key, Path);
+			}
+		});
+	});
+
+	return nullptr;
+}
+
+void UAIDroneNavSubsystem::OnPathFound(const FPathKey& Key, TSharedPtr<const FDroneNavPath> Path)
+{
+	TArray<FOnDronePathFound> Callbacks;
+	if (!PendingQueries.RemoveAndCopyValue(Key, Callbacks))
+	{
+		return;
+	}
+
+	// Only share paths planned against the current brick map
+	if (Snapshot.IsValid() && Path->MapVersion == Snapshot->Version)
+	{
+		PathCache.Add(Key, { Path, GetWorld()->GetTimeSeconds() });
+	}
+
+	for (FOnDronePathFound& Callback : Callbacks)
+	{
+		Callback.ExecuteIfBound(Path);
+	}
+}
@@ -1,6 +1,85 @@
 ﻿#include "AIDronePlayerController.h"
 #include "GameFramework/Pawn.h"
 #include "Engine/Engine.h"
+#include "Engine/LocalPlayer.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "AIDroneSystem/AIDroneSystemCharacter.h"
+#include "AIDrone.h"
+#include "AIDroneStats.h"
+#include "Engine/World.h"
+#include "EnhancedInputComponent.h"
+#include "EnhancedInputSubsystems.h"
+#include "HAL/IConsoleManager.h"
+#include "InputMappingContext.h"
+
+static TAutoConsoleVariable<bool> CVarDronePossessPredict(
+	TEXT("drone.Possess.Predict"),
+	true,
+	TEXT("Switches camera and input to a drone or character as soon as the player asks to possess it, without waiting for the server."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDronePossessTimeout(
+	TEXT("drone.Possess.Timeout"),
+	2.0f,
+	TEXT("Seconds a predicted possession waits for the server before it is rolled back."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneServerMoveRateLimit(
+	TEXT("drone.ServerMove.RateLimit"),
+	60.0f,
+	TEXT("ServerMoves per second the server processes for each connection; moves beyond it are merged into the next processed one. 0 disables the limit."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarDroneServerMoveBurst(
+	TEXT("drone.ServerMove.Burst"),
+	8.0f,
+	TEXT("ServerMoves a connection may send back to back above drone.ServerMove.RateLimit, to absorb network jitter."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDroneServerMoveFloodLimit(
+	TEXT("drone.ServerMove.FloodLimit"),
+	600,
+	TEXT("ServerMoves per second from one connection beyond which further moves that second are dropped unread. 0 disables it."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld DronePossessReportCommand(
+	TEXT("drone.Possess.Report"),
+	TEXT("Logs how long predicted possession swaps waited for the server, and how many were rolled back."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			const AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(It->Get());
+			if (DronePC && DronePC->IsLocalController())
+			{
+				DronePC->LogSwapStats();
+			}
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld DroneServerMoveReportCommand(
+	TEXT("drone.ServerMove.Report"),
+	TEXT("Logs how many ServerMoves each connection has had merged and dropped by rate limiting."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			if (const AAIDronePlayerController* DronePC = Cast<AAIDronePlayerController>(It->Get()))
+			{
+				UE_LOG(LogAIDrone, Display, TEXT("%s: %lld ServerMoves merged, %lld dropped"), *DronePC->GetName(), DronePC->GetNumMergedMoves(), DronePC->GetNumDroppedMoves());
+			}
+		}
+	}));
 
 AAIDronePlayerController::AAIDronePlayerController()
 {
@@ -16,20 +95,20 @@ void AAIDronePlayerController::OnPossess(APawn* InPawn)
 	if (CurrentPawn && CurrentPawn != InPawn)
 	{
 		PreviousPawn = CurrentPawn;
-		UE_LOG(LogTemp, Warning, TEXT("PlayerController: Storing previous pawn: %s"), *PreviousPawn->GetName());
+		UE_LOG(LogAIDrone, Verbose, TEXT("PlayerController: Storing previous pawn: %s"), *PreviousPawn->GetName());
 	}
 	
 	// Call parent OnPossess
 	Super::OnPossess(InPawn);
 	
-	UE_LOG(LogTemp, Warning, TEXT("PlayerController: Now possessing: %s"), InPawn ? *InPawn->GetName() : TEXT("None"));
+	UE_LOG(LogAIDrone, Verbose, TEXT("PlayerController: Now possessing: %s"), InPawn ? *InPawn->GetName() : TEXT("None"));
 }
 
 void AAIDronePlayerController::PossessPreviousPawn()
 {
 	if (PreviousPawn && IsValid(PreviousPawn))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("PlayerController: Switching back to previous pawn: %s"), *PreviousPawn->GetName());
+		UE_LOG(LogAIDrone, Verbose, TEXT("PlayerController: Switching back to previous pawn: %s"), *PreviousPawn->GetName());
 		
 		// Store current as temp before switching
 		APawn* Temp = PreviousPawn;
@@ -39,6 +118,306 @@ void AAIDronePlayerController::PossessPreviousPawn()
 	}
 	else
 	{
-		UE_LOG(LogTemp, Warning, TEXT("PlayerController: No valid previous pawn to possess!"));
+		UE_LOG(LogAIDrone, Warning, TEXT("PlayerController: No valid previous pawn to possess!"));
+		ClientRejectPossession(nullptr);
+	}
+}
+
+UEnhancedInputLocalPlayerSubsystem* AAIDronePlayerController::GetInputSubsystem() const
+{
+	return IsLocalController() ? ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(GetLocalPlayer()) : nullptr;
+}
+
+UInputMappingContext* AAIDronePlayerController::GetInputContextFor(const APawn* Pawn)
+{
+	if (const AAIDrone* Drone = Cast<AAIDrone>(Pawn))
+	{
+		return Drone->GetInputMappingContext();
+	}
+	if (const AAIDroneSystemCharacter* Character = Cast<AAIDroneSystemCharacter>(Pawn))
+	{
+		return Character->GetInputMappingContext();
+	}
+	return nullptr;
+}
+
+void AAIDronePlayerController::PreloadInputContext(UInputMappingContext* Context)
+{
+	UEnhancedInputLocalPlayerSubsystem* Subsystem = GetInputSubsystem();
+	if (!Subsystem || !Context || InputContexts.Contains(Context))
+	{
+		return;
+	}
+
+	InputContexts.Add(Context);
+	Subsystem->AddMappingContext(Context, InactiveInputPriority);
+}
+
+void AAIDronePlayerController::ActivateInputContext(UInputMappingContext* Context)
+{
+	UEnhancedInputLocalPlayerSubsystem* Subsystem = GetInputSubsystem();
+	if (!Subsystem || !Context)
+	{
+		return;
+	}
+
+	// Contexts stay applied; the active one outranks the rest, so keys they share go to the active pawn's actions
+	InputContexts.AddUnique(Context);
+	for (UInputMappingContext* Applied : InputContexts)
+	{
+		const int32 Priority = Applied == Context ? ActiveInputPriority : InactiveInputPriority;
+		int32 CurrentPriority;
+		if (!Subsystem->HasMappingContext(Applied, CurrentPriority) || CurrentPriority != Priority)
+		{
+			Subsystem->AddMappingContext(Applied, Priority);
+		}
+	}
+}
+
+bool AAIDronePlayerController::PredictPossession(APawn* Pawn)
+{
+	APawn* CurrentPawn = GetPawn();
+	if (!CVarDronePossessPredict.GetValueOnGameThread() || !IsLocalController() || !IsValid(Pawn) || !CurrentPawn
+		|| Pawn == CurrentPawn || PredictedPawn.IsValid())
+	{
+		return false;
+	}
+
+	PredictedPawn = Pawn;
+	PredictedFromPawn = CurrentPawn;
+	PredictionStartTime = FPlatformTime::Seconds();
+	BufferedInput.Reset();
+	bReplayBufferedInput = false;
+
+	SetViewTarget(Pawn);
+	CurrentPawn->DisableInput(this);
+
+	UInputMappingContext* Context = GetInputContextFor(Pawn);
+	ActivateInputContext(Context);
+
+	if (!PredictionInputComponent)
+	{
+		PredictionInputComponent = NewObject<UEnhancedInputComponent>(this, TEXT("PossessionPredictionInput"));
+		PredictionInputComponent->RegisterComponent();
+	}
+	PredictionInputComponent->ClearActionEventBindings();
+	if (Context)
+	{
+		for (const FEnhancedActionKeyMapping& Mapping : Context->GetMappings())
+		{
+			if (const UInputAction* Action = Mapping.Action)
+			{
+				PredictionInputComponent->BindActionValueLambda(Action, ETriggerEvent::Triggered, [this, Action](const FInputActionValue& Value)
+				{
+					BufferInput(Action, Value);
+				});
+			}
+		}
+	}
+	PushInputComponent(PredictionInputComponent);
+
+	UE_LOG(LogAIDrone, Verbose, TEXT("PlayerController: Predicting possession of %s"), *Pawn->GetName());
+	return true;
+}
+
+void AAIDronePlayerController::BufferInput(const UInputAction* Action, const FInputActionValue& Value)
+{
+	// Rotations add up exactly; movement input is clamped to one frame's worth by the movement component anyway
+	for (TPair<const UInputAction*, FInputActionValue>& Buffered : BufferedInput)
+	{
+		if (Buffered.Key == Action)
+		{
+			Buffered.Value += Value;
+			return;
+		}
+	}
+	BufferedInput.Emplace(Action, Value);
+}
+
+void AAIDronePlayerController::EndPossessionPrediction()
+{
+	if (PredictionInputComponent)
+	{
+		PopInputComponent(PredictionInputComponent);
+		PredictionInputComponent->ClearActionEventBindings();
+	}
+
+	// Null rather than this, because after a confirmed swap the old pawn no longer has us as its controller
+	if (APawn* FromPawn = PredictedFromPawn.Get())
+	{
+		FromPawn->EnableInput(nullptr);
+	}
+
+	PredictedPawn.Reset();
+	PredictedFromPawn.Reset();
+}
+
+void AAIDronePlayerController::RollBackPossession(const TCHAR* Reason)
+{
+	APawn* FromPawn = PredictedFromPawn.Get();
+	const double ElapsedMs = (FPlatformTime::Seconds() - PredictionStartTime) * 1000.0;
+	UE_LOG(LogAIDrone, Log, TEXT("PlayerController: Rolled back predicted possession of %s after %.0f ms: %s"),
+		*GetNameSafe(PredictedPawn.Get()), ElapsedMs, Reason);
+
+	EndPossessionPrediction();
+	BufferedInput.Reset();
+	++NumRolledBackSwaps;
+
+	if (FromPawn && FromPawn == GetPawn())
+	{
+		SetViewTarget(FromPawn);
+		ActivateInputContext(GetInputContextFor(FromPawn));
+	}
+}
+
+void AAIDronePlayerController::ClientRejectPossession_Implementation(APawn* Pawn)
+{
+	if (PredictedPawn.IsValid() && (!Pawn || Pawn == PredictedPawn.Get()))
+	{
+		RollBackPossession(TEXT("rejected by the server"));
+	}
+}
+
+void AAIDronePlayerController::AcknowledgePossession(APawn* P)
+{
+	Super::AcknowledgePossession(P);
+
+	if (!IsLocalController())
+	{
+		return;
+	}
+
+	// Remote clients never run OnPossess, so the previous pawn for the swap back is tracked here
+	if (GetLocalRole() < ROLE_Authority && AcknowledgedPawn.IsValid() && AcknowledgedPawn.Get() != P)
+	{
+		PreviousPawn = AcknowledgedPawn.Get();
+	}
+	AcknowledgedPawn = P;
+
+	if (PredictedPawn.IsValid())
+	{
+		if (P == PredictedPawn.Get())
+		{
+			LastSwapLatencyMs = (FPlatformTime::Seconds() - PredictionStartTime) * 1000.0;
+			TotalSwapLatencyMs += LastSwapLatencyMs;
+			MaxSwapLatencyMs = FMath::Max(MaxSwapLatencyMs, LastSwapLatencyMs);
+			++NumConfirmedSwaps;
+			CSV_CUSTOM_STAT(Drones, PossessSwapLatencyMs, (float)LastSwapLatencyMs, ECsvCustomStatOp::Set);
+			UE_LOG(LogAIDrone, Verbose, TEXT("PlayerController: Server confirmed possession of %s after %.0f ms"), *P->GetName(), LastSwapLatencyMs);
+
+			EndPossessionPrediction();
+			bReplayBufferedInput = BufferedInput.Num() > 0;
+		}
+		else
+		{
+			RollBackPossession(TEXT("the server possessed another pawn"));
+		}
+	}
+
+	ActivateInputContext(GetInputContextFor(P));
+}
+
+void AAIDronePlayerController::PlayerTick(float DeltaTime)
+{
+	Super::PlayerTick(DeltaTime);
+
+	if (PredictedPawn.IsValid())
+	{
+		if (FPlatformTime::Seconds() - PredictionStartTime > CVarDronePossessTimeout.GetValueOnGameThread())
+		{
+			RollBackPossession(TEXT("timed out"));
+		}
+	}
+	else if (PredictedFromPawn.IsValid())
+	{
+		RollBackPossession(TEXT("the pawn was destroyed"));
+	}
+
+	// Replayed a tick after the possession so the new pawn's input component is on the stack by then
+	if (bReplayBufferedInput)
+	{
+		bReplayBufferedInput = false;
+		if (UEnhancedInputLocalPlayerSubsystem* Subsystem = GetInputSubsystem())
+		{
+			for (const TPair<const UInputAction*, FInputActionValue>& Buffered : BufferedInput)
+			{
+				Subsystem->InjectInputForAction(Buffered.Key, Buffered.Value);
+			}
+		}
+		BufferedInput.Reset();
+	}
+}
+
+void AAIDronePlayerController::LogSwapStats() const
+{
+	UE_LOG(LogAIDrone, Display, TEXT("%s: %d predicted swaps confirmed (last %.0f ms, average %.0f ms, worst %.0f ms), %d rolled back"),
+		*GetName(), NumConfirmedSwaps, LastSwapLatencyMs, NumConfirmedSwaps > 0 ? TotalSwapLatencyMs / NumConfirmedSwaps : 0.0,
+		MaxSwapLatencyMs, NumRolledBackSwaps);
+}
+
+void AAIDronePlayerController::RefillMoveTokens()
+{
+	const double Now = GetWorld()->GetRealTimeSeconds();
+	const float Burst = FMath::Max(CVarDroneServerMoveBurst.GetValueOnGameThread(), 1.0f);
+	if (MoveTokens < 0.0f)
+	{
+		MoveTokens = Burst;
+	}
+	else
+	{
+		MoveTokens = FMath::Min(MoveTokens + (float)(Now - MoveTokensRefillTime) * CVarDroneServerMoveRateLimit.GetValueOnGameThread(), Burst);
+	}
+	MoveTokensRefillTime = Now;
+}
+
+bool AAIDronePlayerController::TryConsumeMoveToken()
+{
+	if (CVarDroneServerMoveRateLimit.GetValueOnGameThread() <= 0.0f)
+	{
+		return true;
+	}
+
+	RefillMoveTokens();
+	if (MoveTokens >= 1.0f)
+	{
+		MoveTokens -= 1.0f;
+		return true;
+	}
+	return false;
+}
+
+EDroneMoveAdmission AAIDronePlayerController::AdmitServerMove()
+{
+	// A flooding client costs one counter increment per move, however many it sends
+	const int32 FloodLimit = CVarDroneServerMoveFloodLimit.GetValueOnGameThread();
+	if (FloodLimit > 0)
+	{
+		const double Now = GetWorld()->GetRealTimeSeconds();
+		if (Now - MoveWindowStartTime >= 1.0)
+		{
+			MoveWindowStartTime = Now;
+			NumMovesInWindow = 0;
+		}
+
+		if (++NumMovesInWindow > FloodLimit)
+		{
+			if (!bFloodReported)
+			{
+				bFloodReported = true;
+				UE_LOG(LogAIDrone, Warning, TEXT("%s sent more than %d ServerMoves in a second; dropping the excess"), *GetName(), FloodLimit);
+			}
+			++NumDroppedMoves;
+			DRONE_COUNTER_ADD(ServerMovesDropped, 1);
+			return EDroneMoveAdmission::Drop;
+		}
+	}
+
+	if (TryConsumeMoveToken())
+	{
+		return EDroneMoveAdmission::Process;
 	}
+
+	++NumMergedMoves;
+	DRONE_COUNTER_ADD(ServerMovesMerged, 1);
+	return EDroneMoveAdmission::Merge;
 }
\ No newline at end of file
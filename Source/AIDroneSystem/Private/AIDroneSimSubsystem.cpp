@@ -0,0 +1,255 @@
+﻿#include "AIDroneSimSubsystem.h"
+#include "AIDrone.h"
+#include "AIDroneFleetProxy.h"
+#include "AIDroneFleetSubsystem.h"
+#include "AIDroneHeadless.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Hash/CityHash.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+
+namespace AIDroneSim
+{
+	template<typename T>
+	void HashValue(uint64& Hash, const T& Value)
+	{
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&Value), sizeof(T), Hash);
+	}
+}
+
+bool UAIDroneSimSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Param(FCommandLine::Get(), TEXT("DroneSim"));
+}
+
+bool UAIDroneSimSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UAIDroneSimSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAIDroneSimSubsystem, STATGROUP_Tickables);
+}
+
+void UAIDroneSimSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	int32 Seed = 1;
+	float Step = 1.0f / 60.0f;
+	int32 Substeps = 1;
+	int32 NumDrones = 100;
+	int32 NumTargets = 4;
+	float Seconds = 600.0f;
+	float Commands = 2.0f;
+	float Checksums = 60.0f;
+	FParse::Value(CommandLine, TEXT("DroneSimSeed="), Seed);
+	FParse::Value(CommandLine, TEXT("DroneSimStep="), Step);
+	FParse::Value(CommandLine, TEXT("DroneSimSubsteps="), Substeps);
+	FParse::Value(CommandLine, TEXT("DroneSimDrones="), NumDrones);
+	FParse::Value(CommandLine, TEXT("DroneSimTargets="), NumTargets);
+	FParse::Value(CommandLine, TEXT("DroneSimSeconds="), Seconds);
+	FParse::Value(CommandLine, TEXT("DroneSimCommandInterval="), Commands);
+	FParse::Value(CommandLine, TEXT("DroneSimChecksumInterval="), Checksums);
+	Step = FMath::Max(Step, 0.001f);
+	Substeps = FMath::Max(Substeps, 1);
+
+	// Every frame advances the same amount of game time however long it took, and the engine stops
+	// waiting for real time to catch up, so the simulation runs as fast as the CPU allows
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(Step);
+
+	// Drones step on their own accumulator, so the fleet stays in whole steps even if the engine timestep is overridden
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Sim.FixedStep"), FString::SanitizeFloat(Step / Substeps));
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Sim.MaxSubsteps"), FString::FromInt(Substeps));
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Nav.SynchronousQueries"), TEXT("1"));
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Nav.BuildBudgetMs"), TEXT("0"));
+
+	// A worker solves avoidance in single precision, and only when it answers in time, so the checksum would
+	// depend on whether one is running and how busy it is
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Worker.Enable"), TEXT("0"));
+
+	Random.Initialize(Seed);
+	Duration = Seconds;
+	CommandInterval = FMath::Max(Commands, Step);
+	NextCommandTime = CommandInterval;
+	ChecksumInterval = Checksums;
+	NextChecksumTime = ChecksumInterval > 0.0 ? ChecksumInterval : TNumericLimits<double>::Max();
+
+	SpawnFleet(InWorld, NumDrones, NumTargets);
+
+	FString RecordPath;
+	if (FParse::Value(CommandLine, TEXT("DroneSimRecord="), RecordPath) || FParse::Param(CommandLine, TEXT("DroneSimRecord")))
+	{
+		if (UAIDroneFleetSubsystem* FleetSubsystem = InWorld.GetSubsystem<UAIDroneFleetSubsystem>())
+		{
+			FleetSubsystem->StartFlightRecording(RecordPath.IsEmpty() ? FDroneFlightRecorder::GetDefaultPath(UWorld::RemovePIEPrefix(InWorld.GetMapName())) : RecordPath);
+		}
+	}
+
+	UE_LOG(LogAIDrone, Display, TEXT("Drone sim: seed %d, %d drones, %d targets, %.0f s in %.4f s steps with %d substeps"),
+		Seed, NumDrones, NumTargets, Seconds, Step, Substeps);
+
+	bRunning = true;
+	WallStartTime = FPlatformTime::Seconds();
+}
+
+void UAIDroneSimSubsystem::SpawnFleet(UWorld& InWorld, int32 NumDrones, int32 NumTargets)
+{
+	Area = AIDroneHeadless::GetFlightArea(InWorld);
+	UClass* DroneClass = AIDroneHeadless::LoadDroneClass(TEXT("DroneSimDroneClass="));
+
+	for (int32 Index = 0; Index < NumTargets; ++Index)
+	{
+		if (ACharacter* Target = AIDroneHeadless::SpawnTarget(InWorld, Random.RandPointInBox(Area)))
+		{
+			Targets.Add(Target);
+			TargetGoals.Add(Random.RandPointInBox(Area));
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	for (int32 Index = 0; Index < NumDrones; ++Index)
+	{
+		InWorld.SpawnActor<AAIDrone>(DroneClass, Random.RandPointInBox(Area), FRotator(0.0f, Random.FRandRange(-180.0f, 180.0f), 0.0f), SpawnParams);
+	}
+}
+
+void UAIDroneSimSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!bRunning)
+	{
+		return;
+	}
+
+	SimTime += DeltaTime;
+	++NumFrames;
+
+	MoveTargets(DeltaTime);
+	while (SimTime >= NextCommandTime)
+	{
+		IssueCommand();
+		NextCommandTime += CommandInterval;
+	}
+
+	// Periodic checksums show when two runs that should match first diverged
+	if (SimTime >= NextChecksumTime)
+	{
+		UE_LOG(LogAIDrone, Display, TEXT("Drone sim: %.1f s checksum %016llx"), SimTime, ComputeChecksum());
+		NextChecksumTime += ChecksumInterval;
+	}
+
+	if (SimTime >= Duration)
+	{
+		Finish();
+	}
+}
+
+void UAIDroneSimSubsystem::MoveTargets(float DeltaTime)
+{
+	// Targets walk between random waypoints; only they and the commands come from the random stream
+	const float TargetSpeed = 400.0f;
+	for (int32 Index = 0; Index < Targets.Num(); ++Index)
+	{
+		ACharacter* Target = Targets[Index];
+		if (!IsValid(Target))
+		{
+			continue;
+		}
+
+		const FVector Location = Target->GetActorLocation();
+		const FVector ToGoal = TargetGoals[Index] - Location;
+		const float Step = TargetSpeed * DeltaTime;
+		if (ToGoal.SizeSquared() <= FMath::Square(Step))
+		{
+			Target->SetActorLocation(TargetGoals[Index]);
+			TargetGoals[Index] = Random.RandPointInBox(Area);
+		}
+		else
+		{
+			Target->SetActorLocation(Location + ToGoal.GetSafeNormal() * Step);
+		}
+	}
+}
+
+void UAIDroneSimSubsystem::IssueCommand()
+{
+	const UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+	if (!FleetSubsystem || FleetSubsystem->GetDrones().Num() == 0 || Targets.Num() == 0)
+	{
+		return;
+	}
+
+	// Draw both numbers every time so the stream stays in step whatever the command turns out to be
+	AAIDrone* Drone = FleetSubsystem->GetDrones()[Random.RandHelper(FleetSubsystem->GetDrones().Num())];
+	ACharacter* Target = Targets[Random.RandHelper(Targets.Num())];
+
+	if (Drone->CurrentState == EDroneState::Idle && IsValid(Target))
+	{
+		Drone->FollowTarget = Target;
+		Drone->SetDroneState(EDroneState::Following);
+	}
+	else if (Drone->CurrentState == EDroneState::Following)
+	{
+		Drone->FollowTarget = nullptr;
+		Drone->SetDroneState(EDroneState::Idle);
+	}
+}
+
+uint64 UAIDroneSimSubsystem::ComputeChecksum() const
+{
+	uint64 Hash = 0;
+	const UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+	if (!FleetSubsystem)
+	{
+		return Hash;
+	}
+
+	for (const AAIDrone* Drone : FleetSubsystem->GetDrones())
+	{
+		AIDroneSim::HashValue(Hash, Drone->GetActorLocation());
+		AIDroneSim::HashValue(Hash, Drone->GetVelocity());
+		AIDroneSim::HashValue(Hash, Drone->CurrentState);
+	}
+
+	for (const AAIDroneFleetProxy* Proxy : FleetSubsystem->GetProxies())
+	{
+		for (const FDroneFleetRecord& Record : Proxy->GetRecords())
+		{
+			AIDroneSim::HashValue(Hash, Record.RecordId);
+			AIDroneSim::HashValue(Hash, FVector(Record.Location));
+		}
+	}
+
+	return Hash;
+}
+
+void UAIDroneSimSubsystem::Finish()
+{
+	bRunning = false;
+
+	const double WallSeconds = FPlatformTime::Seconds() - WallStartTime;
+	UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+	UE_LOG(LogAIDrone, Display, TEXT("Drone sim finished: %.1f s simulated in %.1f s (%.1fx real time, %lld frames), %d drones awake, checksum %016llx"),
+		SimTime, WallSeconds, WallSeconds > 0.0 ? SimTime / WallSeconds : 0.0, NumFrames,
+		FleetSubsystem ? FleetSubsystem->GetDrones().Num() : 0, ComputeChecksum());
+
+	if (FleetSubsystem)
+	{
+		FleetSubsystem->StopFlightRecording();
+	}
+
+	FPlatformMisc::RequestExit(false, TEXT("UAIDroneSimSubsystem::Finish"));
+}
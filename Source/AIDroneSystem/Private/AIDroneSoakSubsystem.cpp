@@ -0,0 +1,426 @@
+﻿#include "AIDroneSoakSubsystem.h"
+#include "AIDrone.h"
+#include "AIDroneFleetSnapshot.h"
+#include "AIDroneFleetSubsystem.h"
+#include "AIDroneHeadless.h"
+#include "AIDronePlayerController.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Character.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectArray.h"
+
+namespace AIDroneSoak
+{
+	double ToMegabytes(uint64 Bytes)
+	{
+		return Bytes / (1024.0 * 1024.0);
+	}
+}
+
+bool UAIDroneSoakSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Param(FCommandLine::Get(), TEXT("DroneSoak"));
+}
+
+bool UAIDroneSoakSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UAIDroneSoakSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAIDroneSoakSubsystem, STATGROUP_Tickables);
+}
+
+void UAIDroneSoakSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	int32 Seed = 1;
+	int32 NumDrones = 200;
+	NumIterations = 5000;
+	Churn = 4;
+	GCInterval = 100;
+	TargetInterval = 10;
+	MaxObjectGrowth = 200;
+	MaxPauseGrowth = 1.5f;
+	FParse::Value(CommandLine, TEXT("DroneSoakSeed="), Seed);
+	FParse::Value(CommandLine, TEXT("DroneSoakDrones="), NumDrones);
+	FParse::Value(CommandLine, TEXT("DroneSoakIterations="), NumIterations);
+	FParse::Value(CommandLine, TEXT("DroneSoakChurn="), Churn);
+	FParse::Value(CommandLine, TEXT("DroneSoakGCInterval="), GCInterval);
+	FParse::Value(CommandLine, TEXT("DroneSoakTargetInterval="), TargetInterval);
+	FParse::Value(CommandLine, TEXT("DroneSoakMaxObjectGrowth="), MaxObjectGrowth);
+	FParse::Value(CommandLine, TEXT("DroneSoakMaxPauseGrowth="), MaxPauseGrowth);
+	NumDrones = FMath::Max(NumDrones, 1);
+	GCInterval = FMath::Max(GCInterval, 1);
+
+	// Dormancy would swap actors for records on its own schedule and blur the object counts
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Dormancy.Enable"), TEXT("0"));
+
+	// Every drone updates every frame, so a drone that lost its target has had its chance by the next iteration
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Scheduler.BudgetMs"), TEXT("0"));
+
+	// Restored drones all spawn inside RestoreSnapshot, so the soak can tell them apart from its own
+	AIDroneHeadless::SetConsoleVariable(TEXT("drone.Spawn.BudgetMs"), TEXT("0"));
+
+	Random.Initialize(Seed);
+
+	Area = AIDroneHeadless::GetFlightArea(InWorld);
+	DroneClass = AIDroneHeadless::LoadDroneClass(TEXT("DroneSoakDroneClass="));
+
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		if (ACharacter* Target = AIDroneHeadless::SpawnTarget(InWorld, Random.RandPointInBox(Area)))
+		{
+			Targets.Add(Target);
+		}
+	}
+
+	for (int32 Index = 0; Index < NumDrones; ++Index)
+	{
+		SpawnDrone();
+	}
+
+	// A dedicated server has no player, so the soak brings its own controller to possess drones with
+	PlayerController = InWorld.GetFirstPlayerController();
+	if (!PlayerController)
+	{
+		PlayerController = InWorld.SpawnActor<AAIDronePlayerController>();
+	}
+	HomePawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+
+	PreGCHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &UAIDroneSoakSubsystem::OnPreGarbageCollect);
+	PostGCHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &UAIDroneSoakSubsystem::OnPostGarbageCollect);
+
+	UE_LOG(LogAIDrone, Display, TEXT("Drone soak: seed %d, %d drones, %d iterations, churn %d, full GC every %d iterations, target replaced every %d"),
+		Seed, NumDrones, NumIterations, Churn, GCInterval, TargetInterval);
+
+	bRunning = true;
+	WallStartTime = FPlatformTime::Seconds();
+}
+
+void UAIDroneSoakSubsystem::Deinitialize()
+{
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGCHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGCHandle);
+
+	Super::Deinitialize();
+}
+
+AAIDrone* UAIDroneSoakSubsystem::SpawnDrone()
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AAIDrone* Drone = GetWorld()->SpawnActor<AAIDrone>(DroneClass, Random.RandPointInBox(Area), FRotator(0.0f, Random.FRandRange(-180.0f, 180.0f), 0.0f), SpawnParams);
+	if (Drone)
+	{
+		Drones.Add(Drone);
+	}
+	return Drone;
+}
+
+void UAIDroneSoakSubsystem::ReplaceTarget()
+{
+	// Destroyed while drones follow it, which must send them back to idle rather than leave them following nothing
+	const int32 TargetIndex = Random.RandHelper(Targets.Num());
+	if (IsValid(Targets[TargetIndex]))
+	{
+		Targets[TargetIndex]->Destroy();
+	}
+	Targets.RemoveAtSwap(TargetIndex);
+
+	if (ACharacter* Target = AIDroneHeadless::SpawnTarget(*GetWorld(), Random.RandPointInBox(Area)))
+	{
+		Targets.Add(Target);
+	}
+}
+
+void UAIDroneSoakSubsystem::RestoreFollowers()
+{
+	UAIDroneFleetSubsystem* FleetSubsystem = GetWorld()->GetSubsystem<UAIDroneFleetSubsystem>();
+	if (!FleetSubsystem)
+	{
+		return;
+	}
+
+	// As after a server restart: drones following a player who has not rejoined, and in this soak never will
+	const TArray<FString> Strings = { DroneClass->GetPathName(), TEXT("DroneSoakAbsentPlayer") };
+	TArray<FDroneSnapshotDrone> SavedDrones;
+	for (int32 Index = 0; Index < 8; ++Index)
+	{
+		FDroneSnapshotDrone& Saved = SavedDrones.AddDefaulted_GetRef();
+		Saved.Location = FVector3f(Random.RandPointInBox(Area));
+		Saved.ClassIndex = 0;
+		Saved.FollowPlayerIndex = 1;
+		Saved.State = (uint8)EDroneState::Following;
+	}
+
+	TArray64<uint8> Data;
+	FDroneFleetSnapshot::Build(GetWorld()->GetTimeSeconds(), Strings, SavedDrones, {}, Data);
+	const FString Path = FPaths::ProjectSavedDir() / TEXT("DroneSoak") / TEXT("RestoredFollowers.dfs");
+	if (!FDroneFleetSnapshot::SaveAsync(Path, MoveTemp(Data)).Get())
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Drone soak: could not write '%s'"), *Path);
+		NumDroppedRestoredFollowers += SavedDrones.Num();
+		return;
+	}
+
+	const TSet<AAIDrone*> Existing(FleetSubsystem->GetDrones());
+	FleetSubsystem->RestoreSnapshot(Path);
+	for (AAIDrone* Drone : FleetSubsystem->GetDrones())
+	{
+		if (!Existing.Contains(Drone))
+		{
+			RestoredFollowers.Add(Drone);
+		}
+	}
+
+	if (RestoredFollowers.Num() != SavedDrones.Num())
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Drone soak: restored %d of %d following drones"), RestoredFollowers.Num(), SavedDrones.Num());
+		NumDroppedRestoredFollowers += SavedDrones.Num() - RestoredFollowers.Num();
+	}
+}
+
+void UAIDroneSoakSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!bRunning)
+	{
+		return;
+	}
+
+	RunIteration();
+	++Iteration;
+
+	if (Iteration % GCInterval == 0)
+	{
+		TakeSample();
+	}
+
+	if (Iteration >= NumIterations)
+	{
+		Finish();
+	}
+}
+
+void UAIDroneSoakSubsystem::RunIteration()
+{
+	// The fleet has updated every drone once since the last iteration
+	for (const AAIDrone* Drone : Drones)
+	{
+		if (IsValid(Drone) && Drone->CurrentState == EDroneState::Following && !IsValid(Drone->FollowTarget))
+		{
+			++NumOrphanedFollowers;
+		}
+	}
+
+	for (int32 Index = RestoredFollowers.Num() - 1; Index >= 0; --Index)
+	{
+		const AAIDrone* Drone = RestoredFollowers[Index];
+		if (!IsValid(Drone) || Drone->CurrentState != EDroneState::Following)
+		{
+			++NumDroppedRestoredFollowers;
+			RestoredFollowers.RemoveAtSwap(Index);
+		}
+	}
+
+	if (Iteration == 0)
+	{
+		RestoreFollowers();
+	}
+
+	if (TargetInterval > 0 && Iteration % TargetInterval == 0 && Targets.Num() > 0)
+	{
+		ReplaceTarget();
+	}
+
+	// Spawn and destroy; the drone a player is in stays so the possession swap below always has something to undo
+	for (int32 Index = 0; Index < Churn && Drones.Num() > 0; ++Index)
+	{
+		const int32 DroneIndex = Random.RandHelper(Drones.Num());
+		if (Drones[DroneIndex] != PossessedDrone)
+		{
+			if (IsValid(Drones[DroneIndex]))
+			{
+				Drones[DroneIndex]->Destroy();
+			}
+			Drones.RemoveAtSwap(DroneIndex);
+			SpawnDrone();
+		}
+	}
+
+	// Follow and unfollow
+	for (int32 Index = 0; Index < Churn && Drones.Num() > 0 && Targets.Num() > 0; ++Index)
+	{
+		AAIDrone* Drone = Drones[Random.RandHelper(Drones.Num())];
+		ACharacter* Target = Targets[Random.RandHelper(Targets.Num())];
+		if (Drone->CurrentState == EDroneState::Idle)
+		{
+			Drone->FollowTarget = Target;
+			Drone->SetDroneState(EDroneState::Following);
+		}
+		else if (Drone->CurrentState == EDroneState::Following)
+		{
+			Drone->FollowTarget = nullptr;
+			Drone->SetDroneState(EDroneState::Idle);
+		}
+	}
+
+	// Possess a drone on one iteration and go back to the home pawn on the next
+	if (!PlayerController)
+	{
+		return;
+	}
+
+	if (PossessedDrone)
+	{
+		if (IsValid(HomePawn))
+		{
+			PlayerController->Possess(HomePawn);
+		}
+		else
+		{
+			PlayerController->UnPossess();
+		}
+		PossessedDrone = nullptr;
+	}
+	else if (Drones.Num() > 0)
+	{
+		PossessedDrone = Drones[Random.RandHelper(Drones.Num())];
+		PlayerController->Possess(PossessedDrone);
+	}
+}
+
+void UAIDroneSoakSubsystem::TakeSample()
+{
+	FSample& Sample = Samples.AddDefaulted_GetRef();
+	Sample.Iteration = Iteration;
+
+	// Full purge, so the counts afterwards only hold objects something still references
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	bForcingGC = true;
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS, true);
+	bForcingGC = false;
+	Sample.GCPauseMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+
+	Sample.NumObjects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	for (FActorIterator It(GetWorld()); It; ++It)
+	{
+		++Sample.NumActors;
+		Sample.NumControllers += It->IsA<AController>() ? 1 : 0;
+	}
+
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+	Sample.UsedPhysical = MemoryStats.UsedPhysical;
+	Sample.PeakUsedPhysical = MemoryStats.PeakUsedPhysical;
+
+	UE_LOG(LogAIDrone, Display, TEXT("Drone soak: iteration %d, %d objects, %d actors, %d controllers, GC %.2f ms, %.1f MB used (peak %.1f MB)"),
+		Sample.Iteration, Sample.NumObjects, Sample.NumActors, Sample.NumControllers, Sample.GCPauseMs,
+		AIDroneSoak::ToMegabytes(Sample.UsedPhysical), AIDroneSoak::ToMegabytes(Sample.PeakUsedPhysical));
+}
+
+void UAIDroneSoakSubsystem::OnPreGarbageCollect()
+{
+	GCStartCycles = FPlatformTime::Cycles64();
+}
+
+void UAIDroneSoakSubsystem::OnPostGarbageCollect()
+{
+	if (!bForcingGC && GCStartCycles != 0)
+	{
+		++NumEngineCollections;
+		WorstEngineGCPauseMs = FMath::Max(WorstEngineGCPauseMs, FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - GCStartCycles));
+	}
+	GCStartCycles = 0;
+}
+
+void UAIDroneSoakSubsystem::Finish()
+{
+	bRunning = false;
+
+	bool bPassed = true;
+	FString Summary;
+
+	// The first sample still holds startup garbage and first-use allocations, so it is not the baseline
+	const int32 Baseline = FMath::Min(1, Samples.Num() - 1);
+	if (Baseline >= 0)
+	{
+		const FSample& First = Samples[Baseline];
+		const FSample& Last = Samples.Last();
+
+		const int32 ObjectGrowth = Last.NumObjects - First.NumObjects;
+		const int32 ActorGrowth = Last.NumActors - First.NumActors;
+		Summary += FString::Printf(TEXT("objects %+d, actors %+d, controllers %+d, memory %+.1f MB (peak %.1f MB)"),
+			ObjectGrowth, ActorGrowth, Last.NumControllers - First.NumControllers,
+			AIDroneSoak::ToMegabytes(Last.UsedPhysical) - AIDroneSoak::ToMegabytes(First.UsedPhysical), AIDroneSoak::ToMegabytes(Last.PeakUsedPhysical));
+
+		if (ObjectGrowth > MaxObjectGrowth)
+		{
+			UE_LOG(LogAIDrone, Error, TEXT("Drone soak: %d objects leaked since iteration %d (limit %d)"), ObjectGrowth, First.Iteration, MaxObjectGrowth);
+			bPassed = false;
+		}
+
+		// Compare the first and last quarter of the forced collections; a millisecond of growth is noise
+		const int32 NumCompared = (Samples.Num() - Baseline) / 4;
+		if (NumCompared > 0)
+		{
+			double EarlyMs = 0.0;
+			double LateMs = 0.0;
+			for (int32 Index = 0; Index < NumCompared; ++Index)
+			{
+				EarlyMs += Samples[Baseline + Index].GCPauseMs / NumCompared;
+				LateMs += Samples[Samples.Num() - 1 - Index].GCPauseMs / NumCompared;
+			}
+
+			Summary += FString::Printf(TEXT(", GC %.2f ms early and %.2f ms late"), EarlyMs, LateMs);
+			if (LateMs > EarlyMs * MaxPauseGrowth && LateMs - EarlyMs > 1.0)
+			{
+				UE_LOG(LogAIDrone, Error, TEXT("Drone soak: GC pauses grew from %.2f ms to %.2f ms (limit %.2fx)"), EarlyMs, LateMs, MaxPauseGrowth);
+				bPassed = false;
+			}
+		}
+	}
+
+	Summary += FString::Printf(TEXT(", %d engine collections, worst %.2f ms"), NumEngineCollections, WorstEngineGCPauseMs);
+
+	if (NumOrphanedFollowers > 0)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Drone soak: drones were found following a destroyed target %d times"), NumOrphanedFollowers);
+		bPassed = false;
+	}
+
+	if (NumDroppedRestoredFollowers > 0)
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Drone soak: %d restored drones stopped following before their player rejoined"), NumDroppedRestoredFollowers);
+		bPassed = false;
+	}
+
+	FString Csv = TEXT("Iteration,Objects,Actors,Controllers,GCPauseMs,UsedPhysicalMB,PeakUsedPhysicalMB\n");
+	for (const FSample& Sample : Samples)
+	{
+		Csv += FString::Printf(TEXT("%d,%d,%d,%d,%.3f,%.1f,%.1f\n"), Sample.Iteration, Sample.NumObjects, Sample.NumActors, Sample.NumControllers,
+			Sample.GCPauseMs, AIDroneSoak::ToMegabytes(Sample.UsedPhysical), AIDroneSoak::ToMegabytes(Sample.PeakUsedPhysical));
+	}
+	const FString CsvPath = FPaths::ProjectSavedDir() / TEXT("DroneSoak") / FString::Printf(TEXT("Soak-%s.csv"), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(Csv, *CsvPath);
+
+	UE_LOG(LogAIDrone, Display, TEXT("Drone soak %s: %d iterations in %.1f s; %s. Samples in '%s'"),
+		bPassed ? TEXT("passed") : TEXT("FAILED"), Iteration, FPlatformTime::Seconds() - WallStartTime, *Summary, *CsvPath);
+
+	FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+}
@@ -0,0 +1,139 @@
+﻿#include "AIDroneStats.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+DEFINE_STAT(STAT_DroneTick);
+DEFINE_STAT(STAT_DroneUpdateAI);
+DEFINE_STAT(STAT_DroneHoverPhysics);
+DEFINE_STAT(STAT_DroneObstacleTrace);
+DEFINE_STAT(STAT_DroneServerMove);
+DEFINE_STAT(STAT_DroneVisualFeedback);
+DEFINE_STAT(STAT_DroneSchedule);
+DEFINE_STAT(STAT_DroneAvoidance);
+DEFINE_STAT(STAT_DroneDormancy);
+
+DEFINE_STAT(STAT_DroneDronesIdle);
+DEFINE_STAT(STAT_DroneDronesFollowing);
+DEFINE_STAT(STAT_DroneDronesPossessed);
+DEFINE_STAT(STAT_DroneDronesDormant);
+DEFINE_STAT(STAT_DroneAIUpdates);
+DEFINE_STAT(STAT_DroneDeferredUpdates);
+DEFINE_STAT(STAT_DroneObstacleQueries);
+DEFINE_STAT(STAT_DroneSceneTraces);
+DEFINE_STAT(STAT_DroneServerMoves);
+DEFINE_STAT(STAT_DroneServerMoveCorrections);
+DEFINE_STAT(STAT_DroneServerMovesMerged);
+DEFINE_STAT(STAT_DroneServerMovesDropped);
+DEFINE_STAT(STAT_DroneWorkerResults);
+DEFINE_STAT(STAT_DroneWorkerFallbacks);
+
+UE_TRACE_CHANNEL_DEFINE(DroneChannel);
+
+CSV_DEFINE_CATEGORY_MODULE(AIDRONESYSTEM_API, Drones, true);
+
+TRACE_DECLARE_INT_COUNTER(DroneDronesIdle, TEXT("Drones/Idle"));
+TRACE_DECLARE_INT_COUNTER(DroneDronesFollowing, TEXT("Drones/Following"));
+TRACE_DECLARE_INT_COUNTER(DroneDronesPossessed, TEXT("Drones/Possessed"));
+TRACE_DECLARE_INT_COUNTER(DroneDronesDormant, TEXT("Drones/Dormant"));
+TRACE_DECLARE_INT_COUNTER(DroneAIUpdates, TEXT("Drones/AIUpdates"));
+TRACE_DECLARE_INT_COUNTER(DroneDeferredUpdates, TEXT("Drones/DeferredUpdates"));
+TRACE_DECLARE_INT_COUNTER(DroneObstacleQueries, TEXT("Drones/ObstacleQueries"));
+TRACE_DECLARE_INT_COUNTER(DroneSceneTraces, TEXT("Drones/SceneTraces"));
+TRACE_DECLARE_INT_COUNTER(DroneServerMoves, TEXT("Drones/ServerMoves"));
+TRACE_DECLARE_INT_COUNTER(DroneServerMoveCorrections, TEXT("Drones/ServerMoveCorrections"));
+TRACE_DECLARE_INT_COUNTER(DroneServerMovesMerged, TEXT("Drones/ServerMovesMerged"));
+TRACE_DECLARE_INT_COUNTER(DroneServerMovesDropped, TEXT("Drones/ServerMovesDropped"));
+TRACE_DECLARE_INT_COUNTER(DroneWorkerResults, TEXT("Drones/WorkerResults"));
+TRACE_DECLARE_INT_COUNTER(DroneWorkerFallbacks, TEXT("Drones/WorkerFallbacks"));
+
+FDroneFrameStats FDroneFrameStats::Instance;
+
+namespace AIDroneStats
+{
+	const TCHAR* TimerNames[] = { TEXT("Tick"), TEXT("UpdateAI"), TEXT("HoverPhysics"), TEXT("ObstacleTrace"), TEXT("ServerMove"),
+		TEXT("VisualFeedback"), TEXT("Schedule"), TEXT("Avoidance"), TEXT("Dormancy") };
+	static_assert(UE_ARRAY_COUNT(TimerNames) == (int32)EDroneTimer::Num, "Name every EDroneTimer");
+
+	const TCHAR* CounterNames[] = { TEXT("DronesIdle"), TEXT("DronesFollowing"), TEXT("DronesPossessed"), TEXT("DronesDormant"),
+		TEXT("AIUpdates"), TEXT("DeferredUpdates"), TEXT("ObstacleQueries"), TEXT("SceneTraces"), TEXT("ServerMoves"), TEXT("ServerMoveCorrections"),
+		TEXT("ServerMovesMerged"), TEXT("ServerMovesDropped"), TEXT("WorkerResults"), TEXT("WorkerFallbacks") };
+	static_assert(UE_ARRAY_COUNT(CounterNames) == (int32)EDroneCounter::Num, "Name every EDroneCounter");
+}
+
+static FAutoConsoleCommand DroneStatsDumpCommand(
+	TEXT("drone.Stats.Dump"),
+	TEXT("Logs drone timings and counts for the last frame and averaged over the frames since the previous dump."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FDroneFrameStats::Get().Dump();
+	}));
+
+// Counter stats reset every frame and CSV and trace counters need literal names, so each counter is published by name
+#define PUBLISH_DRONE_COUNTER(Name) \
+	SET_DWORD_STAT(STAT_Drone##Name, (uint32)Last.Counters[(int32)EDroneCounter::Name]); \
+	TRACE_COUNTER_SET(Drone##Name, Last.Counters[(int32)EDroneCounter::Name]); \
+	CSV_CUSTOM_STAT(Drones, Name, (int32)Last.Counters[(int32)EDroneCounter::Name], ECsvCustomStatOp::Set)
+
+void FDroneFrameStats::EndFrame()
+{
+	if (LastEndedFrameNumber == GFrameCounter)
+	{
+		return;
+	}
+	LastEndedFrameNumber = GFrameCounter;
+
+	Last = Current;
+	Current = FFrame();
+
+	for (int32 Index = 0; Index < (int32)EDroneTimer::Num; ++Index)
+	{
+		Total.Cycles[Index] += Last.Cycles[Index];
+		Total.Calls[Index] += Last.Calls[Index];
+	}
+	for (int32 Index = 0; Index < (int32)EDroneCounter::Num; ++Index)
+	{
+		Total.Counters[Index] += Last.Counters[Index];
+	}
+	++NumTotalFrames;
+
+	PUBLISH_DRONE_COUNTER(DronesIdle);
+	PUBLISH_DRONE_COUNTER(DronesFollowing);
+	PUBLISH_DRONE_COUNTER(DronesPossessed);
+	PUBLISH_DRONE_COUNTER(DronesDormant);
+	PUBLISH_DRONE_COUNTER(AIUpdates);
+	PUBLISH_DRONE_COUNTER(DeferredUpdates);
+	PUBLISH_DRONE_COUNTER(ObstacleQueries);
+	PUBLISH_DRONE_COUNTER(SceneTraces);
+	PUBLISH_DRONE_COUNTER(ServerMoves);
+	PUBLISH_DRONE_COUNTER(ServerMoveCorrections);
+	PUBLISH_DRONE_COUNTER(ServerMovesMerged);
+	PUBLISH_DRONE_COUNTER(ServerMovesDropped);
+	PUBLISH_DRONE_COUNTER(WorkerResults);
+	PUBLISH_DRONE_COUNTER(WorkerFallbacks);
+}
+
+#undef PUBLISH_DRONE_COUNTER
+
+void FDroneFrameStats::Dump()
+{
+	const double Frames = (double)FMath::Max<uint64>(NumTotalFrames, 1);
+
+	UE_LOG(LogAIDrone, Display, TEXT("Drone stats: last frame and average over %llu frames"), NumTotalFrames);
+	UE_LOG(LogAIDrone, Display, TEXT("  %-16s %10s %8s %10s %8s"), TEXT("Section"), TEXT("Last ms"), TEXT("Calls"), TEXT("Avg ms"), TEXT("Avg calls"));
+	for (int32 Index = 0; Index < (int32)EDroneTimer::Num; ++Index)
+	{
+		UE_LOG(LogAIDrone, Display, TEXT("  %-16s %10.3f %8llu %10.3f %8.1f"), AIDroneStats::TimerNames[Index],
+			FPlatformTime::ToMilliseconds64(Last.Cycles[Index]), Last.Calls[Index],
+			FPlatformTime::ToMilliseconds64(Total.Cycles[Index]) / Frames, Total.Calls[Index] / Frames);
+	}
+
+	UE_LOG(LogAIDrone, Display, TEXT("  %-22s %8s %10s"), TEXT("Counter"), TEXT("Last"), TEXT("Avg"));
+	for (int32 Index = 0; Index < (int32)EDroneCounter::Num; ++Index)
+	{
+		UE_LOG(LogAIDrone, Display, TEXT("  %-22s %8llu %10.1f"), AIDroneStats::CounterNames[Index], Last.Counters[Index], Total.Counters[Index] / Frames);
+	}
+
+	Total = FFrame();
+	NumTotalFrames = 0;
+}
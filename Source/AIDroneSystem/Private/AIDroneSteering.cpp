@@ -0,0 +1,253 @@
+﻿#include "AIDroneSteering.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "Math/VectorRegister.h"
+
+namespace AIDroneSteering
+{
+	/**
+	 * sin(X) for any X. Reduces to [-pi, pi] with 2 pi split into an exactly representable high part and a
+	 * small low part, so large hover clocks lose no precision, folds into [-pi/2, pi/2] and then evaluates
+	 * the same 11th-degree minimax polynomial as FMath::SinCos.
+	 */
+	FORCEINLINE VectorRegister4Float VectorSinApprox(const VectorRegister4Float& X)
+	{
+		const VectorRegister4Float Quotient = VectorFloor(VectorMultiplyAdd(X, VectorSetFloat1(0.5f * UE_INV_PI), VectorSetFloat1(0.5f)));
+		VectorRegister4Float Y = VectorSubtract(X, VectorMultiply(Quotient, VectorSetFloat1(6.28125f)));
+		Y = VectorSubtract(Y, VectorMultiply(Quotient, VectorSetFloat1(1.9353071795864769e-3f)));
+
+		const VectorRegister4Float HalfPi = VectorSetFloat1(UE_HALF_PI);
+		Y = VectorSelect(VectorCompareGT(Y, HalfPi), VectorSubtract(VectorSetFloat1(UE_PI), Y), Y);
+		Y = VectorSelect(VectorCompareLT(Y, VectorNegate(HalfPi)), VectorSubtract(VectorSetFloat1(-UE_PI), Y), Y);
+
+		const VectorRegister4Float Y2 = VectorMultiply(Y, Y);
+		VectorRegister4Float Poly = VectorSetFloat1(-2.3889859e-08f);
+		Poly = VectorMultiplyAdd(Poly, Y2, VectorSetFloat1(2.7525562e-06f));
+		Poly = VectorMultiplyAdd(Poly, Y2, VectorSetFloat1(-0.00019840874f));
+		Poly = VectorMultiplyAdd(Poly, Y2, VectorSetFloat1(0.0083333310f));
+		Poly = VectorMultiplyAdd(Poly, Y2, VectorSetFloat1(-0.16666667f));
+		Poly = VectorMultiplyAdd(Poly, Y2, VectorOneFloat());
+		return VectorMultiply(Poly, Y);
+	}
+
+	/** atan2(Y, X) in radians: a minimax arctangent on [0, 1] of the smaller over the larger magnitude, then unfolded by octant */
+	FORCEINLINE VectorRegister4Float VectorAtan2Approx(const VectorRegister4Float& Y, const VectorRegister4Float& X)
+	{
+		const VectorRegister4Float AbsX = VectorAbs(X);
+		const VectorRegister4Float AbsY = VectorAbs(Y);
+		const VectorRegister4Float Ratio = VectorDivide(VectorMin(AbsX, AbsY), VectorMax(VectorMax(AbsX, AbsY), VectorSetFloat1(UE_SMALL_NUMBER)));
+		const VectorRegister4Float Ratio2 = VectorMultiply(Ratio, Ratio);
+
+		VectorRegister4Float Poly = VectorSetFloat1(-0.0117212f);
+		Poly = VectorMultiplyAdd(Poly, Ratio2, VectorSetFloat1(0.05265332f));
+		Poly = VectorMultiplyAdd(Poly, Ratio2, VectorSetFloat1(-0.11643287f));
+		Poly = VectorMultiplyAdd(Poly, Ratio2, VectorSetFloat1(0.19354346f));
+		Poly = VectorMultiplyAdd(Poly, Ratio2, VectorSetFloat1(-0.33262347f));
+		Poly = VectorMultiplyAdd(Poly, Ratio2, VectorSetFloat1(0.99997726f));
+		VectorRegister4Float Angle = VectorMultiply(Poly, Ratio);
+
+		const VectorRegister4Float Zero = VectorZeroFloat();
+		Angle = VectorSelect(VectorCompareGT(AbsY, AbsX), VectorSubtract(VectorSetFloat1(UE_HALF_PI), Angle), Angle);
+		Angle = VectorSelect(VectorCompareLT(X, Zero), VectorSubtract(VectorSetFloat1(UE_PI), Angle), Angle);
+		return VectorSelect(VectorCompareLT(Y, Zero), VectorNegate(Angle), Angle);
+	}
+
+	/** Wraps degrees into [-180, 180) */
+	FORCEINLINE VectorRegister4Float VectorNormalizeAxis(const VectorRegister4Float& Degrees)
+	{
+		const VectorRegister4Float Turns = VectorFloor(VectorMultiply(VectorAdd(Degrees, VectorSetFloat1(180.0f)), VectorSetFloat1(1.0f / 360.0f)));
+		return VectorSubtract(Degrees, VectorMultiply(Turns, VectorSetFloat1(360.0f)));
+	}
+
+	float AngleDifference(float A, float B)
+	{
+		return FMath::Abs(FRotator::NormalizeAxis(A - B));
+	}
+}
+
+void FDroneSteeringInput::SetNum(int32 NumDrones)
+{
+	for (TArray<float>* Array : { &PositionX, &PositionY, &PositionZ, &GoalX, &GoalY, &GoalZ, &Yaw, &FollowDistance,
+		&HoverTime, &HoverFrequency, &HoverAmplitude, &MaxSpeed, &DeltaTime })
+	{
+		Array->SetNumZeroed(NumDrones);
+	}
+}
+
+void FDroneSteeringOutput::SetNum(int32 NumDrones)
+{
+	for (TArray<float>* Array : { &DirectionX, &DirectionY, &DirectionZ, &Distance, &Magnitude, &TargetYaw, &NewYaw, &HoverInput })
+	{
+		Array->SetNumUninitialized(NumDrones);
+	}
+}
+
+void FDroneSteering::Solve(const FDroneSteeringInput& In, FDroneSteeringOutput& Out)
+{
+	using namespace AIDroneSteering;
+
+	const int32 NumDrones = In.Num();
+	Out.SetNum(NumDrones);
+
+	const VectorRegister4Float Zero = VectorZeroFloat();
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float SmallNumber = VectorSetFloat1(UE_SMALL_NUMBER);
+	const VectorRegister4Float MinMagnitude = VectorSetFloat1(0.1f);
+	const VectorRegister4Float RadiansToDegrees = VectorSetFloat1(180.0f / UE_PI);
+	const VectorRegister4Float InterpSpeed = VectorSetFloat1(YawInterpSpeed);
+	const VectorRegister4Float YawTolerance = VectorSetFloat1(UE_KINDA_SMALL_NUMBER);
+
+	const int32 NumVectorized = NumDrones & ~3;
+	for (int32 Index = 0; Index < NumVectorized; Index += 4)
+	{
+		// Direction, distance and follow magnitude
+		const VectorRegister4Float ToGoalX = VectorSubtract(VectorLoad(&In.GoalX[Index]), VectorLoad(&In.PositionX[Index]));
+		const VectorRegister4Float ToGoalY = VectorSubtract(VectorLoad(&In.GoalY[Index]), VectorLoad(&In.PositionY[Index]));
+		const VectorRegister4Float ToGoalZ = VectorSubtract(VectorLoad(&In.GoalZ[Index]), VectorLoad(&In.PositionZ[Index]));
+		const VectorRegister4Float LengthSq = VectorMultiplyAdd(ToGoalX, ToGoalX, VectorMultiplyAdd(ToGoalY, ToGoalY, VectorMultiply(ToGoalZ, ToGoalZ)));
+		const VectorRegister4Float Distance = VectorSqrt(LengthSq);
+
+		// Like GetSafeNormal, a drone already at its goal gets no direction
+		const VectorRegister4Float InvLength = VectorSelect(VectorCompareGT(LengthSq, SmallNumber), VectorDivide(One, VectorMax(Distance, SmallNumber)), Zero);
+		const VectorRegister4Float DirectionX = VectorMultiply(ToGoalX, InvLength);
+		const VectorRegister4Float DirectionY = VectorMultiply(ToGoalY, InvLength);
+		const VectorRegister4Float DirectionZ = VectorMultiply(ToGoalZ, InvLength);
+
+		const VectorRegister4Float FollowDistance = VectorLoad(&In.FollowDistance[Index]);
+		const VectorRegister4Float Magnitude = VectorMin(VectorMax(VectorDivide(VectorSubtract(Distance, FollowDistance), FollowDistance), MinMagnitude), One);
+
+		VectorStore(DirectionX, &Out.DirectionX[Index]);
+		VectorStore(DirectionY, &Out.DirectionY[Index]);
+		VectorStore(DirectionZ, &Out.DirectionZ[Index]);
+		VectorStore(Distance, &Out.Distance[Index]);
+		VectorStore(Magnitude, &Out.Magnitude[Index]);
+
+		// Yaw, following FMath::RInterpTo with pitch and roll held at zero
+		const VectorRegister4Float DeltaTime = VectorLoad(&In.DeltaTime[Index]);
+		const VectorRegister4Float CurrentYaw = VectorLoad(&In.Yaw[Index]);
+		const VectorRegister4Float TargetYaw = VectorMultiply(VectorAtan2Approx(DirectionY, DirectionX), RadiansToDegrees);
+		const VectorRegister4Float DeltaYaw = VectorNormalizeAxis(VectorSubtract(TargetYaw, CurrentYaw));
+		const VectorRegister4Float Alpha = VectorMin(VectorMax(VectorMultiply(DeltaTime, InterpSpeed), Zero), One);
+
+		VectorRegister4Float NewYaw = VectorNormalizeAxis(VectorMultiplyAdd(DeltaYaw, Alpha, CurrentYaw));
+		NewYaw = VectorSelect(VectorCompareLE(VectorAbs(DeltaYaw), YawTolerance), TargetYaw, NewYaw);
+		NewYaw = VectorSelect(VectorBitwiseOr(VectorCompareEQ(DeltaTime, Zero), VectorCompareEQ(CurrentYaw, TargetYaw)), CurrentYaw, NewYaw);
+
+		VectorStore(TargetYaw, &Out.TargetYaw[Index]);
+		VectorStore(NewYaw, &Out.NewYaw[Index]);
+
+		// Hover: vertical speed between the bob height now and one step ago, as a share of max speed
+		const VectorRegister4Float HoverTime = VectorLoad(&In.HoverTime[Index]);
+		const VectorRegister4Float Frequency = VectorLoad(&In.HoverFrequency[Index]);
+		const VectorRegister4Float Amplitude = VectorLoad(&In.HoverAmplitude[Index]);
+		const VectorRegister4Float CurrentHeight = VectorMultiply(VectorSinApprox(VectorMultiply(HoverTime, Frequency)), Amplitude);
+		const VectorRegister4Float PreviousHeight = VectorMultiply(VectorSinApprox(VectorMultiply(VectorSubtract(HoverTime, DeltaTime), Frequency)), Amplitude);
+		const VectorRegister4Float HoverVelocity = VectorDivide(VectorSubtract(CurrentHeight, PreviousHeight), DeltaTime);
+
+		VectorStore(VectorDivide(HoverVelocity, VectorLoad(&In.MaxSpeed[Index])), &Out.HoverInput[Index]);
+	}
+
+	SolveScalar(In, Out, NumVectorized);
+}
+
+void FDroneSteering::SolveScalar(const FDroneSteeringInput& In, FDroneSteeringOutput& Out, int32 Begin)
+{
+	const int32 NumDrones = In.Num();
+	Out.SetNum(NumDrones);
+
+	for (int32 Index = Begin; Index < NumDrones; ++Index)
+	{
+		const FVector ToGoal = FVector(In.GoalX[Index], In.GoalY[Index], In.GoalZ[Index]) - FVector(In.PositionX[Index], In.PositionY[Index], In.PositionZ[Index]);
+		const float Distance = (float)ToGoal.Size();
+		const FVector Direction = ToGoal.GetSafeNormal();
+		const float FollowDistance = In.FollowDistance[Index];
+
+		Out.DirectionX[Index] = Direction.X;
+		Out.DirectionY[Index] = Direction.Y;
+		Out.DirectionZ[Index] = Direction.Z;
+		Out.Distance[Index] = Distance;
+		Out.Magnitude[Index] = FMath::Clamp((Distance - FollowDistance) / FollowDistance, 0.1f, 1.0f);
+
+		const float DeltaTime = In.DeltaTime[Index];
+		const float TargetYaw = (float)Direction.Rotation().Yaw;
+		Out.TargetYaw[Index] = TargetYaw;
+		Out.NewYaw[Index] = FMath::RInterpTo(FRotator(0.0f, In.Yaw[Index], 0.0f), FRotator(0.0f, TargetYaw, 0.0f), DeltaTime, YawInterpSpeed).Yaw;
+
+		const float HoverTime = In.HoverTime[Index];
+		const float CurrentHoverHeight = FMath::Sin(HoverTime * In.HoverFrequency[Index]) * In.HoverAmplitude[Index];
+		const float PreviousHoverHeight = FMath::Sin((HoverTime - DeltaTime) * In.HoverFrequency[Index]) * In.HoverAmplitude[Index];
+		Out.HoverInput[Index] = (CurrentHoverHeight - PreviousHoverHeight) / DeltaTime / In.MaxSpeed[Index];
+	}
+}
+
+static FAutoConsoleCommand DroneSteeringBenchmarkCommand(
+	TEXT("drone.Steering.Benchmark"),
+	TEXT("Times the vectorized drone steering kernel against the scalar one and checks they agree. Usage: drone.Steering.Benchmark [NumDrones] [Iterations]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumDrones = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000, 1);
+		const int32 NumIterations = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 200, 1);
+
+		// Fleet-like values: a few kilometres of airspace, the default follow and hover settings give or take, up to ten minutes of hover clock
+		FRandomStream Random(1);
+		FDroneSteeringInput Input;
+		Input.SetNum(NumDrones);
+		for (int32 Index = 0; Index < NumDrones; ++Index)
+		{
+			Input.PositionX[Index] = Random.FRandRange(-5000.0f, 5000.0f);
+			Input.PositionY[Index] = Random.FRandRange(-5000.0f, 5000.0f);
+			Input.PositionZ[Index] = Random.FRandRange(200.0f, 1500.0f);
+			Input.GoalX[Index] = Input.PositionX[Index] + Random.FRandRange(-2000.0f, 2000.0f);
+			Input.GoalY[Index] = Input.PositionY[Index] + Random.FRandRange(-2000.0f, 2000.0f);
+			Input.GoalZ[Index] = Input.PositionZ[Index] + Random.FRandRange(-300.0f, 300.0f);
+			Input.Yaw[Index] = Random.FRandRange(-180.0f, 180.0f);
+			Input.FollowDistance[Index] = Random.FRandRange(100.0f, 400.0f);
+			Input.HoverTime[Index] = Random.FRandRange(0.0f, 600.0f);
+			Input.HoverFrequency[Index] = Random.FRandRange(0.5f, 2.0f);
+			Input.HoverAmplitude[Index] = Random.FRandRange(50.0f, 150.0f);
+			Input.MaxSpeed[Index] = Random.FRandRange(600.0f, 1000.0f);
+			Input.DeltaTime[Index] = Random.FRandRange(1.0f / 120.0f, 0.1f);
+		}
+
+		FDroneSteeringOutput Scalar;
+		FDroneSteeringOutput Vectorized;
+
+		const uint64 ScalarStart = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FDroneSteering::SolveScalar(Input, Scalar);
+		}
+		const double ScalarMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - ScalarStart) / NumIterations;
+
+		const uint64 VectorizedStart = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FDroneSteering::Solve(Input, Vectorized);
+		}
+		const double VectorizedMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - VectorizedStart) / NumIterations;
+
+		float MaxDirectionError = 0.0f;
+		float MaxDistanceError = 0.0f;
+		float MaxMagnitudeError = 0.0f;
+		float MaxYawError = 0.0f;
+		float MaxHoverError = 0.0f;
+		for (int32 Index = 0; Index < NumDrones; ++Index)
+		{
+			MaxDirectionError = FMath::Max3(MaxDirectionError, FMath::Abs(Scalar.DirectionX[Index] - Vectorized.DirectionX[Index]),
+				FMath::Max(FMath::Abs(Scalar.DirectionY[Index] - Vectorized.DirectionY[Index]), FMath::Abs(Scalar.DirectionZ[Index] - Vectorized.DirectionZ[Index])));
+			MaxDistanceError = FMath::Max(MaxDistanceError, FMath::Abs(Scalar.Distance[Index] - Vectorized.Distance[Index]) / FMath::Max(Scalar.Distance[Index], 1.0f));
+			MaxMagnitudeError = FMath::Max(MaxMagnitudeError, FMath::Abs(Scalar.Magnitude[Index] - Vectorized.Magnitude[Index]));
+			MaxYawError = FMath::Max3(MaxYawError, AIDroneSteering::AngleDifference(Scalar.TargetYaw[Index], Vectorized.TargetYaw[Index]),
+				AIDroneSteering::AngleDifference(Scalar.NewYaw[Index], Vectorized.NewYaw[Index]));
+			MaxHoverError = FMath::Max(MaxHoverError, FMath::Abs(Scalar.HoverInput[Index] - Vectorized.HoverInput[Index]));
+		}
+
+		const bool bMatches = MaxDirectionError <= 1.e-4f && MaxDistanceError <= 1.e-5f && MaxMagnitudeError <= 1.e-4f && MaxYawError <= 1.e-2f && MaxHoverError <= 1.e-3f;
+
+		UE_LOG(LogAIDrone, Display, TEXT("Drone steering: %d drones, %d iterations: scalar %.3f ms, vectorized %.3f ms (%.2fx, %.1f ns per drone)"),
+			NumDrones, NumIterations, ScalarMs, VectorizedMs, VectorizedMs > 0.0 ? ScalarMs / VectorizedMs : 0.0, VectorizedMs * 1.0e6 / NumDrones);
+		UE_LOG(LogAIDrone, Display, TEXT("Drone steering %s: max error direction %g, distance %g (relative), magnitude %g, yaw %g deg, hover input %g"),
+			bMatches ? TEXT("matches the scalar kernel") : TEXT("DOES NOT MATCH the scalar kernel"),
+			MaxDirectionError, MaxDistanceError, MaxMagnitudeError, MaxYawError, MaxHoverError);
+	}));
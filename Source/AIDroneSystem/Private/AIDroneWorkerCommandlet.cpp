@@ -0,0 +1,81 @@
+﻿#include "AIDroneWorkerCommandlet.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "AIDroneWorkerPool.h"
+#include "CoreGlobals.h"
+#include "HAL/PlatformProcess.h"
+
+UAIDroneWorkerCommandlet::UAIDroneWorkerCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UAIDroneWorkerCommandlet::Main(const FString& Params)
+{
+	FDroneWorkerPool::FSettings Settings;
+	FParse::Value(*Params, TEXT("Slots="), Settings.NumSlots);
+	FParse::Value(*Params, TEXT("Frames="), Settings.FramesPerSlot);
+	FParse::Value(*Params, TEXT("MaxAgents="), Settings.MaxAgents);
+
+	float Seconds = 0.0f;
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+
+	// Later workers join the pool the first one created
+	const FString PoolName = FDroneWorkerPool::GetDefaultName();
+	FDroneWorkerPool Pool;
+	if (!Pool.Open(PoolName) && !Pool.Create(PoolName, Settings))
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Could not open or create drone worker pool '%s'"), *PoolName);
+		return 1;
+	}
+
+	const FDroneWorkerPoolHeader& Header = Pool.GetHeader();
+	UE_LOG(LogAIDrone, Display, TEXT("Drone worker serving pool '%s': %u slots of %u frames, up to %u drones per frame, %.1f MB"),
+		*PoolName, Header.NumSlots, Header.FramesPerSlot, Header.MaxAgents, Header.TotalSize / (1024.0 * 1024.0));
+
+	const double StartTime = FPlatformTime::Seconds();
+	double ReportTime = StartTime;
+	uint64 NumFrames = 0;
+	uint64 BusyCycles = 0;
+	int32 IdlePolls = 0;
+
+	while (!IsEngineExitRequested() && (Seconds <= 0.0f || FPlatformTime::Seconds() - StartTime < Seconds))
+	{
+		Pool.TouchWorkerHeartbeat();
+
+		const double Now = FPlatformTime::Seconds();
+		if (Now - ReportTime >= 10.0)
+		{
+			UE_LOG(LogAIDrone, Display, TEXT("Drone worker: %llu frames in the last %.0f s, %.3f ms average solve, %.1f%% busy"),
+				NumFrames, Now - ReportTime, NumFrames > 0 ? FPlatformTime::ToMilliseconds64(BusyCycles) / NumFrames : 0.0,
+				FPlatformTime::ToSeconds64(BusyCycles) * 100.0 / (Now - ReportTime));
+			ReportTime = Now;
+			NumFrames = 0;
+			BusyCycles = 0;
+		}
+
+		const uint64 JobStart = FPlatformTime::Cycles64();
+		if (Pool.ProcessNextJob())
+		{
+			BusyCycles += FPlatformTime::Cycles64() - JobStart;
+			++NumFrames;
+			IdlePolls = 0;
+			continue;
+		}
+
+		// Yield while frames are likely to keep coming, then sleep so an idle worker costs nothing
+		if (++IdlePolls < 2000)
+		{
+			FPlatformProcess::Yield();
+		}
+		else
+		{
+			FPlatformProcess::SleepNoStats(0.0005f);
+		}
+	}
+
+	Pool.Close();
+	return 0;
+}
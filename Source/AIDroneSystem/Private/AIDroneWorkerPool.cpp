@@ -0,0 +1,554 @@
+﻿#include "AIDroneWorkerPool.h"
+#include "AIDroneSystem/AIDroneSystem.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/CommandLine.h"
+
+namespace AIDroneWorker
+{
+	/** Slots whose server has not ticked for this long are free for another server to claim */
+	constexpr double SlotTimeoutSeconds = 10.0;
+
+	double SecondsSince(uint64 Cycles)
+	{
+		return FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - FMath::Min(Cycles, FPlatformTime::Cycles64()));
+	}
+
+	FString GetRegionName(const FString& Name)
+	{
+		// POSIX shared memory names start with a slash
+#if PLATFORM_UNIX
+		return TEXT("/") + Name;
+#else
+		return Name;
+#endif
+	}
+}
+
+FDroneWorkerPool::~FDroneWorkerPool()
+{
+	Close();
+}
+
+FString FDroneWorkerPool::GetDefaultName()
+{
+	FString Name = TEXT("AIDroneWorkerPool");
+	FParse::Value(FCommandLine::Get(), TEXT("DroneWorkerPool="), Name);
+	return Name;
+}
+
+bool FDroneWorkerPool::Map(const FString& Name, bool bCreate, SIZE_T Size)
+{
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(AIDroneWorker::GetRegionName(Name), bCreate,
+		(uint32)FPlatformMemory::ESharedMemoryAccess::Read | (uint32)FPlatformMemory::ESharedMemoryAccess::Write, Size);
+	if (!Region)
+	{
+		return false;
+	}
+
+	Base = static_cast<uint8*>(Region->GetAddress());
+	Header = reinterpret_cast<FDroneWorkerPoolHeader*>(Base);
+	return true;
+}
+
+bool FDroneWorkerPool::Create(const FString& Name, const FSettings& Settings)
+{
+	Close();
+
+	const uint32 NumSlots = FMath::Clamp(Settings.NumSlots, 1, 256);
+	const uint32 FramesPerSlot = FMath::Clamp(Settings.FramesPerSlot, 1, 64);
+	const uint32 MaxAgents = FMath::Max(Settings.MaxAgents, 1);
+
+	// Room for every frame to be queued twice, since abandoned frames can leave a stale job behind
+	const uint32 QueueCapacity = FMath::RoundUpToPowerOfTwo(NumSlots * FramesPerSlot * 2);
+
+	const uint64 FrameStride = Align(sizeof(FDroneWorkerFrame) + uint64(MaxAgents) * (sizeof(FDroneWorkerAgent) + sizeof(FVector3f)), 64);
+	const uint64 SlotsOffset = Align(sizeof(FDroneWorkerPoolHeader), 64);
+	const uint64 QueueOffset = Align(SlotsOffset + NumSlots * sizeof(FDroneWorkerSlot), 64);
+	const uint64 FramesOffset = Align(QueueOffset + QueueCapacity * sizeof(FDroneWorkerJob), 64);
+	const uint64 TotalSize = FramesOffset + uint64(NumSlots) * FramesPerSlot * FrameStride;
+
+	if (!Map(Name, true, TotalSize))
+	{
+		UE_LOG(LogAIDrone, Error, TEXT("Could not create drone worker pool '%s' (%llu bytes)"), *Name, TotalSize);
+		return false;
+	}
+
+	// Another worker got there first; share its pool
+	if (Header->Magic.load(std::memory_order_acquire) == FDroneWorkerPoolHeader::ExpectedMagic)
+	{
+		if (Header->Version != FDroneWorkerPoolHeader::CurrentVersion || Header->TotalSize > Region->GetSize())
+		{
+			UE_LOG(LogAIDrone, Error, TEXT("Drone worker pool '%s' already exists with an incompatible layout"), *Name);
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	new (Header) FDroneWorkerPoolHeader();
+	Header->NumSlots = NumSlots;
+	Header->FramesPerSlot = FramesPerSlot;
+	Header->MaxAgents = MaxAgents;
+	Header->QueueCapacity = QueueCapacity;
+	Header->TotalSize = TotalSize;
+	Header->FrameStride = FrameStride;
+	Header->SlotsOffset = SlotsOffset;
+	Header->QueueOffset = QueueOffset;
+	Header->FramesOffset = FramesOffset;
+
+	for (uint32 SlotIndex = 0; SlotIndex < NumSlots; ++SlotIndex)
+	{
+		new (&GetSlot(SlotIndex)) FDroneWorkerSlot();
+		for (uint32 FrameIndex = 0; FrameIndex < FramesPerSlot; ++FrameIndex)
+		{
+			new (&GetFrame(SlotIndex, FrameIndex)) FDroneWorkerFrame();
+		}
+	}
+
+	FDroneWorkerJob* Jobs = reinterpret_cast<FDroneWorkerJob*>(Base + QueueOffset);
+	for (uint32 Index = 0; Index < QueueCapacity; ++Index)
+	{
+		new (&Jobs[Index]) FDroneWorkerJob();
+		Jobs[Index].Sequence.store(Index, std::memory_order_relaxed);
+	}
+
+	Header->Magic.store(FDroneWorkerPoolHeader::ExpectedMagic, std::memory_order_release);
+	return true;
+}
+
+bool FDroneWorkerPool::Open(const FString& Name)
+{
+	Close();
+
+	// Map just the header to learn the size, then map the whole pool
+	if (!Map(Name, false, sizeof(FDroneWorkerPoolHeader)))
+	{
+		return false;
+	}
+
+	const bool bReady = Header->Magic.load(std::memory_order_acquire) == FDroneWorkerPoolHeader::ExpectedMagic
+		&& Header->Version == FDroneWorkerPoolHeader::CurrentVersion;
+	const uint64 TotalSize = Header->TotalSize;
+	Close();
+
+	if (!bReady || !Map(Name, false, TotalSize))
+	{
+		return false;
+	}
+	return true;
+}
+
+void FDroneWorkerPool::Close()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+	}
+	Region = nullptr;
+	Header = nullptr;
+	Base = nullptr;
+}
+
+FDroneWorkerSlot& FDroneWorkerPool::GetSlot(uint32 SlotIndex) const
+{
+	check(SlotIndex < Header->NumSlots);
+	return reinterpret_cast<FDroneWorkerSlot*>(Base + Header->SlotsOffset)[SlotIndex];
+}
+
+FDroneWorkerFrame& FDroneWorkerPool::GetFrame(uint32 SlotIndex, uint32 FrameIndex) const
+{
+	check(SlotIndex < Header->NumSlots && FrameIndex < Header->FramesPerSlot);
+	const uint64 Offset = Header->FramesOffset + (uint64(SlotIndex) * Header->FramesPerSlot + FrameIndex) * Header->FrameStride;
+	return *reinterpret_cast<FDroneWorkerFrame*>(Base + Offset);
+}
+
+FDroneWorkerAgent* FDroneWorkerPool::GetAgents(FDroneWorkerFrame& Frame) const
+{
+	return reinterpret_cast<FDroneWorkerAgent*>(reinterpret_cast<uint8*>(&Frame) + sizeof(FDroneWorkerFrame));
+}
+
+FVector3f* FDroneWorkerPool::GetResults(FDroneWorkerFrame& Frame) const
+{
+	return reinterpret_cast<FVector3f*>(GetAgents(Frame) + Header->MaxAgents);
+}
+
+bool FDroneWorkerPool::Enqueue(uint32 SlotIndex, uint32 FrameIndex)
+{
+	FDroneWorkerJob* Jobs = reinterpret_cast<FDroneWorkerJob*>(Base + Header->QueueOffset);
+	const uint64 Mask = Header->QueueCapacity - 1;
+
+	// A cell is free for position P when its sequence is P and holds a job for P when it is P + 1
+	uint64 Position = Header->EnqueuePosition.load(std::memory_order_relaxed);
+	FDroneWorkerJob* Job = nullptr;
+	for (;;)
+	{
+		Job = &Jobs[Position & Mask];
+		const int64 Difference = int64(Job->Sequence.load(std::memory_order_acquire)) - int64(Position);
+		if (Difference == 0)
+		{
+			if (Header->EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (Difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			Position = Header->EnqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	Job->SlotIndex = SlotIndex;
+	Job->FrameIndex = FrameIndex;
+	Job->Sequence.store(Position + 1, std::memory_order_release);
+	return true;
+}
+
+bool FDroneWorkerPool::Dequeue(uint32& OutSlotIndex, uint32& OutFrameIndex)
+{
+	FDroneWorkerJob* Jobs = reinterpret_cast<FDroneWorkerJob*>(Base + Header->QueueOffset);
+	const uint64 Mask = Header->QueueCapacity - 1;
+
+	uint64 Position = Header->DequeuePosition.load(std::memory_order_relaxed);
+	FDroneWorkerJob* Job = nullptr;
+	for (;;)
+	{
+		Job = &Jobs[Position & Mask];
+		const int64 Difference = int64(Job->Sequence.load(std::memory_order_acquire)) - int64(Position + 1);
+		if (Difference == 0)
+		{
+			if (Header->DequeuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (Difference < 0)
+		{
+			return false;
+		}
+		else
+		{
+			Position = Header->DequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	OutSlotIndex = Job->SlotIndex;
+	OutFrameIndex = Job->FrameIndex;
+	Job->Sequence.store(Position + Mask + 1, std::memory_order_release);
+	return true;
+}
+
+void FDroneWorkerPool::TouchWorkerHeartbeat()
+{
+	Header->WorkerHeartbeatCycles.store(FPlatformTime::Cycles64(), std::memory_order_relaxed);
+}
+
+bool FDroneWorkerPool::IsWorkerAlive(double TimeoutSeconds) const
+{
+	return IsOpen() && AIDroneWorker::SecondsSince(Header->WorkerHeartbeatCycles.load(std::memory_order_relaxed)) < TimeoutSeconds;
+}
+
+bool FDroneWorkerPool::ProcessNextJob()
+{
+	uint32 SlotIndex = 0;
+	uint32 FrameIndex = 0;
+	if (!Dequeue(SlotIndex, FrameIndex))
+	{
+		return false;
+	}
+
+	if (SlotIndex >= Header->NumSlots || FrameIndex >= Header->FramesPerSlot)
+	{
+		return true;
+	}
+
+	// Jobs for frames their server already took back are skipped
+	FDroneWorkerFrame& Frame = GetFrame(SlotIndex, FrameIndex);
+	uint32 Expected = (uint32)EDroneWorkerFrameState::Submitted;
+	if (!Frame.State.compare_exchange_strong(Expected, (uint32)EDroneWorkerFrameState::Working, std::memory_order_acquire))
+	{
+		return true;
+	}
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	const int32 NumAgents = (int32)FMath::Min(Frame.NumAgents, Header->MaxAgents);
+	const FDroneWorkerAgent* Agents = GetAgents(Frame);
+
+	Query.Reset(NumAgents);
+	PreferredVelocities.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	MaxSpeeds.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	Responsive.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	Velocities.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		const FDroneWorkerAgent& Agent = Agents[Index];
+		Query.Positions[Index] = FVector(Agent.Position);
+		Query.Velocities[Index] = FVector(Agent.Velocity);
+		Query.Radii[Index] = Agent.Radius;
+		PreferredVelocities[Index] = FVector(Agent.PreferredVelocity);
+		MaxSpeeds[Index] = Agent.MaxSpeed;
+		Responsive[Index] = Agent.bResponsive != 0;
+	}
+
+	Query.Build(Frame.NeighbourRadius, Frame.MaxNeighbours);
+
+	FDroneAvoidance::FParams Params;
+	Params.TimeHorizon = Frame.TimeHorizon;
+	Params.DeltaTime = Frame.DeltaTime;
+	FDroneAvoidance::Solve(Query, PreferredVelocities, MaxSpeeds, Responsive, Params, Velocities);
+
+	FVector3f* Results = GetResults(Frame);
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		Results[Index] = FVector3f(Velocities[Index]);
+	}
+	Frame.DoneCycles = FPlatformTime::Cycles64();
+	Frame.WorkerCycles = Frame.DoneCycles - StartCycles;
+
+	Expected = (uint32)EDroneWorkerFrameState::Working;
+	if (!Frame.State.compare_exchange_strong(Expected, (uint32)EDroneWorkerFrameState::Done, std::memory_order_release))
+	{
+		// The server gave up on this frame while it was being solved
+		Frame.State.store((uint32)EDroneWorkerFrameState::Free, std::memory_order_release);
+	}
+	return true;
+}
+
+FDroneWorkerClient::~FDroneWorkerClient()
+{
+	Disconnect();
+}
+
+bool FDroneWorkerClient::Connect(const FString& PoolName)
+{
+	Disconnect();
+
+	if (!Pool.Open(PoolName))
+	{
+		return false;
+	}
+
+	const FDroneWorkerPoolHeader& Header = Pool.GetHeader();
+	const uint32 ProcessId = FPlatformProcess::GetCurrentProcessId();
+	for (uint32 Index = 0; Index < Header.NumSlots; ++Index)
+	{
+		FDroneWorkerSlot& Slot = Pool.GetSlot(Index);
+		uint32 Owner = Slot.OwnerProcessId.load(std::memory_order_acquire);
+		const bool bStale = Owner != 0 && AIDroneWorker::SecondsSince(Slot.OwnerHeartbeatCycles.load(std::memory_order_relaxed)) > AIDroneWorker::SlotTimeoutSeconds;
+		if ((Owner != 0 && !bStale) || !Slot.OwnerProcessId.compare_exchange_strong(Owner, ProcessId, std::memory_order_acq_rel))
+		{
+			continue;
+		}
+
+		// Take back whatever the previous owner left in flight
+		Generation = Slot.OwnerGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
+		Slot.OwnerHeartbeatCycles.store(FPlatformTime::Cycles64(), std::memory_order_relaxed);
+		for (uint32 FrameIndex = 0; FrameIndex < Header.FramesPerSlot; ++FrameIndex)
+		{
+			AbandonFrame(Pool.GetFrame(Index, FrameIndex));
+		}
+
+		SlotIndex = Index;
+		NextSubmit = 0;
+		NextCollect = 0;
+		SubmitCycles.SetNumZeroed(Header.FramesPerSlot);
+		UE_LOG(LogAIDrone, Display, TEXT("Drone worker pool '%s': claimed slot %u of %u, up to %u drones per frame"),
+			*PoolName, Index, Header.NumSlots, Header.MaxAgents);
+		return true;
+	}
+
+	UE_LOG(LogAIDrone, Warning, TEXT("Drone worker pool '%s' has no free slot"), *PoolName);
+	Pool.Close();
+	return false;
+}
+
+void FDroneWorkerClient::Disconnect()
+{
+	if (!IsConnected())
+	{
+		Pool.Close();
+		return;
+	}
+
+	// A slot another server reclaimed, frames included, is no longer ours to clean up
+	if (OwnsSlot())
+	{
+		for (uint32 FrameIndex = 0; FrameIndex < Pool.GetHeader().FramesPerSlot; ++FrameIndex)
+		{
+			AbandonFrame(Pool.GetFrame(SlotIndex, FrameIndex));
+		}
+		Pool.GetSlot(SlotIndex).OwnerProcessId.store(0, std::memory_order_release);
+	}
+
+	SlotIndex = INDEX_NONE;
+	NextSubmit = 0;
+	NextCollect = 0;
+	Pool.Close();
+}
+
+bool FDroneWorkerClient::IsWorkerAlive() const
+{
+	return Pool.IsWorkerAlive(WorkerTimeoutSeconds);
+}
+
+bool FDroneWorkerClient::OwnsSlot() const
+{
+	const FDroneWorkerSlot& Slot = Pool.GetSlot(SlotIndex);
+	return Slot.OwnerProcessId.load(std::memory_order_acquire) == FPlatformProcess::GetCurrentProcessId()
+		&& Slot.OwnerGeneration.load(std::memory_order_acquire) == Generation;
+}
+
+bool FDroneWorkerClient::CheckOwnership()
+{
+	if (OwnsSlot())
+	{
+		return true;
+	}
+
+	UE_LOG(LogAIDrone, Warning, TEXT("Drone worker slot %d was taken over by another server; disconnecting"), SlotIndex);
+	Disconnect();
+	return false;
+}
+
+bool FDroneWorkerClient::TouchHeartbeat()
+{
+	if (!IsConnected() || !CheckOwnership())
+	{
+		return false;
+	}
+
+	Pool.GetSlot(SlotIndex).OwnerHeartbeatCycles.store(FPlatformTime::Cycles64(), std::memory_order_relaxed);
+	return true;
+}
+
+void FDroneWorkerClient::AbandonFrame(FDroneWorkerFrame& Frame)
+{
+	// With no worker left nothing can still be writing to the frame
+	if (!IsWorkerAlive())
+	{
+		Frame.State.store((uint32)EDroneWorkerFrameState::Free, std::memory_order_release);
+		return;
+	}
+
+	uint32 State = Frame.State.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const EDroneWorkerFrameState NewState = State == (uint32)EDroneWorkerFrameState::Working ? EDroneWorkerFrameState::Abandoned
+			: State == (uint32)EDroneWorkerFrameState::Abandoned ? EDroneWorkerFrameState::Abandoned
+			: EDroneWorkerFrameState::Free;
+		if (Frame.State.compare_exchange_weak(State, (uint32)NewState, std::memory_order_acq_rel))
+		{
+			return;
+		}
+	}
+}
+
+bool FDroneWorkerClient::Submit(const FDroneNeighbourQuery& Query, TConstArrayView<FVector> PreferredVelocities, TConstArrayView<float> MaxSpeeds,
+	TConstArrayView<bool> Responsive, float NeighbourRadius, int32 MaxNeighbours, const FDroneAvoidance::FParams& Params)
+{
+	if (!IsConnected() || !CheckOwnership() || !IsWorkerAlive())
+	{
+		return false;
+	}
+
+	const FDroneWorkerPoolHeader& Header = Pool.GetHeader();
+	const int32 NumAgents = Query.Num();
+	if (NumAgents > (int32)Header.MaxAgents || NextSubmit - NextCollect >= Header.FramesPerSlot)
+	{
+		return false;
+	}
+
+	const uint32 FrameIndex = uint32(NextSubmit % Header.FramesPerSlot);
+	FDroneWorkerFrame& Frame = Pool.GetFrame(SlotIndex, FrameIndex);
+	if (Frame.State.load(std::memory_order_acquire) != (uint32)EDroneWorkerFrameState::Free)
+	{
+		// Still held by a worker solving a frame we gave up on
+		return false;
+	}
+
+	FDroneWorkerAgent* Agents = Pool.GetAgents(Frame);
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		FDroneWorkerAgent& Agent = Agents[Index];
+		Agent.Position = FVector3f(Query.Positions[Index]);
+		Agent.Velocity = FVector3f(Query.Velocities[Index]);
+		Agent.PreferredVelocity = FVector3f(PreferredVelocities[Index]);
+		Agent.Radius = Query.Radii[Index];
+		Agent.MaxSpeed = MaxSpeeds[Index];
+		Agent.bResponsive = Responsive[Index] ? 1 : 0;
+	}
+	Frame.NumAgents = NumAgents;
+	Frame.NeighbourRadius = NeighbourRadius;
+	Frame.MaxNeighbours = MaxNeighbours;
+	Frame.TimeHorizon = Params.TimeHorizon;
+	Frame.DeltaTime = Params.DeltaTime;
+	Frame.WorkerCycles = 0;
+	Frame.DoneCycles = 0;
+	SubmitCycles[FrameIndex] = FPlatformTime::Cycles64();
+	Frame.State.store((uint32)EDroneWorkerFrameState::Submitted, std::memory_order_release);
+
+	// A worker may already have found the frame through a stale job, in which case it is on its way anyway
+	uint32 Expected = (uint32)EDroneWorkerFrameState::Submitted;
+	if (!Pool.Enqueue(SlotIndex, FrameIndex)
+		&& Frame.State.compare_exchange_strong(Expected, (uint32)EDroneWorkerFrameState::Free, std::memory_order_acq_rel))
+	{
+		return false;
+	}
+
+	++NextSubmit;
+	return true;
+}
+
+bool FDroneWorkerClient::Collect(double WaitSeconds, TArrayView<FVector> OutVelocities)
+{
+	if (!IsConnected() || !HasPendingFrame() || !CheckOwnership())
+	{
+		return false;
+	}
+
+	const uint32 FrameIndex = uint32(NextCollect % Pool.GetHeader().FramesPerSlot);
+	FDroneWorkerFrame& Frame = Pool.GetFrame(SlotIndex, FrameIndex);
+	++NextCollect;
+
+	// Spin rather than sleep: the wait is a fraction of a millisecond when the worker keeps up
+	const double Deadline = FPlatformTime::Seconds() + WaitSeconds;
+	while (Frame.State.load(std::memory_order_acquire) != (uint32)EDroneWorkerFrameState::Done)
+	{
+		if (FPlatformTime::Seconds() >= Deadline)
+		{
+			AbandonFrame(Frame);
+			++Latency.NumTimeouts;
+			return false;
+		}
+		FPlatformProcess::Yield();
+	}
+
+	// The results are only ours if nobody reclaimed the slot while the frame was out
+	if (!CheckOwnership())
+	{
+		return false;
+	}
+
+	bool bValid = (int32)Frame.NumAgents == OutVelocities.Num();
+	if (bValid)
+	{
+		const FVector3f* Results = Pool.GetResults(Frame);
+		for (int32 Index = 0; Index < OutVelocities.Num(); ++Index)
+		{
+			OutVelocities[Index] = FVector(Results[Index]);
+		}
+
+		Latency.LastRoundTripMs = FPlatformTime::ToMilliseconds64(FMath::Max(Frame.DoneCycles, SubmitCycles[FrameIndex]) - SubmitCycles[FrameIndex]);
+		Latency.LastWorkerMs = FPlatformTime::ToMilliseconds64(Frame.WorkerCycles);
+		Latency.MaxRoundTripMs = FMath::Max(Latency.MaxRoundTripMs, Latency.LastRoundTripMs);
+		Latency.TotalRoundTripMs += Latency.LastRoundTripMs;
+		Latency.TotalWorkerMs += Latency.LastWorkerMs;
+		++Latency.NumResults;
+	}
+
+	Frame.State.store((uint32)EDroneWorkerFrameState::Free, std::memory_order_release);
+	return bValid;
+}
@@ -0,0 +1,138 @@
+﻿#include "AIDrone.h"
+#include "AIDroneSystem/AIDroneSystemCharacter.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace AIDroneDormancyTest
+{
+	UWorld* FindClientWorld()
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* World = Context.World();
+			if (World && (Context.WorldType == EWorldType::PIE || Context.WorldType == EWorldType::Game) && World->GetNetMode() == NM_Client)
+			{
+				return World;
+			}
+		}
+		return nullptr;
+	}
+
+	float GetFloat(const TCHAR* Name)
+	{
+		const IConsoleVariable* Variable = IConsoleManager::Get().FindConsoleVariable(Name);
+		return Variable ? Variable->GetFloat() : 0.0f;
+	}
+}
+
+/** Walks the character out of range of its linked drone, waits out the demote delay and checks the link survived */
+class FDroneDormancyLinkLatentCommand : public IAutomationLatentCommand
+{
+public:
+	FDroneDormancyLinkLatentCommand(FAutomationTestBase* InTest, AAIDroneSystemCharacter* InCharacter, AAIDrone* InDrone, float InLeaveRange, double InWaitSeconds)
+		: Test(InTest)
+		, Character(InCharacter)
+		, Drone(InDrone)
+		, LeaveRange(InLeaveRange)
+		, WaitSeconds(InWaitSeconds)
+	{
+	}
+
+	virtual bool Update() override
+	{
+		AAIDroneSystemCharacter* TestCharacter = Character.Get();
+		AAIDrone* TestDrone = Drone.Get();
+		if (!TestCharacter || !TestDrone)
+		{
+			// A demoted drone is destroyed on the server, which replicates here as a destroyed actor
+			Test->AddError(TEXT("The linked drone or the character went away before the demote delay passed"));
+			return true;
+		}
+
+		const double Elapsed = GetCurrentRunTime();
+		if (!LeftRangeTime.IsSet())
+		{
+			if (FVector::Dist(TestCharacter->GetActorLocation(), TestDrone->GetActorLocation()) > LeaveRange)
+			{
+				LeftRangeTime = Elapsed;
+			}
+			else if (Elapsed > 30.0)
+			{
+				Test->AddError(FString::Printf(TEXT("Could not walk %.0f cm away from the drone within 30 seconds"), LeaveRange));
+				return true;
+			}
+			else
+			{
+				const FVector Away = (TestCharacter->GetActorLocation() - TestDrone->GetActorLocation()).GetSafeNormal2D();
+				TestCharacter->AddMovementInput(Away.IsNearlyZero() ? TestCharacter->GetActorForwardVector() : Away, 1.0f);
+			}
+			return false;
+		}
+
+		if (Elapsed - LeftRangeTime.GetValue() <= WaitSeconds)
+		{
+			return false;
+		}
+
+		Test->TestTrue(TEXT("Drone is still alive after the demote delay"), IsValid(TestDrone));
+		Test->TestTrue(TEXT("Character is still linked to the drone"), TestCharacter->AIDrone == TestDrone);
+		return true;
+	}
+
+private:
+	FAutomationTestBase* Test;
+	TWeakObjectPtr<AAIDroneSystemCharacter> Character;
+	TWeakObjectPtr<AAIDrone> Drone;
+	float LeaveRange;
+	double WaitSeconds;
+	TOptional<double> LeftRangeTime;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDroneDormancyLinkTest, "AIDroneSystem.Dormancy.LinkedDroneStaysAwake",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FDroneDormancyLinkTest::RunTest(const FString& Parameters)
+{
+	// Needs a client next to an idle drone, e.g. PIE with Net Mode "Play As Client"; the dormancy CVars must match the server's
+	UWorld* World = AIDroneDormancyTest::FindClientWorld();
+	APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+	AAIDroneSystemCharacter* Character = PC ? Cast<AAIDroneSystemCharacter>(PC->GetPawn()) : nullptr;
+	if (!Character)
+	{
+		AddError(TEXT("Needs a remote client controlling a character, e.g. a PIE session with Net Mode \"Play As Client\""));
+		return false;
+	}
+
+	AAIDrone* Drone = nullptr;
+	double BestDist = TNumericLimits<double>::Max();
+	for (TActorIterator<AAIDrone> It(World); It; ++It)
+	{
+		const double Dist = FVector::Dist(It->GetActorLocation(), Character->GetActorLocation());
+		if (It->CurrentState == EDroneState::Idle && Dist <= It->CommandRange && Dist < BestDist)
+		{
+			Drone = *It;
+			BestDist = Dist;
+		}
+	}
+	if (!Drone)
+	{
+		AddError(TEXT("No idle drone within command range of the character"));
+		return false;
+	}
+
+	Character->ServerSetLinkedDrone(Drone);
+
+	// Walk out of the range that keeps any drone awake, then stay away for longer than the demote delay
+	const float LeaveRange = Drone->CommandRange * FMath::Max(AIDroneDormancyTest::GetFloat(TEXT("drone.Dormancy.DemoteRangeScale")), 1.0f) + 200.0f;
+	const double WaitSeconds = AIDroneDormancyTest::GetFloat(TEXT("drone.Dormancy.DemoteAfterSeconds")) + AIDroneDormancyTest::GetFloat(TEXT("drone.Dormancy.CheckInterval")) + 2.0;
+	ADD_LATENT_AUTOMATION_COMMAND(FDroneDormancyLinkLatentCommand(this, Character, Drone, LeaveRange, WaitSeconds));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
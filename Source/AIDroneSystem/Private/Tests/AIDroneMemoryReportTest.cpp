@@ -0,0 +1,40 @@
+﻿#include "AIDrone.h"
+#include "AIDroneMemoryReport.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDroneMemoryReportTest, "AIDroneSystem.Memory.WithinBudget",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ServerContext | EAutomationTestFlags::ProductFilter)
+
+bool FDroneMemoryReportTest::RunTest(const FString& Parameters)
+{
+	UClass* DroneClass = LoadClass<AAIDrone>(nullptr, TEXT("/Game/BP_AIDrone.BP_AIDrone_C"));
+	if (!TestNotNull(TEXT("BP_AIDrone loads"), DroneClass))
+	{
+		return false;
+	}
+
+	// A game world of its own, so the drones get their AI controllers as they would in play
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	const FDroneMemoryReport Report = FDroneMemoryReport::Measure(*World, DroneClass, 16);
+	Report.Log();
+	TestTrue(TEXT("Measured a non-zero cost per drone"), Report.GetBytesPerDrone() > 0.0);
+	for (const FString& Error : Report.GetBudgetErrors())
+	{
+		AddError(Error);
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,94 @@
+﻿#include "AIDroneNavObstacleComponent.h"
+#include "AIDroneNavSubsystem.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace AIDroneNavObstacleTest
+{
+	/** Nav is only built where drone AI runs: a standalone game or the server of a PIE session */
+	UAIDroneNavSubsystem* FindNavSubsystem()
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* World = Context.World();
+			if (World && (Context.WorldType == EWorldType::PIE || Context.WorldType == EWorldType::Game) && World->GetNetMode() != NM_Client)
+			{
+				if (UAIDroneNavSubsystem* NavSubsystem = World->GetSubsystem<UAIDroneNavSubsystem>())
+				{
+					return NavSubsystem;
+				}
+			}
+		}
+		return nullptr;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDroneNavObstacleTest, "AIDroneSystem.Nav.MovingObstacle",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ServerContext | EAutomationTestFlags::ProductFilter)
+
+bool FDroneNavObstacleTest::RunTest(const FString& Parameters)
+{
+	UAIDroneNavSubsystem* NavSubsystem = AIDroneNavObstacleTest::FindNavSubsystem();
+	if (!NavSubsystem)
+	{
+		AddError(TEXT("Needs a running game or PIE server world"));
+		return false;
+	}
+
+	NavSubsystem->FlushBuild();
+	if (!NavSubsystem->IsNavigationReady())
+	{
+		AddError(TEXT("The world has no AAIDroneNavVolume"));
+		return false;
+	}
+
+	UWorld* World = NavSubsystem->GetWorld();
+	const FBox Bounds = NavSubsystem->GetSnapshot()->GetBounds();
+	const FVector Center = Bounds.GetCenter();
+	const FVector Extent = Bounds.GetExtent();
+	const FVector Start = Center - FVector(Extent.X * 0.5, 0.0, 0.0);
+	const FVector Goal = Center + FVector(Extent.X * 0.5, 0.0, 0.0);
+	const int32 MaxExpansions = IConsoleManager::Get().FindConsoleVariable(TEXT("drone.Nav.MaxExpansions"))->GetInt();
+
+	// A thin wall across X, leaving room to fly around it at the Y ends
+	UStaticMesh* Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AStaticMeshActor* Wall = Cube ? World->SpawnActor<AStaticMeshActor>(Center, FRotator::ZeroRotator, SpawnParams) : nullptr;
+	if (!TestNotNull(TEXT("Test wall spawned"), Wall))
+	{
+		return false;
+	}
+	Wall->SetMobility(EComponentMobility::Movable);
+	Wall->GetStaticMeshComponent()->SetStaticMesh(Cube);
+	Wall->GetStaticMeshComponent()->SetCollisionProfileName(UCollisionProfile::BlockAllDynamic_ProfileName);
+	Wall->SetActorScale3D(FVector(0.5, Extent.Y * 1.2 / 100.0, Extent.Z * 2.2 / 100.0));
+	UAIDroneNavObstacleComponent* Obstacle = NewObject<UAIDroneNavObstacleComponent>(Wall);
+	Obstacle->RegisterComponent();
+
+	NavSubsystem->FlushBuild();
+	TSharedPtr<const FDroneNavBrickMap> Map = NavSubsystem->GetSnapshot();
+	TSharedPtr<FDroneNavPath> Path = Map->FindPath(Start, Goal, MaxExpansions);
+	TestFalse(TEXT("Wall in the way blocks line of sight"), Map->HasLineOfSight(Start, Goal));
+	TestTrue(TEXT("Wall in the way is routed around"), Path.IsValid() && !Path->bPartial && Path->Points.Num() > 2);
+
+	Wall->SetActorLocation(Center + FVector(0.0, 0.0, Extent.Z * 4.0));
+	NavSubsystem->FlushBuild();
+	Map = NavSubsystem->GetSnapshot();
+	Path = Map->FindPath(Start, Goal, MaxExpansions);
+	TestTrue(TEXT("Wall moved away clears line of sight"), Map->HasLineOfSight(Start, Goal));
+	TestTrue(TEXT("Wall moved away gives a straight path"), Path.IsValid() && Path->Points.Num() == 2);
+
+	Wall->Destroy();
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
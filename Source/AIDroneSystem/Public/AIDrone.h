@@ -12,6 +12,7 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "Net/UnrealNetwork.h"
+#include "AIDroneFlightRecorder.h"
 #include "AIDrone.generated.h"
 
 UENUM(BlueprintType)
@@ -22,6 +23,12 @@ enum class EDroneState : uint8
     Possessed
 };
 
+class UAIDroneFleetSubsystem;
+class UAIDroneNavSubsystem;
+struct FDroneNavPath;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnDroneStateChanged, AAIDrone*);
+
 UCLASS()
 class AIDRONESYSTEM_API AAIDrone : public APawn
 {
@@ -33,6 +40,9 @@ public:
     virtual void Tick(float DeltaTime) override;
     virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+    // Server-side behaviour for one update; DeltaTime covers every frame since the drone was last updated
+    void UpdateDroneAI(float DeltaTime);
+
     UFUNCTION(Server, Reliable, WithValidation)
     void ServerRequestPossess(APlayerController* Requester);
 
@@ -45,8 +55,17 @@ public:
     UPROPERTY(ReplicatedUsing = OnRep_State)
     EDroneState CurrentState;
 
+    // Server only: changes state and notifies listeners here as well as on clients
+    void SetDroneState(EDroneState NewState);
+
+    // Fires on every machine whenever CurrentState changes
+    FOnDroneStateChanged OnStateChanged;
+
     UPROPERTY(Replicated)
     ACharacter* FollowTarget;
+
+    // Server only: restored from a fleet snapshot as following a player who has not rejoined yet, so FollowTarget is still null
+    bool bAwaitingFollowTarget = false;
     
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Behavior")
     float CommandRange = 500.0f;
@@ -60,8 +79,23 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Behavior")
     float HoverFrequency = 1.0f;
 
+    // Radius other drones keep clear of when avoiding this one
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Avoidance")
+    float AvoidanceRadius = 60.0f;
+
+    // Plan around obstacles through the flight navigation brick map when one is available
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+    bool bUseFlightNavigation = true;
+
+    float GetMaxSpeed() const { return MovementComponent ? MovementComponent->MaxSpeed : 0.0f; }
+
+    UStaticMeshComponent* GetDroneMesh() const { return DroneMesh; }
+
+    UInputMappingContext* GetInputMappingContext() const { return DroneMappingContext; }
+
 protected:
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
     virtual void PossessedBy(AController* NewController) override;
     virtual void UnPossessed() override;
     virtual void OnRep_PlayerState() override;
@@ -72,6 +106,11 @@ protected:
 
     void UpdateVisualFeedback();
     void ApplyHoverPhysics(float DeltaTime);
+    void ApplyAvoidanceInput();
+    FVector GetFlightDirection(const FVector& Goal);
+    bool FindObstacleAhead(const FVector& Direction, float Distance, FVector& OutNormal) const;
+    void SetNavPath(TSharedPtr<const FDroneNavPath> Path);
+    void ApplyPendingMove();
 
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Input")
     UInputMappingContext* DroneMappingContext;
@@ -114,4 +153,37 @@ private:
     void Unpossess(const FInputActionValue& Value);
 
     FRotator LastSentRotation;
+
+    // Server only: ServerMoves admitted or merged by the owning connection's rate limit but not applied yet
+    FVector PendingMoveLocation = FVector::ZeroVector;
+    FVector PendingMoveInput = FVector::ZeroVector;
+    FRotator PendingMoveRotation = FRotator::ZeroRotator;
+    bool bHasPendingMove = false;
+
+    // Server only: the AI controller a player displaced, possessing the drone again once the player lets go
+    UPROPERTY(Transient)
+    TObjectPtr<AController> ParkedAIController;
+
+    // Clock for the hover bob, advanced only by the updates the drone actually gets
+    float HoverTime = 0.0f;
+
+    UPROPERTY(Transient)
+    TObjectPtr<UAIDroneFleetSubsystem> FleetSubsystem;
+
+    UPROPERTY(Transient)
+    TObjectPtr<UAIDroneNavSubsystem> NavSubsystem;
+
+    TSharedPtr<const FDroneNavPath> NavPath;
+    int32 NavPathIndex = 0;
+    FVector NavPathGoal = FVector::ZeroVector;
+    bool bNavPathPending = false;
+
+    // Slot in the fleet subsystem's per-drone arrays, managed by the subsystem
+    int32 FleetIndex = INDEX_NONE;
+
+    // What happened since the last flight recorder sample; cleared by the fleet subsystem
+    EDroneFlightEvent PendingFlightEvents = EDroneFlightEvent::None;
+    uint16 PendingServerMoves = 0;
+
+    friend class UAIDroneFleetSubsystem;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Shared per-frame neighbour list for the whole drone fleet.
+ * Agents are stored as SoA arrays so the build and the avoidance solve can run
+ * in parallel over drones without touching any UObject.
+ */
+struct AIDRONESYSTEM_API FDroneNeighbourQuery
+{
+	/** Hard upper bound on neighbours considered per drone; bounds per-drone avoidance cost */
+	static constexpr int32 MaxNeighboursLimit = 16;
+
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> Radii;
+
+	/** Flat [AgentIndex * MaxNeighboursLimit + Slot] neighbour indices, nearest first */
+	TArray<int32> Neighbours;
+	TArray<int32> NeighbourCounts;
+
+	void Reset(int32 NumAgents);
+
+	/** Buckets agents into a uniform grid and gathers up to MaxNeighbours within QueryRadius for every agent */
+	void Build(float QueryRadius, int32 MaxNeighbours);
+
+	FORCEINLINE int32 Num() const { return Positions.Num(); }
+	FORCEINLINE const int32* GetNeighbours(int32 AgentIndex) const { return Neighbours.GetData() + AgentIndex * MaxNeighboursLimit; }
+
+private:
+	TMap<FIntVector, int32> CellHeads;
+	TArray<int32> NextInCell;
+};
+
+/**
+ * Reciprocal velocity obstacle (ORCA) solve over a built neighbour query.
+ */
+struct AIDRONESYSTEM_API FDroneAvoidance
+{
+	struct FParams
+	{
+		float TimeHorizon = 1.0f;
+		float DeltaTime = 1.0f / 30.0f;
+		int32 SolverIterations = 4;
+	};
+
+	/**
+	 * Computes a collision-free velocity for every agent.
+	 * PreferredVelocities, MaxSpeeds and Responsive are indexed like the query; agents that are not
+	 * responsive (e.g. player controlled) keep their preferred velocity and the others take full responsibility.
+	 */
+	static void Solve(const FDroneNeighbourQuery& Query, TConstArrayView<FVector> PreferredVelocities, TConstArrayView<float> MaxSpeeds,
+		TConstArrayView<bool> Responsive, const FParams& Params, TArrayView<FVector> OutVelocities);
+};
@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UWorld;
+
+/**
+ * On-disk layout of a baked drone distance field (.dsdf).
+ * Samples sit at voxel centres and are grouped into bricks of 8^3 cells; every brick stores 9^3 quantized
+ * samples (one-sample apron) so a trilinear lookup never crosses a brick. Bricks that are entirely open air
+ * beyond MaxDistance, or entirely buried deeper than MaxDistance, are not stored at all.
+ */
+struct FDroneDistanceFieldHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x46445344; // "DSDF"
+	static constexpr uint32 CurrentVersion = 1;
+
+	uint32 Magic = ExpectedMagic;
+	uint32 Version = CurrentVersion;
+	FVector3f Origin = FVector3f::ZeroVector;
+	float VoxelSize = 0.0f;
+	float MaxDistance = 0.0f;
+	FIntVector NumBricks = FIntVector::ZeroValue;
+	uint32 NumStoredBricks = 0;
+	uint64 IndexOffset = 0;
+	uint64 PayloadOffset = 0;
+};
+static_assert(sizeof(FDroneDistanceFieldHeader) == 64, "Distance field header layout is part of the file format");
+
+/**
+ * Read-only signed distance to the baked static collision of a level.
+ * The bake is memory-mapped where the platform allows it, so a query costs one index read plus the eight
+ * samples around the point instead of a physics scene query.
+ */
+class AIDRONESYSTEM_API FDroneDistanceField
+{
+public:
+	static constexpr int32 BrickCells = 8;
+	static constexpr int32 BrickSamples = BrickCells + 1;
+	static constexpr int32 BrickBytes = BrickSamples * BrickSamples * BrickSamples;
+	static constexpr uint32 EmptyBrick = MAX_uint32;
+	static constexpr uint32 SolidBrick = MAX_uint32 - 1;
+
+	struct FBakeSettings
+	{
+		FBox Bounds = FBox(ForceInit);
+		float VoxelSize = 100.0f;
+		float MaxDistance = 800.0f;
+	};
+
+	FDroneDistanceField();
+	~FDroneDistanceField();
+
+	/** Samples the static collision inside Settings.Bounds and writes a complete .dsdf image into OutData */
+	static bool Bake(UWorld* World, const FBakeSettings& Settings, TArray64<uint8>& OutData);
+
+	/** Default location of the bake for a map, staged as a loose file so it can be memory-mapped */
+	static FString GetBakePath(const FString& MapName);
+
+	bool Load(const FString& Path);
+	void Unload();
+
+	FORCEINLINE bool IsLoaded() const { return Data != nullptr; }
+	FORCEINLINE float GetMaxDistance() const { return Header.MaxDistance; }
+	FORCEINLINE float GetVoxelSize() const { return Header.VoxelSize; }
+	FBox GetBounds() const;
+
+	/**
+	 * Signed distance in cm to the nearest baked obstacle (negative inside) and its normalized gradient.
+	 * Returns false outside the baked bounds, where callers should fall back to a trace.
+	 */
+	bool Sample(const FVector& Location, float& OutDistance, FVector& OutGradient) const;
+
+	/**
+	 * Sphere-traces the field from Start along Direction. Returns true and the surface normal if an obstacle
+	 * comes closer than Clearance within Distance. OutInBounds is false if the ray left the baked bounds.
+	 */
+	bool Raycast(const FVector& Start, const FVector& Direction, float Distance, float Clearance, FVector& OutNormal, bool& OutInBounds) const;
+
+private:
+	FDroneDistanceFieldHeader Header;
+	float InvVoxelSize = 0.0f;
+	FIntVector NumSamples;
+
+	const uint8* Data = nullptr;
+	const uint32* BrickIndex = nullptr;
+	const uint8* Payload = nullptr;
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	/** Used when the platform cannot memory-map the file */
+	TArray64<uint8> LoadedData;
+};
@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AIDroneDistanceFieldBakeCommandlet.generated.h"
+
+/**
+ * Headless bake of the drone distance field for one map.
+ * Usage: -run=AIDroneDistanceFieldBake -Map=/Game/Maps/MyMap [-VoxelSize=100] [-MaxDistance=800] [-Out=Path.dsdf]
+ * The bounds are the union of the map's AAIDroneNavVolumes.
+ */
+UCLASS()
+class UAIDroneDistanceFieldBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UAIDroneDistanceFieldBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
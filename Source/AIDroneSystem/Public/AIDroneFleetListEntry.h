@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "Blueprint/IUserObjectListEntry.h"
+#include "AIDrone.h"
+#include "AIDroneFleetListEntry.generated.h"
+
+class AAIDroneFleetProxy;
+class UTextBlock;
+
+/**
+ * One row of the fleet overview. Items are pooled by the overview and outlive the entry widgets
+ * that show them; entries listen for OnChanged instead of polling.
+ */
+UCLASS(BlueprintType)
+class AIDRONESYSTEM_API UAIDroneFleetListItem : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	FText NameText;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	FText StateText;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	FText DistanceText;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	FText FollowTargetText;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	EDroneState State = EDroneState::Idle;
+
+	/** No actor exists for this drone; it is a record on a fleet proxy */
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	bool bDormant = false;
+
+	/** This is the drone the owning player is linked to or controlling */
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	bool bLinked = false;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Drone Info")
+	float Distance = 0.0f;
+
+	FSimpleMulticastDelegate OnChanged;
+
+	void SetDrone(AAIDrone* InDrone);
+	void SetDormantRecord(AAIDroneFleetProxy* Proxy, int32 RecordId);
+
+	/** Refreshes everything that can change between fleet updates; broadcasts OnChanged when any text changed */
+	void Update(float InDistance, bool bInLinked);
+
+	FORCEINLINE AAIDrone* GetDrone() const { return Drone.Get(); }
+
+private:
+	void HandleStateChanged(AAIDrone* InDrone);
+	bool UpdateStateText();
+
+	TWeakObjectPtr<AAIDrone> Drone;
+	FDelegateHandle StateChangedHandle;
+	TWeakObjectPtr<const ACharacter> DisplayedFollowTarget;
+
+	/** Distance shown in DistanceText, in whole metres, so text is only rebuilt when it reads differently */
+	int32 DisplayedMetres = INDEX_NONE;
+};
+
+/**
+ * Row widget for the fleet overview list. Name Text Blocks to match the optional bindings and they are
+ * filled in on change; Blueprint can react to OnItemChanged for anything else.
+ */
+UCLASS(Abstract)
+class AIDRONESYSTEM_API UAIDroneFleetEntryWidget : public UUserWidget, public IUserObjectListEntry
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void NativeOnListItemObjectSet(UObject* ListItemObject) override;
+	virtual void NativeOnEntryReleased() override;
+
+	UFUNCTION(BlueprintImplementableEvent, Category = "Drone Info")
+	void OnItemChanged(UAIDroneFleetListItem* Item);
+
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidgetOptional))
+	TObjectPtr<UTextBlock> NameText;
+
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidgetOptional))
+	TObjectPtr<UTextBlock> StateText;
+
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidgetOptional))
+	TObjectPtr<UTextBlock> DistanceText;
+
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidgetOptional))
+	TObjectPtr<UTextBlock> FollowTargetText;
+
+private:
+	void HandleItemChanged();
+
+	UPROPERTY(Transient)
+	TObjectPtr<UAIDroneFleetListItem> Item;
+
+	FDelegateHandle ItemChangedHandle;
+};
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "AIDroneFleetManifest.generated.h"
+
+class AAIDrone;
+
+/** Drones of one class that start in the map */
+USTRUCT(BlueprintType)
+struct FDroneFleetGroup
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Drones")
+	TSoftClassPtr<AAIDrone> DroneClass;
+
+	/** Start as dormant fleet records, which wake when a player comes near, instead of as actors */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Drones")
+	bool bStartDormant = false;
+
+	/** World transforms; only location and yaw are used */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Drones")
+	TArray<FTransform> Placements;
+};
+
+/**
+ * A fleet layout kept out of the map. Drone classes are soft references, so nothing they use is loaded
+ * until UAIDroneFleetSubsystem::SpawnManifest loads them all in the background as one request.
+ */
+UCLASS(BlueprintType)
+class AIDRONESYSTEM_API UAIDroneFleetManifest : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Drones")
+	TArray<FDroneFleetGroup> Groups;
+
+	int32 GetNumDrones() const;
+
+	/** Every drone class the manifest uses, without duplicates */
+	void GetDroneClassPaths(TArray<FSoftObjectPath>& OutPaths) const;
+};
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "UObject/ObjectKey.h"
+#include "AIDroneFleetOverviewWidget.generated.h"
+
+class AAIDrone;
+class UAIDroneFleetListItem;
+class UAIDroneFleetSubsystem;
+class UListView;
+
+UENUM(BlueprintType)
+enum class EDroneFleetSortMode : uint8
+{
+	Distance,
+	Name,
+	State
+};
+
+/**
+ * Fleet panel listing every drone within range of the owning player.
+ * Rows are gathered into a flat array, filtered and sorted there, and only then handed to a UListView,
+ * which creates widgets for the visible rows alone. The list is rebuilt on a fixed interval and, coalesced
+ * to once a frame, whenever drones join or leave the fleet; state changes update their row immediately.
+ */
+UCLASS(Abstract)
+class AIDRONESYSTEM_API UAIDroneFleetOverviewWidget : public UUserWidget
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintCallable, Category = "Drone Fleet")
+	void SetSortMode(EDroneFleetSortMode InSortMode);
+
+	/** Rebuilds the list on the next frame */
+	UFUNCTION(BlueprintCallable, Category = "Drone Fleet")
+	void RequestRefresh();
+
+protected:
+	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+
+	/** Entry widget class comes from the list view; it should derive from UAIDroneFleetEntryWidget */
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidget))
+	TObjectPtr<UListView> DroneList;
+
+	/** Drones further than this from the owning pawn are left out; zero lists the whole fleet */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drone Fleet")
+	float Range = 10000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drone Fleet")
+	float RefreshInterval = 0.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drone Fleet")
+	EDroneFleetSortMode SortMode = EDroneFleetSortMode::Distance;
+
+	/** States to list */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drone Fleet", meta = (Bitmask, BitmaskEnum = "/Script/AIDroneSystem.EDroneState"))
+	int32 StateFilter = 0x7;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drone Fleet")
+	bool bShowDormant = true;
+
+private:
+	void Refresh();
+	void HandleFleetChanged();
+
+	/** Actor drones key on themselves; dormant records key on their proxy and record id */
+	using FRowKey = TPair<FObjectKey, int32>;
+
+	UAIDroneFleetListItem* FindOrAddItem(const FRowKey& Key, bool& bOutAdded);
+
+	TWeakObjectPtr<UAIDroneFleetSubsystem> FleetSubsystem;
+	FDelegateHandle FleetChangedHandle;
+	FTimerHandle RefreshTimer;
+	bool bRefreshQueued = false;
+
+	/** Every item currently listed, in list order; also keeps them alive */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UObject>> ListedItems;
+
+	TMap<FRowKey, TObjectPtr<UAIDroneFleetListItem>> ItemsByKey;
+};
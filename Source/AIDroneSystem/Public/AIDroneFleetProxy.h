@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "AIDroneFleetProxy.generated.h"
+
+class AAIDrone;
+class AAIDroneFleetProxy;
+class UInstancedStaticMeshComponent;
+
+/** A dormant drone: no actor, no components and no controller, just enough to bring it back */
+USTRUCT()
+struct FDroneFleetRecord : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 RecordId = INDEX_NONE;
+
+	UPROPERTY()
+	FVector_NetQuantize Location = FVector::ZeroVector;
+
+	UPROPERTY()
+	float Yaw = 0.0f;
+
+	void PostReplicatedAdd(const struct FDroneFleetRecordArray& InArraySerializer);
+	void PostReplicatedChange(const struct FDroneFleetRecordArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FDroneFleetRecordArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FDroneFleetRecordArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FDroneFleetRecord> Items;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<AAIDroneFleetProxy> Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParams)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FDroneFleetRecord, FDroneFleetRecordArray>(Items, DeltaParams, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FDroneFleetRecordArray> : public TStructOpsTypeTraitsBase2<FDroneFleetRecordArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Replicated stand-in for every dormant drone of one class.
+ * Records replicate as a fast array and render as instances of the class's drone mesh, with the same
+ * collision, so players can still see and trace at dormant drones. A trace hit's Item is the instance index.
+ */
+UCLASS(NotPlaceable)
+class AIDRONESYSTEM_API AAIDroneFleetProxy : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AAIDroneFleetProxy();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Server only: sets the drone class this proxy stands in for */
+	void SetDroneClass(TSubclassOf<AAIDrone> InDroneClass);
+	FORCEINLINE TSubclassOf<AAIDrone> GetDroneClass() const { return DroneClass; }
+
+	/** Server only */
+	void AddRecord(const FDroneFleetRecord& Record);
+
+	/** Server only: adds many records with one instance batch and one fleet notification */
+	void AddRecords(TConstArrayView<FDroneFleetRecord> NewRecords);
+	bool RemoveRecord(int32 RecordId, FDroneFleetRecord& OutRecord);
+
+	FORCEINLINE const TArray<FDroneFleetRecord>& GetRecords() const { return Records.Items; }
+	bool GetRecordIdForInstance(int32 InstanceIndex, int32& OutRecordId) const;
+
+	// Keep the rendered instances in step with the records, on the server and on clients
+	void OnRecordAdded(const FDroneFleetRecord& Record);
+	void OnRecordChanged(const FDroneFleetRecord& Record);
+	void OnRecordRemoved(const FDroneFleetRecord& Record);
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UFUNCTION()
+	void OnRep_DroneClass();
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TObjectPtr<UInstancedStaticMeshComponent> Instances;
+
+	UPROPERTY(ReplicatedUsing = OnRep_DroneClass)
+	TSubclassOf<AAIDrone> DroneClass;
+
+	UPROPERTY(Replicated)
+	FDroneFleetRecordArray Records;
+
+private:
+	static FTransform GetRecordTransform(const FDroneFleetRecord& Record);
+	void NotifyFleetChanged() const;
+
+	/** Record id of every instance, kept in instance order */
+	TArray<int32> InstanceRecordIds;
+};
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * On-disk layout of a fleet snapshot (.dfs): this header, the string table, then the drone and record arrays.
+ * Strings are a uint32 byte count followed by UTF-8 and hold drone class paths and player ids.
+ * Both arrays are stored exactly as in memory, 16-byte aligned, so a mapped file is read in place.
+ */
+struct FDroneSnapshotHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4E534644; // "DFSN"
+	static constexpr uint32 CurrentVersion = 1;
+
+	uint32 Magic = ExpectedMagic;
+	uint32 Version = CurrentVersion;
+	double WorldTime = 0.0;
+	uint32 NumStrings = 0;
+	uint32 NumDrones = 0;
+	uint32 NumRecords = 0;
+	uint32 Reserved = 0;
+	uint64 StringsOffset = 0;
+	uint64 DronesOffset = 0;
+	uint64 RecordsOffset = 0;
+};
+static_assert(sizeof(FDroneSnapshotHeader) == 56, "Snapshot header layout is part of the file format");
+
+/** A drone that had an actor when the snapshot was taken */
+struct FDroneSnapshotDrone
+{
+	FVector3f Location = FVector3f::ZeroVector;
+	float Yaw = 0.0f;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	float HoverTime = 0.0f;
+	uint32 ClassIndex = 0;
+
+	// String index of the player id of the character it follows, or INDEX_NONE
+	int32 FollowPlayerIndex = INDEX_NONE;
+
+	// String index of the player id whose character is linked to it or who was possessing it, or INDEX_NONE
+	int32 LinkedPlayerIndex = INDEX_NONE;
+
+	uint8 State = 0;
+	uint8 Padding[3] = {};
+};
+static_assert(sizeof(FDroneSnapshotDrone) == 48, "Snapshot drone layout is part of the file format");
+
+/** A dormant drone */
+struct FDroneSnapshotRecord
+{
+	FVector3f Location = FVector3f::ZeroVector;
+	float Yaw = 0.0f;
+	uint32 ClassIndex = 0;
+};
+static_assert(sizeof(FDroneSnapshotRecord) == 20, "Snapshot record layout is part of the file format");
+
+/**
+ * A whole fleet as one versioned binary image, for restarting or moving a server without losing its drones.
+ * Saving builds the image on the game thread with a few copies and writes it on the thread pool; loading
+ * memory-maps the file, where the platform allows it, and hands out views straight into it.
+ */
+class AIDRONESYSTEM_API FDroneFleetSnapshot
+{
+public:
+	FDroneFleetSnapshot();
+	~FDroneFleetSnapshot();
+
+	/** Lays out a complete .dfs image */
+	static void Build(double WorldTime, TConstArrayView<FString> Strings, TConstArrayView<FDroneSnapshotDrone> Drones,
+		TConstArrayView<FDroneSnapshotRecord> Records, TArray64<uint8>& OutData);
+
+	/** Writes Data next to Path on the thread pool and then moves it over Path, so a crash never leaves half a snapshot */
+	static TFuture<bool> SaveAsync(const FString& Path, TArray64<uint8>&& Data);
+
+	/** Default snapshot for a map: Saved/DroneSnapshots/<Map>.dfs */
+	static FString GetDefaultPath(const FString& MapName);
+
+	/** Returns false with OutError set if the file is missing, foreign or truncated */
+	bool Load(const FString& Path, FString& OutError);
+	void Unload();
+
+	FORCEINLINE bool IsLoaded() const { return Data != nullptr; }
+	FORCEINLINE double GetWorldTime() const { return Header.WorldTime; }
+	FORCEINLINE const TArray<FString>& GetStrings() const { return Strings; }
+
+	/** Views into the loaded file; valid until Unload */
+	FORCEINLINE TConstArrayView<FDroneSnapshotDrone> GetDrones() const { return MakeArrayView(Drones, Header.NumDrones); }
+	FORCEINLINE TConstArrayView<FDroneSnapshotRecord> GetRecords() const { return MakeArrayView(Records, Header.NumRecords); }
+
+private:
+	FDroneSnapshotHeader Header;
+	TArray<FString> Strings;
+
+	const uint8* Data = nullptr;
+	const FDroneSnapshotDrone* Drones = nullptr;
+	const FDroneSnapshotRecord* Records = nullptr;
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	/** Used when the platform cannot memory-map the file */
+	TArray64<uint8> LoadedData;
+};
@@ -0,0 +1,203 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AIDroneAvoidance.h"
+#include "AIDroneFleetSnapshot.h"
+#include "AIDroneFleetWorker.h"
+#include "AIDroneFlightRecorder.h"
+#include "AIDroneFleetSubsystem.generated.h"
+
+class AAIDrone;
+class AAIDroneFleetProxy;
+class UAIDroneFleetManifest;
+struct FStreamableHandle;
+
+/**
+ * World subsystem that owns fleet-wide drone work.
+ * Drones register themselves on BeginPlay. Once per frame on the server the subsystem runs drone AI
+ * within a millisecond budget, then builds a shared neighbour query for every registered drone and
+ * solves reciprocal avoidance for all of them, or hands that solve to an out-of-process worker (drone.Worker.Enable)
+ * and collects the answer at the start of the next frame.
+ * Idle drones far from every player are demoted to records on an AAIDroneFleetProxy and promoted back to
+ * actors when a player comes within command range or interacts with them.
+ */
+UCLASS()
+class AIDRONESYSTEM_API UAIDroneFleetSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterDrone(AAIDrone* Drone);
+	void UnregisterDrone(AAIDrone* Drone);
+
+	FORCEINLINE const TArray<TObjectPtr<AAIDrone>>& GetDrones() const { return Drones; }
+
+	/** Fires when a drone registers or unregisters, or a dormant record is added or removed, on every machine */
+	FSimpleMulticastDelegate OnFleetChanged;
+
+	/** Velocity the drone steered for this frame; avoidance is solved against it at the end of the frame */
+	void SetPreferredVelocity(const AAIDrone* Drone, const FVector& Velocity);
+
+	/** Returns false if no avoidance result is available for the drone yet */
+	bool GetAvoidanceVelocity(const AAIDrone* Drone, FVector& OutVelocity) const;
+
+	/** The fleet as of the last avoidance solve; its neighbour lists are only built when that solve ran in process */
+	FORCEINLINE const FDroneNeighbourQuery& GetNeighbourQuery() const { return NeighbourQuery; }
+
+	FORCEINLINE const FDroneWorkerClient& GetWorkerClient() const { return Worker.GetClient(); }
+
+	/** Number of drone AI updates pushed to a later frame by the budget in the last tick */
+	FORCEINLINE int32 GetNumDeferredUpdates() const { return NumDeferredUpdates; }
+
+	void RegisterProxy(AAIDroneFleetProxy* Proxy);
+	void UnregisterProxy(AAIDroneFleetProxy* Proxy);
+
+	FORCEINLINE const TArray<TObjectPtr<AAIDroneFleetProxy>>& GetProxies() const { return Proxies; }
+
+	/** Server only: replaces the drone actor with a record on its class's proxy */
+	bool DemoteDrone(AAIDrone* Drone);
+
+	/** Server only: spawns the drone actor back from its record; returns null if the record is gone */
+	AAIDrone* PromoteDrone(AAIDroneFleetProxy* Proxy, int32 RecordId);
+
+	/** Server only: records every registered drone's updates to Path until stopped */
+	bool StartFlightRecording(const FString& Path);
+	void StopFlightRecording();
+
+	FORCEINLINE const FDroneFlightRecorder* GetFlightRecorder() const { return FlightRecorder.Get(); }
+
+	/** Samples the drone's state at the end of its update; cheap enough to call for every drone every frame */
+	void RecordFlight(AAIDrone* Drone);
+
+	/** Server only: writes every drone and dormant record to Path; the file is written off the game thread */
+	bool SaveSnapshot(const FString& Path);
+
+	/**
+	 * Server only: brings back the fleet saved in Path. Dormant and idle drones return as records at once,
+	 * the rest spawn over the next frames within drone.Spawn.BudgetMs, and links to characters
+	 * are restored as their players join.
+	 */
+	bool RestoreSnapshot(const FString& Path);
+
+	/**
+	 * Server only: loads the manifest and every drone class it uses in the background, then adds its
+	 * dormant groups as records at once and spawns the rest over the next frames within drone.Spawn.BudgetMs.
+	 */
+	bool SpawnManifest(const TSoftObjectPtr<UAIDroneFleetManifest>& Manifest);
+
+	/** Drones from snapshots and manifests still waiting for their actor */
+	FORCEINLINE int32 GetNumQueuedSpawns() const { return SpawnQueue.Num() - NextQueuedSpawn; }
+
+	/** Fires on the server once every requested snapshot and manifest has loaded and its last drone has spawned, or been added as a record */
+	FSimpleMulticastDelegate OnFleetReady;
+
+private:
+	/** Update order; lower runs first and only EScheduleBucket::Possessed ignores the budget */
+	enum class EScheduleBucket : uint8
+	{
+		Possessed,
+		FollowingNearPlayer,
+		Following,
+		Idle,
+		Num
+	};
+
+	EScheduleBucket GetScheduleBucket(int32 Index) const;
+	void TickServer(float DeltaTime);
+	void UpdateDrones(float DeltaTime);
+	void UpdateDronesFixedStep(float StepTime);
+	void SetFixedStepMovement(bool bEnable);
+	void UpdateAvoidance(float DeltaTime);
+	void UpdateDormancy(float DeltaTime);
+	AAIDroneFleetProxy* FindOrSpawnProxy(TSubclassOf<AAIDrone> DroneClass);
+	static bool IsDormancyEnabled();
+
+	// Snapshots and the spawn queue, in AIDroneFleetSpawnQueue.cpp
+	void TickSnapshots(float DeltaTime);
+	void AutoRestoreSnapshot();
+	void QueueManifest(const UAIDroneFleetManifest* Manifest);
+	void SpawnQueuedDrones();
+	void FinishSpawnRequests();
+	void ResolveSnapshotLinks();
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AAIDrone>> Drones;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AAIDroneFleetProxy>> Proxies;
+
+	int32 NextRecordId = 0;
+	float DormancyCheckTime = 0.0f;
+
+	/** Time not yet simulated when drone.Sim.FixedStep is set */
+	double FixedStepTime = 0.0;
+
+	/** Drone movement components are ticked by the fixed steps rather than by themselves */
+	bool bFixedStepMovement = false;
+
+	TUniquePtr<FDroneFlightRecorder> FlightRecorder;
+	float FlightRecorderFlushTime = 0.0f;
+
+	/** Drones from snapshots and manifests that still need an actor, spawned in order from NextQueuedSpawn */
+	TArray<FDroneSnapshotDrone> SpawnQueue;
+	int32 NextQueuedSpawn = 0;
+
+	/** String table SpawnQueue indexes into */
+	TArray<FString> SpawnQueueStrings;
+
+	/** Classes of the SpawnQueueStrings that name one; kept here so they stay loaded */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UClass>> SpawnQueueClasses;
+
+	/** When the first restore or manifest still in progress was requested, or 0 */
+	double SpawnRequestTime = 0.0;
+	int32 NumSpawnFrames = 0;
+	double WorstSpawnFrameMs = 0.0;
+
+	/** Manifests and drone classes being loaded or in use by the spawn queue */
+	TArray<TSharedPtr<FStreamableHandle>> ManifestLoadHandles;
+
+	/** Manifests requested but not yet queued; the fleet is not ready while any are streaming */
+	int32 NumLoadingManifests = 0;
+
+	/** A restored drone waiting for its player's character */
+	struct FSnapshotLink
+	{
+		TWeakObjectPtr<AAIDrone> Drone;
+		FString PlayerId;
+		bool bFollow = false;
+	};
+	TArray<FSnapshotLink> SnapshotLinks;
+	float SnapshotLinkCheckTime = 0.0f;
+
+	float SnapshotAutoSaveTime = 0.0f;
+	TFuture<bool> SnapshotWrite;
+
+	FDroneNeighbourQuery NeighbourQuery;
+
+	FDroneFleetWorker Worker;
+
+	// Indexed like Drones
+	TArray<FVector> PreferredVelocities;
+	TArray<FVector> AvoidanceVelocities;
+	TArray<float> MaxSpeeds;
+	TArray<bool> Responsive;
+	TBitArray<> HasAvoidanceVelocity;
+
+	/** Game time each drone has not been updated for yet */
+	TArray<float> PendingDeltaTimes;
+
+	/** World time each drone was last commanded, linked or near a player */
+	TArray<double> LastActiveTimes;
+
+	TArray<int32> Buckets[(int32)EScheduleBucket::Num];
+	int32 RoundRobinCursors[(int32)EScheduleBucket::Num] = {};
+	int32 NumDeferredUpdates = 0;
+};
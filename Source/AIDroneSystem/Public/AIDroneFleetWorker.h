@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "AIDroneAvoidance.h"
+#include "AIDroneWorkerPool.h"
+
+/**
+ * The fleet's side of avoidance offloading. Keeps a FDroneWorkerClient connected while drone.Worker.Enable is
+ * set, hands it one avoidance frame at a time and collects the answer at the start of the next server tick,
+ * solving the frame in process when the worker is late or gone. Drones can register and unregister between
+ * the two, so the submitted frame is kept together with each drone's index in it.
+ */
+class AIDRONESYSTEM_API FDroneFleetWorker
+{
+public:
+	/** Connects, reconnects after a worker restart, or disconnects when drone.Worker.Enable is off; call every server tick */
+	void UpdateConnection();
+	void Disconnect();
+
+	/** Keep the submitted indices in step with the fleet's drone array */
+	void AddDrone();
+	void RemoveDroneAtSwap(int32 Index);
+
+	/**
+	 * Hands the fleet's avoidance frame to the worker. Returns false, leaving the caller to solve it in
+	 * process, when no worker is connected or it cannot take the frame.
+	 */
+	bool Submit(const FDroneNeighbourQuery& Query, TConstArrayView<FVector> PreferredVelocities, TConstArrayView<float> MaxSpeeds,
+		TConstArrayView<bool> Responsive, float NeighbourRadius, int32 MaxNeighbours, const FDroneAvoidance::FParams& Params);
+
+	/**
+	 * Collects the submitted frame into the velocities of the drones that were part of it, waiting up to
+	 * drone.Worker.WaitMs. Query must still hold the submitted frame, so it can be solved in process instead.
+	 * Does nothing if no frame is outstanding.
+	 */
+	void Resolve(FDroneNeighbourQuery& Query, TArrayView<FVector> OutVelocities, TBitArray<>& OutHasVelocity);
+
+	FORCEINLINE const FDroneWorkerClient& GetClient() const { return Client; }
+
+private:
+	FDroneWorkerClient Client;
+	double NextConnectTime = 0.0;
+
+	/** A frame handed to the worker and not collected yet, kept to solve in process if it does not come back in time */
+	bool bSubmitted = false;
+	float SubmittedNeighbourRadius = 0.0f;
+	int32 SubmittedMaxNeighbours = 0;
+	FDroneAvoidance::FParams SubmittedParams;
+	TArray<FVector> SubmittedPreferredVelocities;
+	TArray<float> SubmittedMaxSpeeds;
+	TArray<bool> SubmittedResponsive;
+	TArray<FVector> SubmittedVelocities;
+
+	/** Each drone's index in the submitted frame, or INDEX_NONE if it registered since; indexed like the fleet's drones */
+	TArray<int32> SubmittedIndices;
+};
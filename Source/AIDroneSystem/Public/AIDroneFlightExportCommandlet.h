@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AIDroneFlightExportCommandlet.generated.h"
+
+/**
+ * Converts a drone flight recording to CSV, one row per sample.
+ * Usage: -run=AIDroneFlightExport -In=Path.dfr [-Out=Path.csv]
+ */
+UCLASS()
+class UAIDroneFlightExportCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UAIDroneFlightExportCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
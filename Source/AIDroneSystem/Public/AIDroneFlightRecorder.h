@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Function.h"
+
+class AAIDrone;
+class FDroneFlightWriter;
+
+/** Things that happened to a drone since its previous sample */
+enum class EDroneFlightEvent : uint8
+{
+	None = 0,
+	AvoidanceAdjusted = 1 << 0,
+	ObstacleAhead = 1 << 1,
+	PossessRequest = 1 << 2,
+	UnpossessRequest = 1 << 3,
+	Possessed = 1 << 4,
+	Unpossessed = 1 << 5,
+};
+ENUM_CLASS_FLAGS(EDroneFlightEvent);
+
+/** One drone update. Written to disk as raw little-endian bytes, so the layout is part of the file format. */
+struct FDroneFlightSample
+{
+	double Time = 0.0;
+	FVector3f Position = FVector3f::ZeroVector;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	FVector3f Input = FVector3f::ZeroVector;
+	uint8 State = 0;
+	EDroneFlightEvent Events = EDroneFlightEvent::None;
+
+	/** ServerMove RPCs that arrived since the previous sample */
+	uint16 ServerMoves = 0;
+};
+static_assert(sizeof(FDroneFlightSample) == 48, "FDroneFlightSample is written to disk as is; bump FDroneFlightRecorder::Version when changing it");
+
+/**
+ * Flight recorder for drones.
+ * Every drone has a fixed-size ring of its latest samples; recording a sample is a single store into it.
+ * Flush, called a few times a second, copies what is new in every ring into one buffer and hands that to a
+ * background thread that appends it to the file, so the game thread never waits on disk.
+ *
+ * File layout: FFileHeader, then chunks of FChunkHeader followed by its payload.
+ * A Drone chunk's payload is the drone's name as UTF-8; a Samples chunk's payload is Count FDroneFlightSamples.
+ *
+ * Rings are kept in the same order as the fleet subsystem's drone arrays, which add and swap-remove them.
+ */
+class AIDRONESYSTEM_API FDroneFlightRecorder
+{
+public:
+	static constexpr uint32 Magic = 0x524C4644; // "DFLR"
+	static constexpr uint16 Version = 1;
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint16 Version;
+		uint16 SampleSize;
+		uint64 Reserved;
+	};
+	static_assert(sizeof(FFileHeader) == 16, "FFileHeader is written to disk as is");
+
+	enum class EChunkType : uint32
+	{
+		Drone = 1,
+		Samples = 2,
+	};
+
+	struct FChunkHeader
+	{
+		EChunkType Type;
+		uint32 DroneId;
+		uint32 Count;
+	};
+	static_assert(sizeof(FChunkHeader) == 12, "FChunkHeader is written to disk as is");
+
+	/** Opens Path for writing; check IsOpen. Capacity is rounded up to a power of two. */
+	FDroneFlightRecorder(const FString& InPath, int32 InCapacity);
+
+	/** Flushes what is left and waits for the writer to finish */
+	~FDroneFlightRecorder();
+
+	bool IsOpen() const { return Writer.IsValid(); }
+	const FString& GetPath() const { return Path; }
+
+	/** Samples overwritten in a ring before they could be flushed; raise the capacity or flush more often */
+	int64 GetNumDroppedSamples() const { return NumDroppedSamples; }
+
+	void AddDrone(const AAIDrone* Drone);
+	void RemoveDroneAtSwap(int32 Index);
+
+	FORCEINLINE void Record(int32 Index, const FDroneFlightSample& Sample)
+	{
+		FRing& Ring = Rings[Index];
+		Ring.Samples[Ring.NumWritten & CapacityMask] = Sample;
+		++Ring.NumWritten;
+	}
+
+	void Flush();
+
+	/** Reads a recording back; returns false with OutError set if the file is missing, foreign or truncated */
+	static bool ReadFile(const FString& FilePath,
+		TFunctionRef<void(uint32 DroneId, const FString& Name)> OnDrone,
+		TFunctionRef<void(uint32 DroneId, const FDroneFlightSample& Sample)> OnSample,
+		FString& OutError);
+
+	/** Default file for a new recording: Saved/DroneFlights/<Map>_<Timestamp>.dfr */
+	static FString GetDefaultPath(const FString& MapName);
+
+private:
+	struct FRing
+	{
+		uint32 DroneId = 0;
+		uint64 NumWritten = 0;
+		uint64 NumFlushed = 0;
+		TArray<FDroneFlightSample> Samples;
+	};
+
+	void AppendChunk(EChunkType Type, uint32 DroneId, uint32 Count, const void* Data, int64 Size);
+	void AppendRing(FRing& Ring);
+
+	FString Path;
+	uint64 CapacityMask = 0;
+	uint32 NextDroneId = 0;
+	int64 NumDroppedSamples = 0;
+
+	TArray<FRing> Rings;
+
+	/** Bytes waiting for the next flush; swapped with an empty buffer recycled by the writer */
+	TArray<uint8> Staging;
+
+	TUniquePtr<FDroneFlightWriter> Writer;
+};
@@ -5,10 +5,14 @@
 #include "AIDroneHUDWidget.generated.h"
 
 // Forward Declarations
+class AAIDrone;
 class AAIDroneSystemCharacter;
+class UTextBlock;
 
 /**
  * Widget class to display AIDrone information for the local player.
+ * The displayed text is cached and only rebuilt when the owning pawn, the linked drone or the drone's
+ * state changes, so nothing about this widget runs per frame.
  */
 UCLASS()
 class AIDRONESYSTEM_API UAIDroneHUDWidget : public UUserWidget
@@ -17,18 +21,59 @@ class AIDRONESYSTEM_API UAIDroneHUDWidget : public UUserWidget
 
 public:
 	/** * Returns the name of the currently linked Drone actor.
-	 * Bind this function to a Text Block in UMG.
+	 * Prefer naming a Text Block DroneNameText over binding this; bindings are polled every frame.
 	 */
 	UFUNCTION(BlueprintPure, Category = "Drone Info")
-	FText GetDroneNameText() const;
+	FText GetDroneNameText() const { return CachedDroneNameText; }
 
 	/** * Returns the current state (Idle, Following, Possessed) of the linked Drone.
-	 * Bind this function to a Text Block in UMG.
+	 * Prefer naming a Text Block DroneStateText over binding this; bindings are polled every frame.
 	 */
 	UFUNCTION(BlueprintPure, Category = "Drone Info")
-	FText GetDroneStateText() const;
+	FText GetDroneStateText() const { return CachedDroneStateText; }
+
+	/** The drone a player is looking after: the pawn itself when it is a drone, otherwise the character's linked drone */
+	UFUNCTION(BlueprintPure, Category = "Drone Info")
+	static AAIDrone* GetTargetDrone(APawn* OwningPawn);
+
+protected:
+	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+
+	/** Called after the cached text changes, for Blueprint effects that should play on a change */
+	UFUNCTION(BlueprintImplementableEvent, Category = "Drone Info")
+	void OnDroneInfoChanged();
+
+	/** Optional Text Blocks pushed on change, which keeps them invalidation and retainer friendly */
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidgetOptional))
+	TObjectPtr<UTextBlock> DroneNameText;
+
+	UPROPERTY(BlueprintReadOnly, meta = (BindWidgetOptional))
+	TObjectPtr<UTextBlock> DroneStateText;
 
 private:
 	/** Helper to get the correct character cast from the owning player */
 	AAIDroneSystemCharacter* GetOwningDroneCharacter() const;
-};
\ No newline at end of file
+
+	UFUNCTION()
+	void HandlePossessedPawnChanged(APawn* OldPawn, APawn* NewPawn);
+
+	UFUNCTION()
+	void HandleDroneEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+
+	void HandleLinkedDroneChanged(AAIDrone* Drone);
+	void HandleDroneStateChanged(AAIDrone* Drone);
+
+	/** Rebinds to the current character and drone, then refreshes the cached text */
+	void RefreshTarget();
+	void RefreshText();
+	void Unbind();
+
+	TWeakObjectPtr<AAIDroneSystemCharacter> BoundCharacter;
+	TWeakObjectPtr<AAIDrone> BoundDrone;
+	FDelegateHandle LinkedDroneChangedHandle;
+	FDelegateHandle DroneStateChangedHandle;
+
+	FText CachedDroneNameText;
+	FText CachedDroneStateText;
+};
@@ -0,0 +1,23 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class AAIDrone;
+class ACharacter;
+class UWorld;
+
+/** Setup shared by the headless drone modes (-DroneSim, -DroneSoak) */
+namespace AIDroneHeadless
+{
+	/** Overrides a console variable the way code does, so the mode's settings win over config files */
+	AIDRONESYSTEM_API void SetConsoleVariable(const TCHAR* Name, const FString& Value);
+
+	/** Airspace covered by the map's AAIDroneNavVolumes, or a fixed box around the origin when it has none */
+	AIDRONESYSTEM_API FBox GetFlightArea(UWorld& World);
+
+	/** Drone class named by the command line switch Key (e.g. "DroneSimDroneClass="), BP_AIDrone by default, AAIDrone if neither loads */
+	AIDRONESYSTEM_API UClass* LoadDroneClass(const TCHAR* Key);
+
+	/** Plain character for drones to follow; moved by setting its location, so it needs no controller */
+	AIDRONESYSTEM_API ACharacter* SpawnTarget(UWorld& World, const FVector& Location);
+}
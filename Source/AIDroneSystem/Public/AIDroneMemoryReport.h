@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/SubclassOf.h"
+
+class AAIDrone;
+class UWorld;
+
+/**
+ * What one drone costs in memory. Spawns drones away from the fleet, measures the actor, its components,
+ * its AI controller and every object they own, then destroys them again. Replication state is measured
+ * separately on the live fleet, because freshly spawned drones have no channels yet.
+ * Sizes are object size plus the heap memory its properties own plus its exclusive resource size, so
+ * they match what "obj list" and "memreport" attribute to the same objects.
+ */
+class AIDRONESYSTEM_API FDroneMemoryReport
+{
+public:
+	static FDroneMemoryReport Measure(UWorld& World, TSubclassOf<AAIDrone> DroneClass, int32 NumDrones);
+
+	/** Average bytes per drone, all categories together */
+	double GetBytesPerDrone() const;
+
+	/** Average bytes of replication state per drone for each client connection, or 0 with no clients */
+	double GetReplicationBytesPerConnection() const;
+
+	void Log() const;
+
+	/** One message for every budget the report exceeds: drone.Memory.BudgetKB and drone.Memory.ReplicationBudgetKB */
+	TArray<FString> GetBudgetErrors() const;
+
+	/** Logs every budget the report exceeds */
+	bool IsWithinBudget() const;
+
+private:
+	/** Total bytes over all measured drones, by component name or object kind */
+	TMap<FString, uint64> CategoryBytes;
+	int32 NumDrones = 0;
+
+	uint64 ReplicationBytes = 0;
+	int32 NumChannels = 0;
+	int32 NumConnections = 0;
+};
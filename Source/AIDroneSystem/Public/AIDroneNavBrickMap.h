@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/** Waypoints produced by a flight path query, in world space */
+struct AIDRONESYSTEM_API FDroneNavPath
+{
+	TArray<FVector> Points;
+
+	/** True if the search ran out of budget or the goal was unreachable and the path stops short */
+	bool bPartial = false;
+
+	/** Version of the brick map snapshot the path was planned against */
+	uint32 MapVersion = 0;
+};
+
+/**
+ * Sparse voxel map for flying navigation: a single level of 4x4x4-voxel bricks, each a 64-bit occupancy mask,
+ * grouped into 8x8x8-brick sectors in a hash map keyed by sector coordinate. Only sectors containing blocked space
+ * are stored, so open air costs nothing. A snapshot is immutable once published, which lets path queries read it
+ * from worker threads while the next one is being built. Copies share their sectors until SetBrick writes to one,
+ * so a rebuild only duplicates the sectors it changes.
+ */
+class AIDRONESYSTEM_API FDroneNavBrickMap
+{
+public:
+	static constexpr int32 BrickDim = 4;
+	static constexpr int32 SectorDim = 8;
+
+	FDroneNavBrickMap(const FBox& InBounds, float InVoxelSize);
+
+	FIntVector WorldToVoxel(const FVector& Location) const;
+	FVector VoxelToWorld(const FIntVector& Voxel) const;
+	FBox GetBrickBounds(const FIntVector& Brick) const;
+
+	static FIntVector VoxelToBrick(const FIntVector& Voxel);
+	static int32 GetBrickBitIndex(const FIntVector& Voxel);
+
+	bool IsInBounds(const FIntVector& Voxel) const;
+
+	/** Out of bounds voxels count as blocked */
+	bool IsBlocked(const FIntVector& Voxel) const;
+	bool HasLineOfSight(const FVector& From, const FVector& To) const;
+	bool FindNearestFreeVoxel(const FIntVector& Voxel, int32 SearchRadius, FIntVector& OutVoxel) const;
+
+	/** Stores the occupancy of one brick; a zero mask removes it */
+	void SetBrick(const FIntVector& Brick, uint64 Occupancy);
+
+	/**
+	 * A* over free voxels followed by line-of-sight smoothing. MaxExpansions bounds the cost of a query;
+	 * when it is exhausted the path leads to the explored voxel closest to the goal and is flagged partial.
+	 */
+	TSharedPtr<FDroneNavPath> FindPath(const FVector& Start, const FVector& Goal, int32 MaxExpansions) const;
+
+	FORCEINLINE const FBox& GetBounds() const { return Bounds; }
+	FORCEINLINE float GetVoxelSize() const { return VoxelSize; }
+	FORCEINLINE FIntVector GetNumBricks() const { return NumBricks; }
+	FORCEINLINE int32 GetNumStoredBricks() const { return NumStoredBricks; }
+
+	uint32 Version = 0;
+
+private:
+	struct FSector
+	{
+		uint64 Bricks[SectorDim * SectorDim * SectorDim] = {};
+		int32 NumStoredBricks = 0;
+	};
+
+	static FIntVector BrickToSector(const FIntVector& Brick);
+	static int32 GetSectorBrickIndex(const FIntVector& Brick);
+
+	FBox Bounds;
+	float VoxelSize;
+	FIntVector NumVoxels;
+	FIntVector NumBricks;
+	int32 NumStoredBricks = 0;
+
+	/** Shared with the maps this one was copied from or to until SetBrick writes to them */
+	TMap<FIntVector, TSharedPtr<FSector>> Sectors;
+};
@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AIDroneNavObstacleComponent.generated.h"
+
+enum class EUpdateTransformFlags : int32;
+enum class ETeleportType : uint8;
+
+/**
+ * Makes its actor's collision a flight navigation obstacle although it can move.
+ * Flight navigation voxelizes only static world collision plus actors with this component; the bricks such an
+ * actor leaves and enters are rebuilt when it moves, and the ones it occupied when it is destroyed.
+ */
+UCLASS(ClassGroup = (Drone), meta = (BlueprintSpawnableComponent))
+class AIDRONESYSTEM_API UAIDroneNavObstacleComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	/** How far the actor's collision bounds must move, in cm, before the bricks around it are rebuilt */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation", meta = (ClampMin = "0.0"))
+	float RebuildDistance = 50.0f;
+
+	/** Collision bounds the navigation was last rebuilt for */
+	FORCEINLINE const FBox& GetObstacleBounds() const { return ObstacleBounds; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void OnTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	FBox ObstacleBounds = FBox(ForceInit);
+	TWeakObjectPtr<USceneComponent> TrackedRoot;
+	FDelegateHandle TransformUpdatedHandle;
+};
@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AIDroneNavBrickMap.h"
+#include "AIDroneDistanceField.h"
+#include "AIDroneNavSubsystem.generated.h"
+
+class UAIDroneNavObstacleComponent;
+
+DECLARE_DELEGATE_OneParam(FOnDronePathFound, TSharedPtr<const FDroneNavPath>);
+
+/**
+ * Builds the flying navigation brick map for every AAIDroneNavVolume in the world and answers path queries.
+ * Only static world collision is voxelized, plus the actors that carry a UAIDroneNavObstacleComponent, whose
+ * bricks are rebuilt whenever they move or are destroyed.
+ * Voxelization is time-sliced on the game thread; A* runs on worker threads against an immutable snapshot,
+ * so a query never blocks the game thread. Paths are cached per start/goal brick and shared between drones.
+ * Also owns the baked distance field of the level, if one was baked, for cheap obstacle queries.
+ */
+UCLASS()
+class AIDRONESYSTEM_API UAIDroneNavSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	FORCEINLINE bool IsNavigationReady() const { return Snapshot.IsValid(); }
+
+	/** Brick map path queries currently run against, or null before the first build is published */
+	FORCEINLINE TSharedPtr<const FDroneNavBrickMap> GetSnapshot() const { return Snapshot; }
+
+	/** Baked static obstacle distances for this map, or null if none was baked */
+	FORCEINLINE const FDroneDistanceField* GetDistanceField() const { return DistanceField.IsLoaded() ? &DistanceField : nullptr; }
+
+	/** Distance the goal may drift before a path planned for it should be re-queried */
+	float GetReplanDistance() const;
+
+	/** Re-voxelizes the bricks overlapping Region, e.g. after a dynamic obstacle moved */
+	UFUNCTION(BlueprintCallable, Category = "Drone Navigation")
+	void MarkDirty(const FBox& Region);
+
+	/** Voxelizes everything still queued in one go and publishes the result */
+	void FlushBuild();
+
+	/** Adds a moving actor's collision to the voxelized world and rebuilds the space it occupies */
+	void RegisterObstacle(UAIDroneNavObstacleComponent* Obstacle);
+	void UnregisterObstacle(UAIDroneNavObstacleComponent* Obstacle);
+
+	/**
+	 * Returns a cached path if one leads from Start's region to Goal's region. Otherwise queues a background
+	 * query, returns null and later calls OnFound on the game thread. Identical in-flight queries are merged.
+	 */
+	TSharedPtr<const FDroneNavPath> RequestPath(const FVector& Start, const FVector& Goal, FOnDronePathFound OnFound);
+
+private:
+	struct FPathKey
+	{
+		FIntVector StartBrick;
+		FIntVector GoalBrick;
+
+		bool operator==(const FPathKey& Other) const { return StartBrick == Other.StartBrick && GoalBrick == Other.GoalBrick; }
+		friend uint32 GetTypeHash(const FPathKey& Key) { return HashCombine(GetTypeHash(Key.StartBrick), GetTypeHash(Key.GoalBrick)); }
+	};
+
+	struct FCachedPath
+	{
+		TSharedPtr<const FDroneNavPath> Path;
+		double Time = 0.0;
+	};
+
+	void QueueBricks(const FBox& Region);
+	void ProcessBuildQueue(double BudgetSeconds);
+	uint64 SampleBrick(const FIntVector& Brick) const;
+	void OnPathFound(const FPathKey& Key, TSharedPtr<const FDroneNavPath> Path);
+
+	/** Published, read-only brick map used by path queries */
+	TSharedPtr<const FDroneNavBrickMap> Snapshot;
+
+	/** Working copy being voxelized; published once the build queue drains */
+	TUniquePtr<FDroneNavBrickMap> Building;
+
+	TArray<FIntVector> BuildQueue;
+	TSet<FIntVector> QueuedBricks;
+
+	TArray<TWeakObjectPtr<UAIDroneNavObstacleComponent>> Obstacles;
+
+	FDroneDistanceField DistanceField;
+
+	TMap<FPathKey, FCachedPath> PathCache;
+	TMap<FPathKey, TArray<FOnDronePathFound>> PendingQueries;
+};
@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "AIDroneNavVolume.generated.h"
+
+/**
+ * Marks the airspace drones can plan flight paths through.
+ * The nav subsystem voxelizes the static world collision, plus actors carrying a UAIDroneNavObstacleComponent,
+ * inside every volume of this type.
+ */
+UCLASS()
+class AIDRONESYSTEM_API AAIDroneNavVolume : public AVolume
+{
+	GENERATED_BODY()
+
+public:
+	/** Edge length of a leaf voxel in cm; the smallest size across all volumes is used */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Navigation", meta = (ClampMin = "25.0"))
+	float VoxelSize = 100.0f;
+};
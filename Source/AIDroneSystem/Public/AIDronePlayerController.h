@@ -2,8 +2,24 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/PlayerController.h"
+#include "InputActionValue.h"
 #include "AIDronePlayerController.generated.h"
 
+class UEnhancedInputComponent;
+class UEnhancedInputLocalPlayerSubsystem;
+class UInputAction;
+class UInputMappingContext;
+
+/** What the server does with a ServerMove that just arrived */
+enum class EDroneMoveAdmission : uint8
+{
+	Process,
+	// Over the rate limit: fold it into the drone's pending move
+	Merge,
+	// Flooding: ignore it without looking at it
+	Drop
+};
+
 /**
  * Custom Player Controller that tracks pawn possession for drone switching
  */
@@ -18,6 +34,9 @@ public:
 	// Override OnPossess to track the previous pawn
 	virtual void OnPossess(APawn* InPawn) override;
 
+	virtual void AcknowledgePossession(APawn* P) override;
+	virtual void PlayerTick(float DeltaTime) override;
+
 	// Get the pawn that was possessed before the current one
 	FORCEINLINE APawn* GetPreviousPawn() const { return PreviousPawn; }
 
@@ -25,8 +44,89 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Pawn")
 	void PossessPreviousPawn();
 
+	/**
+	 * Local only: moves camera and input to Pawn straight away instead of waiting for the server to possess it.
+	 * Input meant for Pawn is buffered and replayed once the possession arrives; a rejection or a timeout puts
+	 * camera and input back. Returns false if prediction is off, a swap is already pending, or Pawn is current.
+	 */
+	bool PredictPossession(APawn* Pawn);
+
+	/** Sent by the server when it refuses a possession request; null means whichever swap is pending */
+	UFUNCTION(Client, Reliable)
+	void ClientRejectPossession(APawn* Pawn);
+
+	/** Local only: adds the context at the inactive priority so switching to it later is only a priority change */
+	void PreloadInputContext(UInputMappingContext* Context);
+
+	/** Local only: gives Context the active priority and every other context added through here the inactive one */
+	void ActivateInputContext(UInputMappingContext* Context);
+
+	/** Mapping context of the character or drone, or null for other pawns */
+	static UInputMappingContext* GetInputContextFor(const APawn* Pawn);
+
+	FORCEINLINE bool IsPossessionPending() const { return PredictedPawn.IsValid(); }
+
+	/** Milliseconds from the predicted swap to the server's possession, for the last confirmed swap */
+	FORCEINLINE double GetLastSwapLatencyMs() const { return LastSwapLatencyMs; }
+
+	void LogSwapStats() const;
+
+	/** Server only: counts a ServerMove from this connection against its token bucket and flood limit */
+	EDroneMoveAdmission AdmitServerMove();
+
+	/** Server only: takes a token for a merged move; false if the bucket is still empty */
+	bool TryConsumeMoveToken();
+
+	FORCEINLINE int64 GetNumMergedMoves() const { return NumMergedMoves; }
+	FORCEINLINE int64 GetNumDroppedMoves() const { return NumDroppedMoves; }
+
 protected:
 	// Stores the pawn that was possessed before the current one
 	UPROPERTY()
 	APawn* PreviousPawn;
+
+private:
+	void RefillMoveTokens();
+
+	UEnhancedInputLocalPlayerSubsystem* GetInputSubsystem() const;
+	void BufferInput(const UInputAction* Action, const FInputActionValue& Value);
+	void RollBackPossession(const TCHAR* Reason);
+	void EndPossessionPrediction();
+
+	static constexpr int32 ActiveInputPriority = 1;
+	static constexpr int32 InactiveInputPriority = 0;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UInputMappingContext>> InputContexts;
+
+	// Catches the predicted pawn's actions while its own input component does not exist yet
+	UPROPERTY(Transient)
+	TObjectPtr<UEnhancedInputComponent> PredictionInputComponent;
+
+	TWeakObjectPtr<APawn> PredictedPawn;
+	TWeakObjectPtr<APawn> PredictedFromPawn;
+	TWeakObjectPtr<APawn> AcknowledgedPawn;
+	double PredictionStartTime = 0.0;
+
+	// Summed value of each action triggered while the swap was pending, replayed once it completes
+	TArray<TPair<const UInputAction*, FInputActionValue>> BufferedInput;
+	bool bReplayBufferedInput = false;
+
+	double LastSwapLatencyMs = 0.0;
+	double TotalSwapLatencyMs = 0.0;
+	double MaxSwapLatencyMs = 0.0;
+	int32 NumConfirmedSwaps = 0;
+	int32 NumRolledBackSwaps = 0;
+
+	// ServerMove token bucket for this connection
+	float MoveTokens = -1.0f;
+	double MoveTokensRefillTime = 0.0;
+
+	// ServerMoves seen in the current one-second flood window
+	int32 NumMovesInWindow = 0;
+	double MoveWindowStartTime = 0.0;
+	bool bFloodReported = false;
+
+	int64 NumMergedMoves = 0;
+	int64 NumDroppedMoves = 0;
 };
\ No newline at end of file
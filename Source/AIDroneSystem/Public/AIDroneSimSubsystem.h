@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AIDroneSimSubsystem.generated.h"
+
+class AAIDrone;
+class ACharacter;
+
+/**
+ * Headless, reproducible fleet simulation, created only when the process runs with -DroneSim.
+ * Switches the engine to a fixed timestep, which also removes the wait for real time between frames, and
+ * puts drone AI and navigation into their deterministic modes. It then spawns drones and follow targets
+ * and issues follow and unfollow commands, all from one seeded random stream. At the end it logs a
+ * checksum of the fleet state and exits; the same seed and settings must always give the same checksum.
+ *
+ * Usage: <Project> <Map> -game -nullrhi -nosound -DroneSim [-DroneSimSeed=1] [-DroneSimSeconds=600]
+ *   [-DroneSimStep=0.0166667] [-DroneSimSubsteps=1] [-DroneSimDrones=100] [-DroneSimTargets=4]
+ *   [-DroneSimCommandInterval=2] [-DroneSimChecksumInterval=60] [-DroneSimDroneClass=/Game/BP_AIDrone.BP_AIDrone_C]
+ *   [-DroneSimRecord[=Path.dfr]]
+ */
+UCLASS()
+class AIDRONESYSTEM_API UAIDroneSimSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Hash of every drone's and dormant record's state, in fleet order */
+	uint64 ComputeChecksum() const;
+
+private:
+	void SpawnFleet(UWorld& InWorld, int32 NumDrones, int32 NumTargets);
+	void MoveTargets(float DeltaTime);
+	void IssueCommand();
+	void Finish();
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ACharacter>> Targets;
+
+	TArray<FVector> TargetGoals;
+
+	FRandomStream Random;
+	FBox Area;
+	bool bRunning = false;
+
+	double SimTime = 0.0;
+	double Duration = 0.0;
+	double CommandInterval = 0.0;
+	double NextCommandTime = 0.0;
+	double ChecksumInterval = 0.0;
+	double NextChecksumTime = 0.0;
+	int64 NumFrames = 0;
+	double WallStartTime = 0.0;
+};
@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AIDroneSoakSubsystem.generated.h"
+
+class AAIDrone;
+class ACharacter;
+class APawn;
+class APlayerController;
+
+/**
+ * Headless lifecycle soak test, created only when the process runs with -DroneSoak.
+ * Every frame is one iteration: it destroys and respawns drones, toggles following, and swaps a player
+ * controller between a drone and its own pawn. Every target interval it also destroys and replaces a follow
+ * target, and from then on counts drones left following nothing. On the first iteration it restores a fleet
+ * snapshot of drones following a player who never connects, which must keep following until the end.
+ * Every GC interval it forces a full garbage collection and samples UObject and actor counts, the
+ * collection's pause and process memory. At the end it writes the samples to Saved/DroneSoak as CSV and
+ * exits with code 1 if object counts grew past the limit after warm-up, if the collections late in the run
+ * took much longer than the early ones, if any drone was still following a destroyed target an iteration
+ * after losing it, or if a restored follower gave up on its player.
+ *
+ * Usage: <Project> <Map> -game -nullrhi -nosound -DroneSoak [-DroneSoakIterations=5000] [-DroneSoakDrones=200]
+ *   [-DroneSoakChurn=4] [-DroneSoakGCInterval=100] [-DroneSoakMaxObjectGrowth=200] [-DroneSoakMaxPauseGrowth=1.5]
+ *   [-DroneSoakTargetInterval=10] [-DroneSoakSeed=1] [-DroneSoakDroneClass=/Game/BP_AIDrone.BP_AIDrone_C]
+ */
+UCLASS()
+class AIDRONESYSTEM_API UAIDroneSoakSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	struct FSample
+	{
+		int32 Iteration = 0;
+		int32 NumObjects = 0;
+		int32 NumActors = 0;
+		int32 NumControllers = 0;
+		double GCPauseMs = 0.0;
+		uint64 UsedPhysical = 0;
+		uint64 PeakUsedPhysical = 0;
+	};
+
+	AAIDrone* SpawnDrone();
+	void ReplaceTarget();
+	void RestoreFollowers();
+	void RunIteration();
+	void TakeSample();
+	void Finish();
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AAIDrone>> Drones;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ACharacter>> Targets;
+
+	/** Drones the fleet restored from the soak's snapshot, still waiting for their player */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AAIDrone>> RestoredFollowers;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UClass> DroneClass;
+
+	UPROPERTY(Transient)
+	TObjectPtr<APlayerController> PlayerController;
+
+	UPROPERTY(Transient)
+	TObjectPtr<APawn> HomePawn;
+
+	UPROPERTY(Transient)
+	TObjectPtr<AAIDrone> PossessedDrone;
+
+	FRandomStream Random;
+	FBox Area;
+	bool bRunning = false;
+
+	int32 Iteration = 0;
+	int32 NumIterations = 0;
+	int32 Churn = 0;
+	int32 GCInterval = 0;
+	int32 TargetInterval = 0;
+	int32 MaxObjectGrowth = 0;
+	float MaxPauseGrowth = 0.0f;
+
+	TArray<FSample> Samples;
+
+	/** Drone updates that found a drone still following a target destroyed before it */
+	int32 NumOrphanedFollowers = 0;
+
+	/** Restored followers that stopped following, or were destroyed, before their player rejoined */
+	int32 NumDroppedRestoredFollowers = 0;
+
+	/** Collections the engine ran on its own between samples */
+	uint64 GCStartCycles = 0;
+	int32 NumEngineCollections = 0;
+	double WorstEngineGCPauseMs = 0.0;
+	bool bForcingGC = false;
+
+	FDelegateHandle PreGCHandle;
+	FDelegateHandle PostGCHandle;
+	double WallStartTime = 0.0;
+};
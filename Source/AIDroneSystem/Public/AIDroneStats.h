@@ -0,0 +1,160 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+/**
+ * Drone instrumentation. Every timed section shows up in four places at once:
+ * - "stat Drones" in development builds
+ * - Unreal Insights on the Drone channel: -trace=default,Drone
+ * - the Drones category of CSV captures: -csvprofile or csvprofile start
+ * - drone.Stats.Dump, which logs a per-frame breakdown in any build, so it works on a production server too
+ * Times are inclusive, so a drone's Tick contains its UpdateAI when the fleet subsystem is not scheduling it.
+ */
+DECLARE_STATS_GROUP(TEXT("Drones"), STATGROUP_Drones, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drone Tick"), STAT_DroneTick, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drone UpdateAI"), STAT_DroneUpdateAI, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drone HoverPhysics"), STAT_DroneHoverPhysics, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drone ObstacleTrace"), STAT_DroneObstacleTrace, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drone ServerMove"), STAT_DroneServerMove, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drone VisualFeedback"), STAT_DroneVisualFeedback, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fleet Schedule"), STAT_DroneSchedule, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fleet Avoidance"), STAT_DroneAvoidance, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fleet Dormancy"), STAT_DroneDormancy, STATGROUP_Drones, AIDRONESYSTEM_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Drones Idle"), STAT_DroneDronesIdle, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Drones Following"), STAT_DroneDronesFollowing, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Drones Possessed"), STAT_DroneDronesPossessed, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Drones Dormant"), STAT_DroneDronesDormant, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("AI Updates"), STAT_DroneAIUpdates, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("AI Updates Deferred"), STAT_DroneDeferredUpdates, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Obstacle Queries"), STAT_DroneObstacleQueries, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Scene Traces"), STAT_DroneSceneTraces, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ServerMoves Received"), STAT_DroneServerMoves, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ServerMove Corrections"), STAT_DroneServerMoveCorrections, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ServerMoves Merged"), STAT_DroneServerMovesMerged, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ServerMoves Dropped"), STAT_DroneServerMovesDropped, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Worker Results"), STAT_DroneWorkerResults, STATGROUP_Drones, AIDRONESYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Worker Fallbacks"), STAT_DroneWorkerFallbacks, STATGROUP_Drones, AIDRONESYSTEM_API);
+
+UE_TRACE_CHANNEL_EXTERN(DroneChannel, AIDRONESYSTEM_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(AIDRONESYSTEM_API, Drones);
+
+/** Timed sections; names match the stat, trace and CSV names without their Drone prefix */
+enum class EDroneTimer : uint8
+{
+	Tick,
+	UpdateAI,
+	HoverPhysics,
+	ObstacleTrace,
+	ServerMove,
+	VisualFeedback,
+	Schedule,
+	Avoidance,
+	Dormancy,
+	Num
+};
+
+/** Per-frame counts; the Drones* ones are how many drones were in that state when the frame ended */
+enum class EDroneCounter : uint8
+{
+	DronesIdle,
+	DronesFollowing,
+	DronesPossessed,
+	DronesDormant,
+	AIUpdates,
+	DeferredUpdates,
+	ObstacleQueries,
+	SceneTraces,
+	ServerMoves,
+	ServerMoveCorrections,
+	ServerMovesMerged,
+	ServerMovesDropped,
+	WorkerResults,
+	WorkerFallbacks,
+	Num
+};
+
+/**
+ * Process-wide drone timings and counts for the current and the last finished frame, plus running totals
+ * for drone.Stats.Dump. Game thread only.
+ */
+class AIDRONESYSTEM_API FDroneFrameStats
+{
+public:
+	static FDroneFrameStats& Get() { return Instance; }
+
+	FORCEINLINE void AddTime(EDroneTimer Timer, uint64 Cycles)
+	{
+		Current.Cycles[(int32)Timer] += Cycles;
+		++Current.Calls[(int32)Timer];
+	}
+
+	FORCEINLINE void Increment(EDroneCounter Counter, uint32 Amount = 1)
+	{
+		Current.Counters[(int32)Counter] += Amount;
+	}
+
+	uint64 GetLastFrameCounter(EDroneCounter Counter) const { return Last.Counters[(int32)Counter]; }
+	double GetLastFrameMilliseconds(EDroneTimer Timer) const { return FPlatformTime::ToMilliseconds64(Last.Cycles[(int32)Timer]); }
+
+	/**
+	 * Closes the frame and publishes its counters to stats, Insights and the CSV profiler.
+	 * Called by every fleet subsystem, but only the first call in an engine frame closes it.
+	 */
+	void EndFrame();
+
+	/** Logs the last frame and the average frame since the previous dump, then starts a new average */
+	void Dump();
+
+private:
+	struct FFrame
+	{
+		uint64 Cycles[(int32)EDroneTimer::Num] = {};
+		uint64 Calls[(int32)EDroneTimer::Num] = {};
+		uint64 Counters[(int32)EDroneCounter::Num] = {};
+	};
+
+	static FDroneFrameStats Instance;
+
+	FFrame Current;
+	FFrame Last;
+	FFrame Total;
+	uint64 NumTotalFrames = 0;
+	uint64 LastEndedFrameNumber = MAX_uint64;
+};
+
+/** Adds the time until the end of the scope to the current drone frame */
+class FDroneScopedTimer
+{
+public:
+	FORCEINLINE explicit FDroneScopedTimer(EDroneTimer InTimer)
+		: Timer(InTimer)
+		, StartCycles(FPlatformTime::Cycles64())
+	{
+	}
+
+	FORCEINLINE ~FDroneScopedTimer()
+	{
+		FDroneFrameStats::Get().AddTime(Timer, FPlatformTime::Cycles64() - StartCycles);
+	}
+
+private:
+	EDroneTimer Timer;
+	uint64 StartCycles;
+};
+
+/** Times the rest of the scope under EDroneTimer::Name in every profiler */
+#define DRONE_SCOPED_TIMER(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_Drone##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Drone##Name, DroneChannel); \
+	CSV_SCOPED_TIMING_STAT(Drones, Name); \
+	FDroneScopedTimer PREPROCESSOR_JOIN(DroneScopedTimer, __LINE__)(EDroneTimer::Name)
+
+/** Counts Amount towards EDroneCounter::Name for the current frame */
+#define DRONE_COUNTER_ADD(Name, Amount) FDroneFrameStats::Get().Increment(EDroneCounter::Name, Amount)
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/** Per-drone inputs to FDroneSteering as SoA arrays; every array holds one entry per drone */
+struct AIDRONESYSTEM_API FDroneSteeringInput
+{
+	TArray<float> PositionX;
+	TArray<float> PositionY;
+	TArray<float> PositionZ;
+
+	/** Where the drone steers; without a navigation path that is its follow target */
+	TArray<float> GoalX;
+	TArray<float> GoalY;
+	TArray<float> GoalZ;
+
+	/** Current yaw in degrees */
+	TArray<float> Yaw;
+	TArray<float> FollowDistance;
+
+	/** Hover clock already advanced by DeltaTime, as in AAIDrone::ApplyHoverPhysics */
+	TArray<float> HoverTime;
+	TArray<float> HoverFrequency;
+	TArray<float> HoverAmplitude;
+	TArray<float> MaxSpeed;
+	TArray<float> DeltaTime;
+
+	void SetNum(int32 NumDrones);
+	FORCEINLINE int32 Num() const { return PositionX.Num(); }
+};
+
+/** Per-drone results of FDroneSteering, indexed like the input */
+struct AIDRONESYSTEM_API FDroneSteeringOutput
+{
+	/** Unit direction to the goal, or zero when the drone is on it */
+	TArray<float> DirectionX;
+	TArray<float> DirectionY;
+	TArray<float> DirectionZ;
+	TArray<float> Distance;
+
+	/** Movement input scale while following, clamped to [0.1, 1] */
+	TArray<float> Magnitude;
+
+	/** Yaw facing the goal, and the yaw after this update's interpolation towards it, in degrees */
+	TArray<float> TargetYaw;
+	TArray<float> NewYaw;
+
+	/** Vertical movement input that produces the hover bob */
+	TArray<float> HoverInput;
+
+	void SetNum(int32 NumDrones);
+};
+
+/**
+ * The per-drone math of AAIDrone::UpdateDroneAI and ApplyHoverPhysics for a whole batch of drones:
+ * steering direction, distance, follow magnitude, target and interpolated yaw, and hover input.
+ * Solve runs four drones per instruction through VectorRegister4Float, with polynomial sine and arctangent
+ * approximations in place of FMath::Sin and FMath::Atan2, and matches SolveScalar within a few millionths
+ * for directions and hover input and a thousandth of a degree for yaw. drone.Steering.Benchmark checks that
+ * and times both.
+ */
+struct AIDRONESYSTEM_API FDroneSteering
+{
+	/** Same as the yaw interpolation speed AAIDrone uses while following */
+	static constexpr float YawInterpSpeed = 8.0f;
+
+	static void Solve(const FDroneSteeringInput& Input, FDroneSteeringOutput& Output);
+
+	/** Reference implementation, one drone at a time with exactly the drone's math; solves drones from Begin on */
+	static void SolveScalar(const FDroneSteeringInput& Input, FDroneSteeringOutput& Output, int32 Begin = 0);
+};
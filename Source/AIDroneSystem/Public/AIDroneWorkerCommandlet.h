@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "AIDroneWorkerCommandlet.generated.h"
+
+/**
+ * Out-of-process drone AI worker: serves fleet avoidance for every server on the machine that sets drone.Worker.Enable.
+ * Run as many as there are cores to spare; they all take frames from one shared pool.
+ * Usage: -run=AIDroneWorker [-DroneWorkerPool=Name] [-Slots=8] [-Frames=4] [-MaxAgents=4096] [-Seconds=0]
+ */
+UCLASS()
+class UAIDroneWorkerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UAIDroneWorkerCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
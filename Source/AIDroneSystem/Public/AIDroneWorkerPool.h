@@ -0,0 +1,237 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "AIDroneAvoidance.h"
+#include "HAL/PlatformMemory.h"
+#include <atomic>
+
+/** One drone's avoidance input as a worker sees it */
+struct FDroneWorkerAgent
+{
+	FVector3f Position = FVector3f::ZeroVector;
+	FVector3f Velocity = FVector3f::ZeroVector;
+	FVector3f PreferredVelocity = FVector3f::ZeroVector;
+	float Radius = 0.0f;
+	float MaxSpeed = 0.0f;
+	uint32 bResponsive = 0;
+};
+static_assert(sizeof(FDroneWorkerAgent) == 48, "Worker agent layout is shared between processes");
+
+/**
+ * Frames go Free -> Submitted (server) -> Working (worker) -> Done (worker) -> Free (server).
+ * A server that stops waiting takes a Submitted frame straight back to Free and marks a Working one
+ * Abandoned, which the worker frees once it finishes.
+ */
+enum class EDroneWorkerFrameState : uint32
+{
+	Free,
+	Submitted,
+	Working,
+	Done,
+	Abandoned
+};
+
+/** One fleet's avoidance frame; MaxAgents agents and then MaxAgents result velocities follow it */
+struct alignas(64) FDroneWorkerFrame
+{
+	std::atomic<uint32> State{ (uint32)EDroneWorkerFrameState::Free };
+	uint32 NumAgents = 0;
+	float NeighbourRadius = 0.0f;
+	int32 MaxNeighbours = 0;
+	float TimeHorizon = 0.0f;
+	float DeltaTime = 0.0f;
+
+	/** Cycles the worker spent solving the frame */
+	uint64 WorkerCycles = 0;
+
+	/** FPlatformTime::Cycles64 when the worker finished; processes on one machine share that clock */
+	uint64 DoneCycles = 0;
+};
+
+/** A server process's share of the pool: its frame ring and who holds it */
+struct alignas(64) FDroneWorkerSlot
+{
+	/** Process that claimed the slot, or 0 */
+	std::atomic<uint32> OwnerProcessId{ 0 };
+
+	/** Bumped by every claim, so a client can tell the slot was reclaimed even by its own process */
+	std::atomic<uint32> OwnerGeneration{ 0 };
+
+	/** FPlatformTime::Cycles64 when the owner last ticked; slots of servers that went quiet are reclaimed */
+	std::atomic<uint64> OwnerHeartbeatCycles{ 0 };
+};
+
+/** Cell of the pool's job queue: a bounded multi-producer multi-consumer ring with a sequence number per cell */
+struct FDroneWorkerJob
+{
+	std::atomic<uint64> Sequence{ 0 };
+	uint32 SlotIndex = 0;
+	uint32 FrameIndex = 0;
+};
+
+struct alignas(64) FDroneWorkerPoolHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x504B5744; // "DWKP"
+	static constexpr uint32 CurrentVersion = 2;
+
+	/** Written last by the process that creates the pool, so a reader that sees it sees the rest */
+	std::atomic<uint32> Magic{ 0 };
+	uint32 Version = CurrentVersion;
+	uint32 NumSlots = 0;
+	uint32 FramesPerSlot = 0;
+	uint32 MaxAgents = 0;
+	uint32 QueueCapacity = 0;
+	uint64 TotalSize = 0;
+	uint64 FrameStride = 0;
+	uint64 SlotsOffset = 0;
+	uint64 QueueOffset = 0;
+	uint64 FramesOffset = 0;
+
+	/** FPlatformTime::Cycles64 when any worker last polled the queue */
+	std::atomic<uint64> WorkerHeartbeatCycles{ 0 };
+
+	alignas(64) std::atomic<uint64> EnqueuePosition{ 0 };
+	alignas(64) std::atomic<uint64> DequeuePosition{ 0 };
+};
+
+static_assert(std::atomic<uint32>::is_always_lock_free && std::atomic<uint64>::is_always_lock_free,
+	"The worker pool needs address-free atomics to share them between processes");
+
+/**
+ * Named shared memory through which server processes hand fleet avoidance to worker processes on the same
+ * machine. Each server claims a slot with a ring of frame buffers; submitted frames go on one job queue that
+ * every worker takes from, so any number of servers share any number of workers without locks.
+ * Workers create the pool and servers only open it, so a server that finds no pool has no worker to use.
+ */
+class AIDRONESYSTEM_API FDroneWorkerPool
+{
+public:
+	struct FSettings
+	{
+		int32 NumSlots = 8;
+		int32 FramesPerSlot = 4;
+		int32 MaxAgents = 4096;
+	};
+
+	FDroneWorkerPool() = default;
+	~FDroneWorkerPool();
+	UE_NONCOPYABLE(FDroneWorkerPool);
+
+	/** AIDroneWorkerPool, or -DroneWorkerPool=Name for separate pools on one machine */
+	static FString GetDefaultName();
+
+	/** Worker side: lays out a new pool */
+	bool Create(const FString& Name, const FSettings& Settings);
+
+	/** Opens a pool a worker already created; false if there is none or it is not ready yet */
+	bool Open(const FString& Name);
+	void Close();
+
+	FORCEINLINE bool IsOpen() const { return Header != nullptr; }
+	FORCEINLINE const FDroneWorkerPoolHeader& GetHeader() const { return *Header; }
+
+	FDroneWorkerSlot& GetSlot(uint32 SlotIndex) const;
+	FDroneWorkerFrame& GetFrame(uint32 SlotIndex, uint32 FrameIndex) const;
+	FDroneWorkerAgent* GetAgents(FDroneWorkerFrame& Frame) const;
+	FVector3f* GetResults(FDroneWorkerFrame& Frame) const;
+
+	/** Returns false if the queue is full */
+	bool Enqueue(uint32 SlotIndex, uint32 FrameIndex);
+
+	/** Returns false if the queue is empty */
+	bool Dequeue(uint32& OutSlotIndex, uint32& OutFrameIndex);
+
+	void TouchWorkerHeartbeat();
+	bool IsWorkerAlive(double TimeoutSeconds) const;
+
+	/**
+	 * Worker side: takes one queued frame, builds its neighbour query, solves avoidance and publishes the
+	 * velocities. Returns false if there was nothing to do.
+	 */
+	bool ProcessNextJob();
+
+private:
+	bool Map(const FString& Name, bool bCreate, SIZE_T Size);
+
+	FPlatformMemory::FSharedMemoryRegion* Region = nullptr;
+	FDroneWorkerPoolHeader* Header = nullptr;
+	uint8* Base = nullptr;
+
+	// Worker scratch for ProcessNextJob
+	FDroneNeighbourQuery Query;
+	TArray<FVector> PreferredVelocities;
+	TArray<float> MaxSpeeds;
+	TArray<bool> Responsive;
+	TArray<FVector> Velocities;
+};
+
+/** Round trips of avoidance frames through the worker pool, measured on the server */
+struct FDroneWorkerLatency
+{
+	uint64 NumResults = 0;
+	uint64 NumTimeouts = 0;
+
+	/** From submit until the worker finished, so including time spent in the queue */
+	double LastRoundTripMs = 0.0;
+	double MaxRoundTripMs = 0.0;
+	double TotalRoundTripMs = 0.0;
+	double LastWorkerMs = 0.0;
+	double TotalWorkerMs = 0.0;
+};
+
+/** Server side of the worker pool: one claimed slot, submitting a fleet's avoidance and collecting the answer */
+class AIDRONESYSTEM_API FDroneWorkerClient
+{
+public:
+	/** A worker that has not polled for this long is treated as gone */
+	static constexpr double WorkerTimeoutSeconds = 1.0;
+
+	~FDroneWorkerClient();
+
+	/** Opens the pool and claims a slot; false if no worker is running or every slot is taken */
+	bool Connect(const FString& PoolName);
+	void Disconnect();
+
+	FORCEINLINE bool IsConnected() const { return SlotIndex != INDEX_NONE; }
+	bool IsWorkerAlive() const;
+
+	/** Keeps the claimed slot from looking abandoned; call every tick. Disconnects and returns false if another server took it */
+	bool TouchHeartbeat();
+
+	/**
+	 * Copies the fleet into the next frame of the slot and queues it. Returns false, leaving the caller to
+	 * solve in process, if no worker is alive, the fleet is larger than the pool's frames, the ring is full
+	 * or the slot was taken over.
+	 */
+	bool Submit(const FDroneNeighbourQuery& Query, TConstArrayView<FVector> PreferredVelocities, TConstArrayView<float> MaxSpeeds,
+		TConstArrayView<bool> Responsive, float NeighbourRadius, int32 MaxNeighbours, const FDroneAvoidance::FParams& Params);
+
+	/**
+	 * Waits up to WaitSeconds for the oldest submitted frame and copies its velocities, indexed like the
+	 * submitted query, into OutVelocities. On timeout the frame is abandoned and this returns false; if the
+	 * slot was taken over meanwhile, the client disconnects.
+	 */
+	bool Collect(double WaitSeconds, TArrayView<FVector> OutVelocities);
+
+	FORCEINLINE bool HasPendingFrame() const { return NextCollect != NextSubmit; }
+	FORCEINLINE int32 GetSlotIndex() const { return SlotIndex; }
+	FORCEINLINE const FDroneWorkerLatency& GetLatency() const { return Latency; }
+
+private:
+	void AbandonFrame(FDroneWorkerFrame& Frame);
+	bool OwnsSlot() const;
+
+	/** Disconnects, leaving the slot to its new owner, if it was reclaimed */
+	bool CheckOwnership();
+
+	FDroneWorkerPool Pool;
+	int32 SlotIndex = INDEX_NONE;
+	uint32 Generation = 0;
+	uint64 NextSubmit = 0;
+	uint64 NextCollect = 0;
+
+	/** When each frame of the ring was submitted */
+	TArray<uint64> SubmitCycles;
+
+	FDroneWorkerLatency Latency;
+};